@@ -2,13 +2,15 @@
 #include <stdarg.h>
 #include <stdlib.h>
 
-#include <cstring> // Include cstring for strlen and vsprintf
+#include <cstring> // Include cstring for strlen
 #include "gfx.h"
 #include "font.h"
 #include "gfxfont.h"
 #include "pico/stdlib.h"
 #include "hardware/dma.h"
+#include "pico/multicore.h"
 #include "st7789.h"
+#include "spsc_queue.h"
 
 #ifndef swap
 #define swap(a, b)     \
@@ -22,14 +24,146 @@
 #define GFX_BLACK 0x0000
 #define GFX_WHITE 0xFFFF
 
+/** @brief Maximum damaged regions tracked; each one is sent as its own address window */
+#define GFX_MAX_DIRTY_RECTS 8
+/** @brief Cost of one CASET/RASET/RAMWR window setup, in pixel bytes it could have sent */
+#define GFX_WINDOW_COST 32
+/** @brief Depth of the GFX_pushClip() stack */
+#define GFX_CLIP_DEPTH 8
+/** @brief Fills of at least this many pixels are done by DMA rather than the CPU */
+#define GFX_DMA_FILL_MIN 512
+/** @brief Bytes of row spans one glyph cache slot holds; larger glyphs are drawn uncached */
+#define GFX_GLYPH_SPAN_BYTES 96
+/** @brief Most classic font characters drawn in one pass by the string renderer */
+#define GFX_TEXT_RUN 32
+/** @brief Longest text a layout cache slot holds; longer text is laid out on every draw */
+#define GFX_LAYOUT_CHARS 48
+/** @brief Alpha value of fully opaque drawing */
+#define GFX_ALPHA_OPAQUE 255
+/** @brief Number of bands a vsync-aligned flush is split into */
+#define GFX_VSYNC_BANDS 4
+/** @brief Pixels expanded from an indexed framebuffer per transfer */
+#define GFX_INDEX_CHUNK 1024
+
 static int memcpy_dma_chan;
 static bool gfx_dma_init = false;
 
-uint16_t *gfxFramebuffer = NULL;
-static bool gfxFbUpdated = false;
+uint16_t *gfxFramebuffer = NULL;          ///< Buffer that drawing functions write to
+static uint16_t *gfxFramebufs[2] = {NULL}; ///< Allocated buffers, [1] only when double buffered
+static void (*gfxFlushCallback)(void) = NULL;
+static uint8_t *gfxIndexBuf = NULL;        ///< Indexed framebuffer, used instead of gfxFramebuffer
+static uint16_t gfxPalette[256];           ///< RGB565 color of each index
+
+static uint16_t *gfxVsyncBuf = NULL;        ///< Frame being sent by GFX_flushVsync()
+static volatile bool gfxVsyncArmed = false; ///< Waiting for the next TE edge
+static volatile bool gfxVsyncBusy = false;  ///< Bands of gfxVsyncBuf still to send
+static uint8_t gfxVsyncBand;                ///< Band being sent
+static uint8_t gfxVsyncBands;               ///< Bands in the current frame
+static uint64_t gfxVsyncTe;                 ///< TE edge the current frame is aligned to
+static uint64_t gfxVsyncSent;               ///< When the band in flight started
+static uint32_t gfxVsyncRowTime = 0;        ///< Measured time to send one row, in 1/16 us
+
+static bool gfxHwScroll = false;       ///< Panel scrolls; the framebuffer is a ring of rows
+static uint16_t gfxScrollRow = 0;      ///< Framebuffer row holding screen row 0
+static bool gfxScrollPending = false;  ///< gfxScrollRow not yet sent to the panel
+
+static uint32_t *gfxRowHash = NULL;    ///< Hash of each framebuffer row as last sent, diff flush only
+static bool gfxRowHashValid = false;   ///< gfxRowHash matches what the panel shows
+static uint8_t gfxRowHashRotation;     ///< Rotation the hashed frame was sent in
+
+enum
+{
+    GFX_OP_PIXEL,
+    GFX_OP_LINE,
+    GFX_OP_VLINE,
+    GFX_OP_HLINE,
+    GFX_OP_FILLRECT,
+    GFX_OP_CHAR,
+    GFX_OP_CIRCLE,
+    GFX_OP_FILLCIRCLE,
+    GFX_OP_BITMAP,
+    GFX_OP_BITMAPMASK,
+    GFX_OP_FILLRECTALPHA,
+    GFX_OP_RGBBITMAPALPHA,
+    GFX_OP_ALPHAMASK,
+    GFX_OP_LINEAA,
+    GFX_OP_CIRCLEAA,
+    GFX_OP_CLIP,
+    GFX_OP_FLUSH, // calls below are only queued for the core1 worker
+    GFX_OP_FLUSHASYNC,
+    GFX_OP_FLUSHVSYNC,
+    GFX_OP_UPDATE,
+    GFX_OP_SCROLL,
+    GFX_OP_STOP,
+};
+
+typedef struct
+{
+    uint8_t op;              // GFX_OP_*
+    uint8_t c, sx, sy;       // character and text scale
+    int16_t x0, y0, x1, y1;  // coordinates or sizes, as passed to the call
+    uint16_t color, bg;      // bg is the alpha of lines and blended calls
+    const void *data;        // bitmap, or font for characters
+    int16_t top, bottom;     // screen rows touched, inclusive
+} gfxCmd;
+
+static gfxCmd *gfxCmds = NULL;              ///< Display list, allocated in band mode only
+static uint16_t gfxCmdMax = 0;              ///< Display list capacity
+static uint16_t gfxCmdCount = 0;            ///< Calls recorded since the last flush
+static bool gfxCmdOverflow = false;         ///< Calls were dropped since the last flush
+static uint16_t *gfxBandBufs[2] = {NULL};   ///< Strip buffers, one renders while one is sent
+static uint16_t gfxBandLines = 0;           ///< Rows per strip
+static int16_t gfxBandTop = 0;              ///< Screen row held in gfxFramebuffer row 0
+static int16_t gfxBandBottom = 0;           ///< One past the last strip row, 0 outside band replay
+
+// A cached glyph is its bitmap scaled horizontally and stored as runs of set
+// pixels per glyph row: a count, then start and length pairs. Rows are
+// repeated size_y times as they are drawn.
+typedef struct
+{
+    const GFXfont *font;  // NULL for the classic font
+    uint32_t lastUse;     // gfxGlyphTick when last drawn
+    uint8_t c, sx, sy;    // character and scale; sx is 0 in an empty slot
+    uint8_t rows;         // glyph rows
+    uint8_t spans[GFX_GLYPH_SPAN_BYTES];
+} gfxGlyph;
+
+static gfxGlyph *gfxGlyphs = NULL;          ///< Glyph cache, shared by all displays
+static uint16_t gfxGlyphCount = 0;          ///< Glyph cache slots
+static uint32_t gfxGlyphTick = 0;           ///< Counts glyph cache lookups, for LRU eviction
+
+// A glyph placed by the text layout, relative to the top-left of its box. y
+// is the cursor row passed to GFX_drawChar(), the baseline for GFXfont fonts.
+typedef struct
+{
+    int16_t x, y;
+    uint8_t c;
+} gfxPlacedGlyph;
+
+// A laid-out GFX_drawTextBox() call, keyed by its text and everything else
+// that decides where the glyphs go
+typedef struct
+{
+    const GFXfont *font;  // NULL for the classic font
+    uint32_t lastUse;     // gfxLayoutTick when last drawn
+    int16_t w, h;         // box size
+    uint8_t sx, sy, flags; // text scale and GFX_ALIGN_* / GFX_TEXT_* flags; sx is 0 in an empty slot
+    uint8_t len, count;   // text length and glyphs placed
+    uint8_t text[GFX_LAYOUT_CHARS];
+    gfxPlacedGlyph glyphs[GFX_LAYOUT_CHARS];
+} gfxLayout;
+
+static gfxLayout *gfxLayouts = NULL;        ///< Layout cache, shared by all displays
+static uint16_t gfxLayoutCount = 0;         ///< Layout cache slots
+static uint32_t gfxLayoutTick = 0;          ///< Counts layout cache lookups, for LRU eviction
+
+static SPSC_Queue gfxQueue;                 ///< Calls made on core0 for the core1 worker
+static volatile bool gfxWorker = false;     ///< Core1 owns the framebuffer and the display
 
 extern uint16_t _width;  ///< Display width as modified by current rotation
 extern uint16_t _height; ///< Display height as modified by current rotation
+extern int16_t _ystart;  ///< Frame memory row of screen row 0
+extern uint8_t rotation;
 
 static int16_t cursor_y = 0;
 int16_t cursor_x = 0;
@@ -42,6 +176,136 @@ uint8_t wrap = 1;
 
 GFXfont *gfxFont = NULL;
 
+typedef struct
+{
+    int16_t x0, y0, x1, y1; // inclusive corners
+} gfxRect;
+
+static gfxRect gfxDirty[GFX_MAX_DIRTY_RECTS]; ///< Regions changed since the last flush
+static uint8_t gfxDirtyCount = 0;
+
+typedef struct
+{
+    gfxRect clip;
+    int16_t originX, originY;
+} gfxClipEntry;
+
+static const gfxRect gfxNoClip = {0, 0, INT16_MAX, INT16_MAX};
+
+// The caller's origin and clip are applied as calls are made, so recorded
+// calls hold screen coordinates and GFX_OP_CLIP entries carry clip changes.
+static int16_t gfxOriginX = 0, gfxOriginY = 0;  ///< Added to the coordinates of drawing calls
+static gfxRect gfxClipArea = gfxNoClip;         ///< Screen area calls may draw into
+static gfxClipEntry gfxClipStack[GFX_CLIP_DEPTH]; ///< Saved by GFX_pushClip()
+static uint8_t gfxClipDepth = 0;
+static gfxRect gfxDrawClip = gfxNoClip;         ///< gfxClipArea as of the call being drawn
+static gfxRect gfxBandClip = gfxNoClip;         ///< gfxClipArea when the display list started
+static gfxRect gfxClip;                         ///< gfxDrawClip within the framebuffer, set per primitive
+
+// Drawing state of the selected display. GFX_selectDisplay() saves it into
+// the outgoing display's slot and loads the incoming one's. Transient vsync
+// and band replay state is not kept, as no frame is in flight at a switch.
+#define GFX_DISPLAY_STATE(X)                                                                   \
+    X(gfxFramebuffer) X(gfxFramebufs) X(gfxFlushCallback) X(gfxIndexBuf) X(gfxPalette)         \
+    X(gfxVsyncRowTime) X(gfxHwScroll) X(gfxScrollRow) X(gfxScrollPending) X(gfxCmds)           \
+    X(gfxRowHash) X(gfxRowHashValid) X(gfxRowHashRotation)                                     \
+    X(gfxCmdMax) X(gfxCmdCount) X(gfxCmdOverflow) X(gfxBandBufs) X(gfxBandLines) X(cursor_x)   \
+    X(cursor_y) X(textsize_x) X(textsize_y) X(textcolor) X(textbgcolor) X(clearColour) X(wrap) \
+    X(gfxFont) X(gfxDirty) X(gfxDirtyCount) X(gfxOriginX) X(gfxOriginY) X(gfxClipArea)          \
+    X(gfxClipStack) X(gfxClipDepth) X(gfxDrawClip) X(gfxBandClip)
+
+#define GFX_SAVED_FIELD(v) decltype(::v) v;
+#define GFX_SAVE(v) memcpy(&s->v, &::v, sizeof(::v));
+#define GFX_LOAD(v) memcpy(&::v, &s->v, sizeof(::v));
+
+typedef struct
+{
+    GFX_DISPLAY_STATE(GFX_SAVED_FIELD)
+} gfxState;
+
+static struct
+{
+    LCD_Display *display;
+    gfxState *state; ///< Allocated on first use of the display
+} gfxSlots[LCD_MAX_DISPLAYS];
+
+static inline int32_t rectCost(const gfxRect &r)
+{
+    return (int32_t)(r.x1 - r.x0 + 1) * (r.y1 - r.y0 + 1) * 2 + GFX_WINDOW_COST;
+}
+
+static inline gfxRect rectUnion(const gfxRect &a, const gfxRect &b)
+{
+    gfxRect u;
+    u.x0 = a.x0 < b.x0 ? a.x0 : b.x0;
+    u.y0 = a.y0 < b.y0 ? a.y0 : b.y0;
+    u.x1 = a.x1 > b.x1 ? a.x1 : b.x1;
+    u.y1 = a.y1 > b.y1 ? a.y1 : b.y1;
+    return u;
+}
+
+// Record that a framebuffer region changed. Rectangles are merged whenever
+// one window over their union costs less than two separate windows, and
+// once the list is full the new region joins whichever entry grows least.
+static void markDirty(int32_t x, int32_t y, int32_t w, int32_t h)
+{
+    if ((gfxFramebuffer == NULL && gfxIndexBuf == NULL) || gfxCmds != NULL)
+        return;
+
+    int32_t x1 = x + w - 1, y1 = y + h - 1;
+    if (x < 0)
+        x = 0;
+    if (y < 0)
+        y = 0;
+    if (x1 >= _width)
+        x1 = _width - 1;
+    if (y1 >= _height)
+        y1 = _height - 1;
+    if (x > x1 || y > y1)
+        return;
+
+    gfxRect r = {(int16_t)x, (int16_t)y, (int16_t)x1, (int16_t)y1};
+
+    for (uint8_t i = 0; i < gfxDirtyCount; i++)
+    {
+        const gfxRect &d = gfxDirty[i];
+        if (r.x0 >= d.x0 && r.x1 <= d.x1 && r.y0 >= d.y0 && r.y1 <= d.y1)
+            return; // already covered
+    }
+
+    for (uint8_t i = 0; i < gfxDirtyCount;)
+    {
+        gfxRect u = rectUnion(gfxDirty[i], r);
+        if (rectCost(u) <= rectCost(gfxDirty[i]) + rectCost(r))
+        {
+            r = u;
+            gfxDirty[i] = gfxDirty[--gfxDirtyCount];
+            i = 0; // the grown rect may now absorb earlier entries
+        }
+        else
+            i++;
+    }
+
+    if (gfxDirtyCount < GFX_MAX_DIRTY_RECTS)
+    {
+        gfxDirty[gfxDirtyCount++] = r;
+        return;
+    }
+
+    uint8_t best = 0;
+    int32_t bestGrowth = INT32_MAX;
+    for (uint8_t i = 0; i < gfxDirtyCount; i++)
+    {
+        int32_t growth = rectCost(rectUnion(gfxDirty[i], r)) - rectCost(gfxDirty[i]);
+        if (growth < bestGrowth)
+        {
+            bestGrowth = growth;
+            best = i;
+        }
+    }
+    gfxDirty[best] = rectUnion(gfxDirty[best], r);
+}
+
 uint GFX_getWidth()
 {
     return _width;
@@ -59,29 +323,300 @@ void GFX_setClearColor(uint16_t color)
 
 void GFX_clearScreen()
 {
-    GFX_fillRect(0, 0, _width, _height, clearColour);
+    GFX_fillScreen(clearColour);
 }
 
 void GFX_fillScreen(uint16_t color)
 {
-    GFX_fillRect(0, 0, _width, _height, color);
+    GFX_fillRect(-gfxOriginX, -gfxOriginY, _width, _height, color);
 }
 
-void GFX_drawPixel(int16_t x, int16_t y, uint16_t color)
+// In multicore mode calls made on core0 are passed to the worker on core1
+static inline bool queueing()
 {
-    if (gfxFramebuffer != NULL)
+    return gfxWorker && get_core_num() == 0;
+}
+
+// In band mode drawing calls are stored until GFX_flush() replays them
+static inline bool recording()
+{
+    return (gfxCmds != NULL && gfxFramebuffer == NULL) || queueing();
+}
+
+// Append a call touching screen rows y0..y1 (either order) to the display
+// list, or claim a queue slot for it in multicore mode. Returns NULL if
+// nothing needs recording; otherwise fill it in and call commitCmd().
+static gfxCmd *recordCmd(uint8_t op, int32_t y0, int32_t y1)
+{
+    int32_t top = y0 < y1 ? y0 : y1, bottom = y0 < y1 ? y1 : y0;
+    if (bottom < 0 || top >= _height)
+        return NULL;
+    // Calls outside the clip never draw; the rest only replay in the strips it covers
+    const gfxRect &clip = gfxClipArea;
+    if (clip.x0 > clip.x1 || clip.y0 > clip.y1 || bottom < clip.y0 || top > clip.y1)
+        return NULL;
+    if (top < clip.y0)
+        top = clip.y0;
+    if (bottom > clip.y1)
+        bottom = clip.y1;
+
+    gfxCmd *c;
+    if (gfxWorker)
+        c = static_cast<gfxCmd *>(SPSC_beginPush(&gfxQueue)); // waits while core1 catches up
+    else if (gfxCmdCount == gfxCmdMax)
     {
-        if ((x < 0) || (y < 0) || (x >= _width) || (y >= _height))
-            return;
-        gfxFramebuffer[x + y * _width] = color; //(color >> 8) | (color << 8);
-        gfxFbUpdated = true;
+        gfxCmdOverflow = true;
+        return NULL;
+    }
+    else
+        c = &gfxCmds[gfxCmdCount++];
+    c->op = op;
+    c->top = top < 0 ? 0 : top;
+    c->bottom = bottom >= _height ? _height - 1 : bottom;
+    return c;
+}
+
+// Publish a call filled in after recordCmd() to the core1 worker
+static inline void commitCmd()
+{
+    if (gfxWorker)
+        SPSC_endPush(&gfxQueue);
+}
+
+// Queue a call that takes no drawing arguments for the core1 worker
+static void queueOp(uint8_t op, int16_t arg)
+{
+    gfxCmd *c = static_cast<gfxCmd *>(SPSC_beginPush(&gfxQueue));
+    c->op = op;
+    c->x0 = arg;
+    SPSC_endPush(&gfxQueue);
+}
+
+// One past the last screen row held in gfxFramebuffer
+static inline int16_t fbBottom()
+{
+    return gfxBandBottom ? gfxBandBottom : _height;
+}
+
+// Framebuffer row holding screen row y
+static inline int32_t fbRow(int32_t y)
+{
+    int32_t row = y - gfxBandTop + gfxScrollRow;
+    return row >= _height ? row - _height : row;
+}
+
+// Recorded calls already hold screen coordinates when they are replayed
+static inline bool replaying()
+{
+    return gfxBandBottom != 0 || (gfxWorker && get_core_num() == 1);
+}
+
+// Move the coordinates of a call from the caller's origin to the screen
+static inline void toScreen(int16_t &x, int16_t &y)
+{
+    if (!replaying())
+    {
+        x += gfxOriginX;
+        y += gfxOriginY;
     }
+}
+
+// Limit drawing to the screen, or the rows held in the framebuffer in band mode
+static inline void clipToScreen()
+{
+    gfxClip.x0 = 0;
+    gfxClip.y0 = gfxBandTop;
+    gfxClip.x1 = _width - 1;
+    gfxClip.y1 = fbBottom() - 1;
+}
+
+// Set up the clip for one primitive
+static inline void beginClip()
+{
+    clipToScreen();
+    if (gfxDrawClip.x0 > gfxClip.x0)
+        gfxClip.x0 = gfxDrawClip.x0;
+    if (gfxDrawClip.y0 > gfxClip.y0)
+        gfxClip.y0 = gfxDrawClip.y0;
+    if (gfxDrawClip.x1 < gfxClip.x1)
+        gfxClip.x1 = gfxDrawClip.x1;
+    if (gfxDrawClip.y1 < gfxClip.y1)
+        gfxClip.y1 = gfxDrawClip.y1;
+}
+
+// Check whether a primitive's bounds miss the clip entirely
+static inline bool clipRejects(int32_t x, int32_t y, int32_t w, int32_t h)
+{
+    return w <= 0 || h <= 0 || x > gfxClip.x1 || y > gfxClip.y1 || x + w <= gfxClip.x0 || y + h <= gfxClip.y0;
+}
+
+// Check whether a primitive's bounds lie wholly inside the clip
+static inline bool clipContains(int32_t x, int32_t y, int32_t w, int32_t h)
+{
+    return x >= gfxClip.x0 && y >= gfxClip.y0 && x + w - 1 <= gfxClip.x1 && y + h - 1 <= gfxClip.y1;
+}
+
+// Mark the part of a primitive's bounds inside the clip as damaged
+static void markClipped(int32_t x, int32_t y, int32_t w, int32_t h)
+{
+    int32_t x1 = x + w - 1, y1 = y + h - 1;
+    if (x < gfxClip.x0)
+        x = gfxClip.x0;
+    if (y < gfxClip.y0)
+        y = gfxClip.y0;
+    if (x1 > gfxClip.x1)
+        x1 = gfxClip.x1;
+    if (y1 > gfxClip.y1)
+        y1 = gfxClip.y1;
+    if (x <= x1 && y <= y1)
+        markDirty(x, y, x1 - x + 1, y1 - y + 1);
+}
+
+// Pixel write for coordinates already known to be inside the clip
+static inline void putPixel(int16_t x, int16_t y, uint16_t color)
+{
+    if (gfxFramebuffer != NULL)
+        gfxFramebuffer[x + fbRow(y) * _width] = color; //(color >> 8) | (color << 8);
+    else if (gfxIndexBuf != NULL)
+        gfxIndexBuf[x + y * _width] = color;
     else
         LCD_WritePixel(x, y, color);
 }
 
-void GFX_drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color)
+// Pixel write used by all primitives; damage is marked once per primitive
+static inline void writePixel(int16_t x, int16_t y, uint16_t color)
+{
+    if ((x < gfxClip.x0) || (y < gfxClip.y0) || (x > gfxClip.x1) || (y > gfxClip.y1))
+        return;
+    putPixel(x, y, color);
+}
+
+// Make a screen area the clip for the calls that follow
+static void setClipArea(const gfxRect &r)
+{
+    gfxClipArea = r;
+    if (!recording())
+    {
+        gfxDrawClip = r;
+        return;
+    }
+    // An empty clip needs no entry: recordCmd() drops every call until the next one
+    gfxCmd *c = recordCmd(GFX_OP_CLIP, r.y0, r.y1);
+    if (c)
+    {
+        c->x0 = r.x0;
+        c->y0 = r.y0;
+        c->x1 = r.x1;
+        c->y1 = r.y1;
+        commitCmd();
+    }
+}
+
+bool GFX_pushClip(int16_t x, int16_t y, int16_t w, int16_t h)
+{
+    if (gfxClipDepth == GFX_CLIP_DEPTH)
+        return false;
+    gfxClipEntry &e = gfxClipStack[gfxClipDepth++];
+    e.clip = gfxClipArea;
+    e.originX = gfxOriginX;
+    e.originY = gfxOriginY;
+
+    // Intersect with the current clip; an empty result is x0 > x1 or y0 > y1
+    int32_t x0 = (int32_t)x + gfxOriginX, y0 = (int32_t)y + gfxOriginY;
+    int32_t x1 = x0 + w - 1, y1 = y0 + h - 1;
+    gfxRect r;
+    r.x0 = x0 > gfxClipArea.x0 ? x0 : gfxClipArea.x0;
+    r.y0 = y0 > gfxClipArea.y0 ? y0 : gfxClipArea.y0;
+    r.x1 = x1 < gfxClipArea.x1 ? x1 : gfxClipArea.x1;
+    r.y1 = y1 < gfxClipArea.y1 ? y1 : gfxClipArea.y1;
+    setClipArea(r);
+    return true;
+}
+
+bool GFX_pushViewport(int16_t x, int16_t y, int16_t w, int16_t h)
+{
+    if (!GFX_pushClip(x, y, w, h))
+        return false;
+    gfxOriginX += x;
+    gfxOriginY += y;
+    return true;
+}
+
+void GFX_popClip()
+{
+    if (gfxClipDepth == 0)
+        return;
+    const gfxClipEntry &e = gfxClipStack[--gfxClipDepth];
+    gfxOriginX = e.originX;
+    gfxOriginY = e.originY;
+    setClipArea(e.clip);
+}
+
+void GFX_setOrigin(int16_t x, int16_t y)
+{
+    gfxOriginX = x;
+    gfxOriginY = y;
+}
+
+int16_t GFX_getOriginX()
 {
+    return gfxOriginX;
+}
+
+int16_t GFX_getOriginY()
+{
+    return gfxOriginY;
+}
+
+void GFX_drawPixel(int16_t x, int16_t y, uint16_t color)
+{
+    toScreen(x, y);
+    if (recording())
+    {
+        gfxCmd *c = recordCmd(GFX_OP_PIXEL, y, y);
+        if (c)
+        {
+            c->x0 = x;
+            c->y0 = y;
+            c->color = color;
+            commitCmd();
+        }
+        return;
+    }
+    beginClip();
+    writePixel(x, y, color);
+    markClipped(x, y, 1, 1);
+}
+
+static void writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+static void writeFillRectAlpha(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color, uint8_t alpha);
+
+// Bresenham line, clipped before it is walked and drawn as runs of pixels
+// that share a row (or a column, if steep). Draws the same pixels as
+// stepping the error term one pixel at a time. skipFirst leaves out (x0, y0),
+// where the previous line of a batch ended.
+static void writeLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color, bool skipFirst = false,
+                      uint8_t alpha = GFX_ALPHA_OPAQUE)
+{
+    // Axis-aligned lines are spans
+    if (y0 == y1 || x0 == x1)
+    {
+        if (skipFirst)
+        {
+            if (x0 == x1 && y0 == y1)
+                return;
+            if (x0 == x1)
+                y0 += y0 < y1 ? 1 : -1;
+            else
+                x0 += x0 < x1 ? 1 : -1;
+        }
+        int16_t left = x0 < x1 ? x0 : x1, top = y0 < y1 ? y0 : y1;
+        if (alpha != GFX_ALPHA_OPAQUE)
+            writeFillRectAlpha(left, top, abs(x1 - x0) + 1, abs(y1 - y0) + 1, color, alpha);
+        else
+            writeFillRect(left, top, abs(x1 - x0) + 1, abs(y1 - y0) + 1, color);
+        return;
+    }
 
     int16_t steep = abs(y1 - y0) > abs(x1 - x0);
     if (steep)
@@ -90,391 +625,2899 @@ void GFX_drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color
         swap(x1, y1);
     }
 
-    if (x0 > x1)
+    bool reversed = x0 > x1;
+    if (reversed)
     {
         swap(x0, x1);
         swap(y0, y1);
     }
 
-    int16_t dx, dy;
-    dx = x1 - x0;
-    dy = abs(y1 - y0);
-
-    int16_t err = dx / 2;
-    int16_t ystep;
-
-    if (y0 < y1)
+    int32_t dx = x1 - x0, dy = abs(y1 - y0);
+    int32_t ystep = y0 < y1 ? 1 : -1;
+
+    // Clip in the swapped frame: x is the major axis, y the minor one
+    int32_t cx0 = steep ? gfxClip.y0 : gfxClip.x0, cx1 = steep ? gfxClip.y1 : gfxClip.x1;
+    int32_t cy0 = steep ? gfxClip.x0 : gfxClip.y0, cy1 = steep ? gfxClip.x1 : gfxClip.y1;
+
+    // Step k (0..dx) draws x0 + k, y0 + ystep * m(k). The error term starts
+    // at dx / 2 and stays in 0..dx-1, so m(k) = ceil((k * dy - dx / 2) / dx).
+    // Solve for the steps whose x and y are both inside the clip.
+    int32_t k0 = cx0 - x0 > 0 ? cx0 - x0 : 0;
+    int32_t k1 = cx1 - x0 < dx ? cx1 - x0 : dx;
+    int32_t mlo = ystep > 0 ? cy0 - y0 : y0 - cy1;
+    int32_t mhi = ystep > 0 ? cy1 - y0 : y0 - cy0;
+    if (mhi < 0 || mlo > dy)
+        return;
+    if (mlo > 0)
     {
-        ystep = 1;
+        int32_t k = ((int64_t)(mlo - 1) * dx + dx / 2) / dy + 1; // first step with m(k) >= mlo
+        if (k > k0)
+            k0 = k;
     }
-    else
+    if (mhi < dy)
     {
-        ystep = -1;
+        int32_t k = ((int64_t)mhi * dx + dx / 2) / dy; // last step with m(k) <= mhi
+        if (k < k1)
+            k1 = k;
     }
-
-    for (; x0 <= x1; x0++)
+    if (skipFirst && !reversed && k0 == 0)
+        k0 = 1;
+    if (skipFirst && reversed && k1 == dx)
+        k1 = dx - 1;
+    if (k0 > k1)
+        return;
+
+    int64_t a = (int64_t)k0 * dy - dx / 2;
+    int32_t m = a <= 0 ? 0 : (a + dx - 1) / dx;
+    int32_t err = dx / 2 - (int64_t)k0 * dy + (int64_t)m * dx;
+    int32_t x = x0 + k0, y = y0 + ystep * m;
+
+    for (int32_t left = k1 - k0 + 1; left > 0;)
     {
-        if (steep)
+        // Pixels until the error term goes negative share the minor coordinate
+        int32_t n = err / dy + 1;
+        if (n > left)
+            n = left;
+        if (alpha != GFX_ALPHA_OPAQUE)
+        {
+            if (steep)
+                writeFillRectAlpha(y, x, 1, n, color, alpha);
+            else
+                writeFillRectAlpha(x, y, n, 1, color, alpha);
+        }
+        else if (steep)
         {
-            GFX_drawPixel(y0, x0, color);
+            if (n == 1)
+                putPixel(y, x, color);
+            else
+                writeFillRect(y, x, 1, n, color);
         }
         else
         {
-            GFX_drawPixel(x0, y0, color);
+            if (n == 1)
+                putPixel(x, y, color);
+            else
+                writeFillRect(x, y, n, 1, color);
         }
-        err -= dy;
-        if (err < 0)
+        x += n;
+        left -= n;
+        err -= n * dy - dx; // a whole run always ends with a step in y
+        y += ystep;
+    }
+}
+
+// Draw or record a line in screen coordinates
+static void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color, bool skipFirst,
+                     uint8_t alpha = GFX_ALPHA_OPAQUE)
+{
+    if (recording())
+    {
+        gfxCmd *c = recordCmd(GFX_OP_LINE, y0, y1);
+        if (c)
         {
-            y0 += ystep;
-            err += dx;
+            c->c = skipFirst;
+            c->x0 = x0;
+            c->y0 = y0;
+            c->x1 = x1;
+            c->y1 = y1;
+            c->color = color;
+            c->bg = alpha;
+            commitCmd();
         }
+        return;
     }
+    int16_t left = x0 < x1 ? x0 : x1, top = y0 < y1 ? y0 : y1;
+    int16_t w = abs(x1 - x0) + 1, h = abs(y1 - y0) + 1;
+    beginClip();
+    if (alpha == 0 || clipRejects(left, top, w, h))
+        return;
+    writeLine(x0, y0, x1, y1, color, skipFirst, alpha);
+    markClipped(left, top, w, h);
 }
 
-void GFX_drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color)
+void GFX_drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color)
 {
-    GFX_drawLine(x, y, x, y + h - 1, color);
+    toScreen(x0, y0);
+    toScreen(x1, y1);
+    drawLine(x0, y0, x1, y1, color, false);
 }
 
-void GFX_drawFastHLine(int16_t x, int16_t y, int16_t l, uint16_t color)
+void GFX_drawLineAlpha(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color, uint8_t alpha)
 {
-    GFX_drawLine(x, y, x + l - 1, y, color);
+    toScreen(x0, y0);
+    toScreen(x1, y1);
+    drawLine(x0, y0, x1, y1, color, false, alpha);
 }
 
-void GFX_fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+// Draw count lines from (x0[i*step], y0[i*step]) to (x1[i*step], y1[i*step]).
+// The clip is set up and damage marked once for the whole batch, and a line
+// starting where the previous one ended leaves out that shared pixel.
+static void drawLines(const int16_t *x0, const int16_t *y0, const int16_t *x1, const int16_t *y1,
+                      uint16_t step, uint16_t count, uint16_t color)
 {
-    for (int16_t i = x; i < x + w; i++)
+    if (count == 0)
+        return;
+    if (recording())
+    {
+        // Recorded line by line, so band strips only replay the lines they hold
+        int16_t lastX = 0, lastY = 0;
+        for (uint32_t i = 0; i < (uint32_t)count * step; i += step)
+        {
+            int16_t ax = x0[i], ay = y0[i], bx = x1[i], by = y1[i];
+            toScreen(ax, ay);
+            toScreen(bx, by);
+            drawLine(ax, ay, bx, by, color, i > 0 && ax == lastX && ay == lastY);
+            lastX = bx;
+            lastY = by;
+        }
+        return;
+    }
+
+    int32_t left = INT32_MAX, top = INT32_MAX, right = INT32_MIN, bottom = INT32_MIN;
+    for (uint32_t i = 0; i < (uint32_t)count * step; i += step)
+    {
+        left = x0[i] < left ? x0[i] : left;
+        left = x1[i] < left ? x1[i] : left;
+        right = x0[i] > right ? x0[i] : right;
+        right = x1[i] > right ? x1[i] : right;
+        top = y0[i] < top ? y0[i] : top;
+        top = y1[i] < top ? y1[i] : top;
+        bottom = y0[i] > bottom ? y0[i] : bottom;
+        bottom = y1[i] > bottom ? y1[i] : bottom;
+    }
+    int16_t dx = 0, dy = 0;
+    toScreen(dx, dy);
+    beginClip();
+    if (clipRejects(left + dx, top + dy, right - left + 1, bottom - top + 1))
+        return;
+
+    int16_t lastX = 0, lastY = 0;
+    for (uint32_t i = 0; i < (uint32_t)count * step; i += step)
     {
-        GFX_drawFastVLine(i, y, h, color);
+        int16_t ax = x0[i] + dx, ay = y0[i] + dy, bx = x1[i] + dx, by = y1[i] + dy;
+        bool skipFirst = i > 0 && ax == lastX && ay == lastY;
+        lastX = bx;
+        lastY = by;
+        if (!clipRejects(ax < bx ? ax : bx, ay < by ? ay : by, abs(bx - ax) + 1, abs(by - ay) + 1))
+            writeLine(ax, ay, bx, by, color, skipFirst);
     }
+    markClipped(left + dx, top + dy, right - left + 1, bottom - top + 1);
 }
 
-void GFX_drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+void GFX_drawPolyline(const int16_t *xs, const int16_t *ys, uint16_t n, uint16_t color)
 {
-    GFX_drawFastHLine(x, y, w, color);
-    GFX_drawFastHLine(x, y + h - 1, w, color);
-    GFX_drawFastVLine(x, y, h, color);
-    GFX_drawFastVLine(x + w - 1, y, h, color);
+    if (n == 1)
+        GFX_drawPixel(xs[0], ys[0], color);
+    else if (n > 1)
+        drawLines(xs, ys, xs + 1, ys + 1, 1, n - 1, color);
 }
 
-void GFX_drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color,
-                  uint16_t bg, uint8_t size_x, uint8_t size_y)
+void GFX_drawSegments(const int16_t *xy, uint16_t count, uint16_t color)
 {
-    if (!gfxFont)
-    {
-        if ((x >= _width) ||              // Clip right
-            (y >= _height) ||             // Clip bottom
-            ((x + 6 * size_x - 1) < 0) || // Clip left
-            ((y + 8 * size_y - 1) < 0))   // Clip top
-            return;
+    drawLines(xy, xy + 1, xy + 2, xy + 3, 4, count, color);
+}
 
-        if (c >= 176)
-            c++; // Handle 'classic' charset behavior
+static void dmaFill(void *dest, uint32_t pattern, size_t num);
 
-        // GFX_Select();
-        for (int8_t i = 0; i < 5; i++)
-        { // Char bitmap = 5 columns
-            uint8_t line = font[c * 5 + i];
-            for (int8_t j = 0; j < 8; j++, line >>= 1)
-            {
-                if (line & 1)
-                {
-                    if (size_x == 1 && size_y == 1)
-                        GFX_drawPixel(x + i, y + j, color);
-                    else
-                        GFX_fillRect(x + i * size_x, y + j * size_y, size_x,
-                                     size_y, color);
-                }
-                else if (bg != color)
-                {
-                    if (size_x == 1 && size_y == 1)
-                        GFX_drawPixel(x + i, y + j, bg);
-                    else
-                        GFX_fillRect(x + i * size_x, y + j * size_y, size_x,
-                                     size_y, bg);
-                }
-            }
-        }
-        if (bg != color)
-        { // If opaque, draw vertical line for last column
-            if (size_x == 1 && size_y == 1)
-                GFX_drawFastVLine(x + 5, y, 8, bg);
-            else
-                GFX_fillRect(x + 5 * size_x, y, size_x, 8 * size_y, bg);
-        }
-        // GFX_DeSelect();
+// Fill a run of framebuffer pixels, two per 32-bit store
+static inline void fillPixels(uint16_t *p, uint32_t n, uint16_t color)
+{
+    if (n >= GFX_DMA_FILL_MIN)
+    {
+        dmaFill(p, color * 0x00010001u, n * 2);
+        return;
     }
-    else
+    if (n > 0 && ((uintptr_t)p & 2))
+    {
+        *p++ = color;
+        n--;
+    }
+    uint32_t pair = color * 0x00010001u;
+    uint32_t *w = reinterpret_cast<uint32_t *>(p);
+    uint32_t pairs = n >> 1;
+    for (; pairs >= 4; pairs -= 4, w += 4)
     {
-        c -= (uint8_t)gfxFont->first;
-        GFXglyph *glyph = (gfxFont->glyph) + c;
-        uint8_t *bitmap = gfxFont->bitmap;
+        w[0] = pair;
+        w[1] = pair;
+        w[2] = pair;
+        w[3] = pair;
+    }
+    while (pairs--)
+        *w++ = pair;
+    if (n & 1)
+        *reinterpret_cast<uint16_t *>(w) = color;
+}
 
-        uint16_t bo = glyph->bitmapOffset;
-        uint8_t w = glyph->width, h = glyph->height;
-        int8_t xo = glyph->xOffset, yo = glyph->yOffset;
-        uint8_t xx, yy, bits = 0, bit = 0;
-        int16_t xo16 = 0, yo16 = 0;
+// RGB565 blending works on 0..32 alpha so every channel can be scaled with
+// one multiply. A pixel spread to 32 bits (green moved to the top half) has
+// 5 spare bits above each channel. Two pixels packed in a 32-bit word are
+// split the same way into one part holding the blue and red of the low pixel
+// with the green of the high one, and a part (shifted down 5) with the rest.
+#define GFX_BLEND_SPREAD 0x07E0F81Fu
+#define GFX_BLEND_EVEN 0x07E0F81Fu
+#define GFX_BLEND_ODD 0xF81F07E0u
+
+// Alpha 0..255 to the 0..32 scale used by the blend kernels
+static inline uint32_t blendScale(uint8_t alpha)
+{
+    return (alpha + 4) >> 3;
+}
 
-        if (size_x > 1 || size_y > 1)
-        {
-            xo16 = xo;
-            yo16 = yo;
-        }
+// Blend fg over bg with a 0..32 alpha
+static inline uint16_t blendPixel(uint16_t bg, uint16_t fg, uint32_t a)
+{
+    uint32_t b = (bg | (uint32_t)bg << 16) & GFX_BLEND_SPREAD;
+    uint32_t f = (fg | (uint32_t)fg << 16) & GFX_BLEND_SPREAD;
+    uint32_t r = ((f * a + b * (32 - a)) >> 5) & GFX_BLEND_SPREAD;
+    return r | r >> 16;
+}
 
-        // GFX_Select();
-        for (yy = 0; yy < h; yy++)
-        {
-            for (xx = 0; xx < w; xx++)
-            {
-                if (!(bit++ & 7))
-                {
-                    bits = bitmap[bo++];
-                }
-                if (bits & 0x80)
-                {
-                    if (size_x == 1 && size_y == 1)
-                    {
-                        GFX_drawPixel(x + xo + xx, y + yo + yy, color);
-                    }
-                    else
-                    {
-                        GFX_fillRect(x + (xo16 + xx) * size_x,
-                                     y + (yo16 + yy) * size_y, size_x, size_y,
-                                     color);
-                    }
-                }
-                bits <<= 1;
-            }
-        }
-        // GFX_DeSelect();
-    }
+// Blend a word of two pixels; fgEven and fgOdd are the split foreground
+// already multiplied by alpha, inv is 32 - alpha
+static inline uint32_t blendPair(uint32_t bg, uint32_t fgEven, uint32_t fgOdd, uint32_t inv)
+{
+    uint32_t even = (((bg & GFX_BLEND_EVEN) * inv + fgEven) >> 5) & GFX_BLEND_EVEN;
+    uint32_t odd = ((((bg & GFX_BLEND_ODD) >> 5) * inv + fgOdd) >> 5) & (GFX_BLEND_ODD >> 5);
+    return even | odd << 5;
 }
 
-void GFX_write(uint8_t c)
+// Blend one color over a run of framebuffer pixels, two per 32-bit word
+static void blendPixels(uint16_t *p, uint32_t n, uint16_t color, uint32_t a)
 {
-    if (!gfxFont)
+    uint32_t pair = color * 0x00010001u;
+    uint32_t fgEven = (pair & GFX_BLEND_EVEN) * a, fgOdd = ((pair & GFX_BLEND_ODD) >> 5) * a;
+    uint32_t inv = 32 - a;
+    if (n > 0 && ((uintptr_t)p & 2))
     {
-        if (c == '\n')
-        {                               // Newline?
-            cursor_x = 0;               // Reset x to zero,
-            cursor_y += textsize_y * 8; // advance y one line
-        }
-        else if (c != '\r')
-        { // Ignore carriage returns
-            if (wrap && ((cursor_x + textsize_x * 6) > _width))
-            {                               // Off right?
-                cursor_x = 0;               // Reset x to zero,
-                cursor_y += textsize_y * 8; // advance y one line
-            }
-            GFX_drawChar(cursor_x, cursor_y, c, textcolor, textbgcolor,
-                         textsize_x, textsize_y);
-            cursor_x += textsize_x * 6; // Advance x one char
-        }
+        *p = blendPair(*p, fgEven, fgOdd, inv);
+        p++;
+        n--;
+    }
+    uint32_t *w = reinterpret_cast<uint32_t *>(p);
+    for (uint32_t pairs = n >> 1; pairs > 0; pairs--, w++)
+        *w = blendPair(*w, fgEven, fgOdd, inv);
+    if (n & 1)
+    {
+        uint16_t *last = reinterpret_cast<uint16_t *>(w);
+        *last = blendPair(*last, fgEven, fgOdd, inv);
+    }
+}
+
+// Blend a run of source pixels over the framebuffer with one alpha
+static void blendRow(uint16_t *p, const uint16_t *src, uint32_t n, uint32_t a)
+{
+    uint32_t inv = 32 - a;
+    if (n > 0 && ((uintptr_t)p & 2))
+    {
+        *p = blendPixel(*p, *src++, a);
+        p++;
+        n--;
+    }
+    uint32_t *w = reinterpret_cast<uint32_t *>(p);
+    for (; n >= 2; n -= 2, w++, src += 2)
+    {
+        uint32_t pair = src[0] | (uint32_t)src[1] << 16; // src may not be word aligned
+        *w = blendPair(*w, (pair & GFX_BLEND_EVEN) * a, ((pair & GFX_BLEND_ODD) >> 5) * a, inv);
+    }
+    if (n)
+    {
+        uint16_t *last = reinterpret_cast<uint16_t *>(w);
+        *last = blendPixel(*last, *src, a);
+    }
+}
+
+// Clip a rectangle to x0..x1-1, y0..y1-1; false if nothing is left. The clip
+// lies within the rows held in the framebuffer.
+static inline bool clipRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                            int32_t &x0, int32_t &y0, int32_t &x1, int32_t &y1)
+{
+    x0 = x < gfxClip.x0 ? gfxClip.x0 : x;
+    y0 = y < gfxClip.y0 ? gfxClip.y0 : y;
+    x1 = (int32_t)x + w;
+    y1 = (int32_t)y + h;
+    if (x1 > gfxClip.x1 + 1)
+        x1 = gfxClip.x1 + 1;
+    if (y1 > gfxClip.y1 + 1)
+        y1 = gfxClip.y1 + 1;
+    return x1 > x0 && y1 > y0;
+}
+
+static void writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+    int32_t x0, y0, x1, y1;
+    if (!clipRect(x, y, w, h, x0, y0, x1, y1))
+        return;
+
+    if (gfxIndexBuf != NULL)
+    {
+        if (x1 - x0 == _width) // whole rows are one run
+            memset(gfxIndexBuf + y0 * _width, color, (y1 - y0) * _width);
+        else
+            for (int32_t j = y0; j < y1; j++)
+                memset(gfxIndexBuf + x0 + j * _width, color, x1 - x0);
+        return;
+    }
+
+    if (gfxFramebuffer == NULL)
+    {
+        // One address window instead of a 1x1 window per pixel
+        LCD_fillRect(x0, y0, x1 - x0, y1 - y0, color);
+        return;
+    }
+
+    int32_t row = fbRow(y0);
+    int32_t rows = y1 - y0;
+    if (x1 - x0 == _width)
+    {
+        // Whole rows are one run up to the end of the row ring
+        while (rows > 0)
+        {
+            int32_t n = _height - row < rows ? _height - row : rows;
+            fillPixels(gfxFramebuffer + row * _width, n * _width, color);
+            rows -= n;
+            row = 0;
+        }
+        return;
+    }
+
+    for (uint16_t *p = gfxFramebuffer + x0 + row * _width; rows > 0; rows--)
+    {
+        fillPixels(p, x1 - x0, color);
+        p += _width;
+        if (++row == _height)
+        {
+            row = 0;
+            p = gfxFramebuffer + x0;
+        }
+    }
+}
+
+// Blend a rectangle over the framebuffer. Without an RGB565 framebuffer
+// there is nothing to blend with, so mostly opaque fills are drawn solid and
+// the rest skipped.
+static void writeFillRectAlpha(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color, uint8_t alpha)
+{
+    uint32_t a = blendScale(alpha);
+    if (a == 32 || (gfxFramebuffer == NULL && a > 16))
+    {
+        writeFillRect(x, y, w, h, color);
+        return;
+    }
+    int32_t x0, y0, x1, y1;
+    if (a == 0 || gfxFramebuffer == NULL || !clipRect(x, y, w, h, x0, y0, x1, y1))
+        return;
+
+    int32_t row = fbRow(y0);
+    for (uint16_t *p = gfxFramebuffer + x0 + row * _width; y0 < y1; y0++)
+    {
+        blendPixels(p, x1 - x0, color, a);
+        p += _width;
+        if (++row == _height)
+        {
+            row = 0;
+            p = gfxFramebuffer + x0;
+        }
+    }
+}
+
+static void writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color)
+{
+    writeFillRect(x, h < 0 ? y + h + 1 : y, 1, abs(h), color);
+}
+
+static void writeFastHLine(int16_t x, int16_t y, int16_t l, uint16_t color)
+{
+    writeFillRect(l < 0 ? x + l + 1 : x, y, abs(l), 1, color);
+}
+
+void GFX_drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color)
+{
+    toScreen(x, y);
+    if (recording())
+    {
+        gfxCmd *c = recordCmd(GFX_OP_VLINE, y, y + h - 1);
+        if (c)
+        {
+            c->x0 = x;
+            c->y0 = y;
+            c->y1 = h;
+            c->color = color;
+            commitCmd();
+        }
+        return;
+    }
+    beginClip();
+    writeFastVLine(x, y, h, color);
+    markClipped(x, y, 1, h);
+}
+
+void GFX_drawFastHLine(int16_t x, int16_t y, int16_t l, uint16_t color)
+{
+    toScreen(x, y);
+    if (recording())
+    {
+        gfxCmd *c = recordCmd(GFX_OP_HLINE, y, y);
+        if (c)
+        {
+            c->x0 = x;
+            c->y0 = y;
+            c->x1 = l;
+            c->color = color;
+            commitCmd();
+        }
+        return;
+    }
+    beginClip();
+    writeFastHLine(x, y, l, color);
+    markClipped(x, y, l, 1);
+}
+
+void GFX_fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+    toScreen(x, y);
+    if (recording())
+    {
+        gfxCmd *c = recordCmd(GFX_OP_FILLRECT, y, y + h - 1);
+        if (c)
+        {
+            c->x0 = x;
+            c->y0 = y;
+            c->x1 = w;
+            c->y1 = h;
+            c->color = color;
+            commitCmd();
+        }
+        return;
+    }
+    beginClip();
+    writeFillRect(x, y, w, h, color);
+    markClipped(x, y, w, h);
+}
+
+void GFX_fillRectAlpha(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color, uint8_t alpha)
+{
+    toScreen(x, y);
+    if (recording())
+    {
+        gfxCmd *c = alpha ? recordCmd(GFX_OP_FILLRECTALPHA, y, y + h - 1) : NULL;
+        if (c)
+        {
+            c->x0 = x;
+            c->y0 = y;
+            c->x1 = w;
+            c->y1 = h;
+            c->color = color;
+            c->bg = alpha;
+            commitCmd();
+        }
+        return;
+    }
+    beginClip();
+    writeFillRectAlpha(x, y, w, h, color, alpha);
+    markClipped(x, y, w, h);
+}
+
+void GFX_drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+    GFX_drawFastHLine(x, y, w, color);
+    GFX_drawFastHLine(x, y + h - 1, w, color);
+    GFX_drawFastVLine(x, y, h, color);
+    GFX_drawFastVLine(x + w - 1, y, h, color);
+}
+
+// Check pixel (col, row) of a glyph; src is the glyph's first byte
+static inline bool glyphBit(const GFXfont *f, const uint8_t *src, uint8_t w, uint8_t col, uint8_t row)
+{
+    if (!f)
+        return (src[col] >> row) & 1; // classic font: one byte per column
+    uint16_t bit = row * w + col;
+    return (src[bit >> 3] << (bit & 7)) & 0x80;
+}
+
+// Find a glyph in the cache, or encode it into the least recently used slot.
+// Returns NULL if the cache is off or the glyph does not fit in a slot.
+static const gfxGlyph *cachedGlyph(const GFXfont *f, const uint8_t *src, uint8_t w, uint8_t h,
+                                   unsigned char c, uint8_t size_x, uint8_t size_y)
+{
+    if (gfxGlyphs == NULL || w * size_x > 255)
+        return NULL;
+    gfxGlyph *victim = gfxGlyphs;
+    for (gfxGlyph *g = gfxGlyphs; g < gfxGlyphs + gfxGlyphCount; g++)
+    {
+        if (g->sx == size_x && g->c == c && g->sy == size_y && g->font == f)
+        {
+            g->lastUse = ++gfxGlyphTick;
+            return g;
+        }
+        if (victim->sx != 0 && (g->sx == 0 || g->lastUse < victim->lastUse))
+            victim = g;
+    }
+
+    // Encode first, so a glyph too big to cache evicts nothing
+    uint8_t spans[GFX_GLYPH_SPAN_BYTES];
+    uint8_t *out = spans, *end = spans + GFX_GLYPH_SPAN_BYTES;
+    for (uint8_t row = 0; row < h; row++)
+    {
+        if (out == end)
+            return NULL;
+        uint8_t *count = out++;
+        *count = 0;
+        for (uint8_t col = 0; col < w;)
+        {
+            if (!glyphBit(f, src, w, col, row))
+            {
+                col++;
+                continue;
+            }
+            uint8_t start = col;
+            while (col < w && glyphBit(f, src, w, col, row))
+                col++;
+            if (end - out < 2)
+                return NULL;
+            *out++ = start * size_x;
+            *out++ = (col - start) * size_x;
+            (*count)++;
+        }
+    }
+    gfxGlyph *g = victim;
+    memcpy(g->spans, spans, out - spans);
+    g->font = f;
+    g->c = c;
+    g->sx = size_x;
+    g->sy = size_y;
+    g->rows = h;
+    g->lastUse = ++gfxGlyphTick;
+    return g;
+}
+
+// Fill one run of a glyph; inside means the glyph lies within the clip
+static inline void fillGlyphRun(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color, bool inside)
+{
+    if (!inside || gfxFramebuffer == NULL)
+    {
+        writeFillRect(x, y, w, h, color);
+        return;
+    }
+    for (int16_t j = 0; j < h; j++)
+        fillPixels(gfxFramebuffer + x + fbRow(y + j) * _width, w, color);
+}
+
+// Draw a cached glyph with its top-left corner at (x, y). If cellWidth is not
+// 0 the gaps between runs, up to that width, are filled with bg.
+static void drawCachedGlyph(const gfxGlyph *g, int16_t x, int16_t y, uint16_t color, uint16_t bg,
+                            int16_t cellWidth, bool inside)
+{
+    const uint8_t *s = g->spans;
+    for (uint8_t row = 0; row < g->rows; row++, y += g->sy)
+    {
+        int16_t done = 0;
+        for (uint8_t n = *s++; n > 0; n--, s += 2)
+        {
+            if (cellWidth && s[0] > done)
+                fillGlyphRun(x + done, y, s[0] - done, g->sy, bg, inside);
+            fillGlyphRun(x + s[0], y, s[1], g->sy, color, inside);
+            done = s[0] + s[1];
+        }
+        if (cellWidth > done)
+            fillGlyphRun(x + done, y, cellWidth - done, g->sy, bg, inside);
+    }
+}
+
+static void writeChar(const GFXfont *f, int16_t x, int16_t y, unsigned char c, uint16_t color,
+                      uint16_t bg, uint8_t size_x, uint8_t size_y)
+{
+    beginClip();
+    if (!f)
+    {
+        if (clipRejects(x, y, 6 * size_x, 8 * size_y))
+            return;
+        bool inside = clipContains(x, y, 6 * size_x, 8 * size_y);
+
+        if (c >= 176)
+            c++; // Handle 'classic' charset behavior
+
+        markClipped(x, y, 6 * size_x, 8 * size_y);
+
+        const gfxGlyph *g = cachedGlyph(NULL, &font[c * 5], 5, 8, c, size_x, size_y);
+        if (g)
+        {
+            drawCachedGlyph(g, x, y, color, bg, bg != color ? 6 * size_x : 0, inside);
+            return;
+        }
+
+        // GFX_Select();
+        for (int8_t i = 0; i < 5; i++)
+        { // Char bitmap = 5 columns
+            uint8_t line = font[c * 5 + i];
+            for (int8_t j = 0; j < 8; j++, line >>= 1)
+            {
+                if (line & 1)
+                {
+                    if (inside && size_x == 1 && size_y == 1)
+                        putPixel(x + i, y + j, color);
+                    else if (size_x == 1 && size_y == 1)
+                        writePixel(x + i, y + j, color);
+                    else
+                        writeFillRect(x + i * size_x, y + j * size_y, size_x,
+                                      size_y, color);
+                }
+                else if (bg != color)
+                {
+                    if (inside && size_x == 1 && size_y == 1)
+                        putPixel(x + i, y + j, bg);
+                    else if (size_x == 1 && size_y == 1)
+                        writePixel(x + i, y + j, bg);
+                    else
+                        writeFillRect(x + i * size_x, y + j * size_y, size_x,
+                                      size_y, bg);
+                }
+            }
+        }
+        if (bg != color)
+        { // If opaque, draw vertical line for last column
+            if (size_x == 1 && size_y == 1)
+                writeFastVLine(x + 5, y, 8, bg);
+            else
+                writeFillRect(x + 5 * size_x, y, size_x, 8 * size_y, bg);
+        }
+        // GFX_DeSelect();
     }
     else
     {
-        if (c == '\n')
+        c -= (uint8_t)f->first;
+        GFXglyph *glyph = (f->glyph) + c;
+        uint8_t *bitmap = f->bitmap;
+
+        uint16_t bo = glyph->bitmapOffset;
+        uint8_t w = glyph->width, h = glyph->height;
+        int8_t xo = glyph->xOffset, yo = glyph->yOffset;
+        uint8_t xx, yy, bits = 0, bit = 0;
+        int16_t xo16 = 0, yo16 = 0;
+
+        if (size_x > 1 || size_y > 1)
         {
-            cursor_x = 0;
-            cursor_y += (int16_t)textsize_y * (uint8_t)(gfxFont->yAdvance);
+            xo16 = xo;
+            yo16 = yo;
         }
-        else if (c != '\r')
+
+        if (clipRejects(x + xo * size_x, y + yo * size_y, w * size_x, h * size_y))
+            return;
+        bool inside = clipContains(x + xo * size_x, y + yo * size_y, w * size_x, h * size_y);
+        markClipped(x + xo * size_x, y + yo * size_y, w * size_x, h * size_y);
+
+        const gfxGlyph *g = cachedGlyph(f, bitmap + bo, w, h, c, size_x, size_y);
+        if (g)
         {
-            uint8_t first = gfxFont->first;
-            if ((c >= first) && (c <= (uint8_t)gfxFont->last))
+            drawCachedGlyph(g, x + xo * size_x, y + yo * size_y, color, bg, 0, inside);
+            return;
+        }
+
+        // GFX_Select();
+        for (yy = 0; yy < h; yy++)
+        {
+            for (xx = 0; xx < w; xx++)
             {
-                GFXglyph *glyph = (gfxFont->glyph) + (c - first);
-                uint8_t w = glyph->width, h = glyph->height;
-                if ((w > 0) && (h > 0))
-                {                                        // Is there an associated bitmap?
-                    int16_t xo = (int8_t)glyph->xOffset; // sic
-                    if (wrap && ((cursor_x + textsize_x * (xo + w)) > _width))
+                if (!(bit++ & 7))
+                {
+                    bits = bitmap[bo++];
+                }
+                if (bits & 0x80)
+                {
+                    if (inside && size_x == 1 && size_y == 1)
                     {
-                        cursor_x = 0;
-                        cursor_y += (int16_t)textsize_y * (uint8_t)gfxFont->yAdvance;
+                        putPixel(x + xo + xx, y + yo + yy, color);
+                    }
+                    else if (size_x == 1 && size_y == 1)
+                    {
+                        writePixel(x + xo + xx, y + yo + yy, color);
+                    }
+                    else
+                    {
+                        writeFillRect(x + (xo16 + xx) * size_x,
+                                      y + (yo16 + yy) * size_y, size_x, size_y,
+                                      color);
                     }
-                    GFX_drawChar(cursor_x, cursor_y, c, textcolor,
-                                 textbgcolor, textsize_x, textsize_y);
                 }
-                cursor_x += (uint8_t)glyph->xAdvance * (int16_t)textsize_x;
+                bits <<= 1;
+            }
+        }
+        // GFX_DeSelect();
+    }
+}
+
+void GFX_drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color,
+                  uint16_t bg, uint8_t size_x, uint8_t size_y)
+{
+    toScreen(x, y);
+    if (recording())
+    {
+        int32_t top = y, bottom = y + 8 * size_y - 1;
+        if (gfxFont)
+        {
+            GFXglyph *glyph = gfxFont->glyph + (uint8_t)(c - (uint8_t)gfxFont->first);
+            top = y + glyph->yOffset * size_y;
+            bottom = top + glyph->height * size_y - 1;
+        }
+        gfxCmd *cmd = recordCmd(GFX_OP_CHAR, top, bottom);
+        if (cmd)
+        {
+            cmd->x0 = x;
+            cmd->y0 = y;
+            cmd->c = c;
+            cmd->sx = size_x;
+            cmd->sy = size_y;
+            cmd->color = color;
+            cmd->bg = bg;
+            cmd->data = gfxFont;
+            commitCmd();
+        }
+        return;
+    }
+
+    writeChar(gfxFont, x, y, c, color, bg, size_x, size_y);
+}
+
+// Right edge used for text wrapping, relative to the origin
+static int16_t wrapWidth()
+{
+    int32_t right = gfxClipArea.x1 < _width ? gfxClipArea.x1 + 1 : _width;
+    return right - gfxOriginX;
+}
+
+// Classic font characters on one text line, drawn a pixel row at a time into
+// the RGB565 framebuffer. The column bytes of each glyph are first transposed
+// into row bitmasks; each pixel row of the string, background included, is
+// then written left to right in one pass and copied to the remaining rows of
+// a scaled glyph row. Draws the same pixels as writeChar() for each character.
+static void writeClassicString(int16_t x, int16_t y, const uint8_t *s, uint16_t n, uint16_t color,
+                               uint16_t bg, uint8_t size_x, uint8_t size_y)
+{
+    int32_t cellWidth = 6 * size_x;
+    int32_t x0, y0, x1, y1;
+    beginClip();
+    if (!clipRect(x, y, n * cellWidth, 8 * size_y, x0, y0, x1, y1))
+        return;
+    markClipped(x, y, n * cellWidth, 8 * size_y);
+
+    // Only the characters inside the clip
+    uint16_t k0 = (x0 - x) / cellWidth, k1 = (x1 - 1 - x) / cellWidth + 1;
+    uint8_t rows[GFX_TEXT_RUN][8] = {};
+    for (uint16_t k = k0; k < k1; k++)
+    {
+        unsigned char c = s[k];
+        if (c >= 176)
+            c++; // Handle 'classic' charset behavior
+        for (uint8_t i = 0; i < 5; i++)
+            for (uint8_t j = 0, line = font[c * 5 + i]; j < 8; j++, line >>= 1)
+                rows[k][j] |= (line & 1) << i;
+    }
+
+    bool opaque = bg != color;
+    uint16_t *prev = NULL;
+    for (int32_t py = y0; py < y1; py++)
+    {
+        uint16_t *p = gfxFramebuffer + fbRow(py) * _width;
+        int32_t sub = (py - y) % size_y;
+        if (opaque && sub != 0 && prev != NULL)
+        {
+            memcpy(p + x0, prev + x0, (x1 - x0) * 2); // same glyph row as the pixel row above
+            prev = p;
+            continue;
+        }
+        prev = p;
+        uint8_t j = (py - y) / size_y;
+        for (uint16_t k = k0; k < k1; k++)
+        {
+            uint8_t bits = rows[k][j];
+            int32_t cell = x + k * cellWidth;
+            for (uint8_t i = 0; i < 6; i++, bits >>= 1)
+            {
+                if (!(bits & 1) && !opaque)
+                    continue;
+                uint16_t v = bits & 1 ? color : bg;
+                int32_t a = cell + i * size_x, b = a + size_x;
+                if (a < x0)
+                    a = x0;
+                if (b > x1)
+                    b = x1;
+                for (; a < b; a++)
+                    p[a] = v;
             }
         }
     }
 }
 
-void GFX_setCursor(int16_t x, int16_t y)
+// GFX_write() for a buffer. Runs of classic font characters that fit on the
+// current line are drawn together when they go straight into an RGB565
+// framebuffer.
+static void writeText(const uint8_t *s, size_t n)
+{
+    bool batch = !gfxFont && gfxFramebuffer != NULL && !recording();
+    while (n > 0)
+    {
+        if (!batch || *s == '\n' || *s == '\r')
+        {
+            GFX_write(*s++);
+            n--;
+            continue;
+        }
+
+        int16_t right = wrapWidth(), cellWidth = textsize_x * 6;
+        if (wrap && ((cursor_x + cellWidth) > right))
+        {
+            cursor_x = 0;
+            cursor_y += textsize_y * 8;
+        }
+        uint16_t run = 1;
+        while (run < n && run < GFX_TEXT_RUN && s[run] != '\n' && s[run] != '\r' &&
+               !(wrap && cursor_x + (run + 1) * cellWidth > right))
+            run++;
+
+        int16_t x = cursor_x, y = cursor_y;
+        toScreen(x, y);
+        writeClassicString(x, y, s, run, textcolor, textbgcolor, textsize_x, textsize_y);
+        cursor_x += run * cellWidth;
+        s += run;
+        n -= run;
+    }
+}
+
+void GFX_write(uint8_t c)
+{
+    if (!gfxFont && gfxFramebuffer != NULL && !recording() && c != '\n' && c != '\r')
+    {
+        writeText(&c, 1);
+        return;
+    }
+    if (!gfxFont)
+    {
+        if (c == '\n')
+        {                               // Newline?
+            cursor_x = 0;               // Reset x to zero,
+            cursor_y += textsize_y * 8; // advance y one line
+        }
+        else if (c != '\r')
+        { // Ignore carriage returns
+            if (wrap && ((cursor_x + textsize_x * 6) > wrapWidth()))
+            {                               // Off right?
+                cursor_x = 0;               // Reset x to zero,
+                cursor_y += textsize_y * 8; // advance y one line
+            }
+            GFX_drawChar(cursor_x, cursor_y, c, textcolor, textbgcolor,
+                         textsize_x, textsize_y);
+            cursor_x += textsize_x * 6; // Advance x one char
+        }
+    }
+    else
+    {
+        if (c == '\n')
+        {
+            cursor_x = 0;
+            cursor_y += (int16_t)textsize_y * (uint8_t)(gfxFont->yAdvance);
+        }
+        else if (c != '\r')
+        {
+            uint8_t first = gfxFont->first;
+            if ((c >= first) && (c <= (uint8_t)gfxFont->last))
+            {
+                GFXglyph *glyph = (gfxFont->glyph) + (c - first);
+                uint8_t w = glyph->width, h = glyph->height;
+                if ((w > 0) && (h > 0))
+                {                                        // Is there an associated bitmap?
+                    int16_t xo = (int8_t)glyph->xOffset; // sic
+                    if (wrap && ((cursor_x + textsize_x * (xo + w)) > wrapWidth()))
+                    {
+                        cursor_x = 0;
+                        cursor_y += (int16_t)textsize_y * (uint8_t)gfxFont->yAdvance;
+                    }
+                    GFX_drawChar(cursor_x, cursor_y, c, textcolor,
+                                 textbgcolor, textsize_x, textsize_y);
+                }
+                cursor_x += (uint8_t)glyph->xAdvance * (int16_t)textsize_x;
+            }
+        }
+    }
+}
+
+void GFX_setCursor(int16_t x, int16_t y)
+{
+    cursor_x = x;
+    cursor_y = y;
+}
+
+void GFX_setTextColor(uint16_t color)
+{
+    textcolor = color;
+}
+
+void GFX_setTextBack(uint16_t color)
+{
+    textbgcolor = color;
+}
+
+void GFX_setFont(const GFXfont *f)
+{
+    if (f)
+    { // Font struct pointer passed in?
+        if (!gfxFont)
+        { // And no current font struct?
+            // Switching from classic to new font behavior.
+            // Move cursor pos down 6 pixels so it's on baseline.
+            cursor_y += 6;
+        }
+    }
+    else if (gfxFont)
+    { // NULL passed.  Current font struct defined?
+        // Switching from new to classic font behavior.
+        // Move cursor pos up 6 pixels so it's at top-left of char.
+        cursor_y -= 6;
+    }
+    gfxFont = (GFXfont *)f;
+}
+
+// Horizontal pen advance of c in the current font and size; 0 for characters
+// GFX_write() skips
+static int16_t textAdvance(uint8_t c)
+{
+    if (c == '\r')
+        return 0;
+    if (!gfxFont)
+        return 6 * textsize_x;
+    if (c < (uint8_t)gfxFont->first || c > (uint8_t)gfxFont->last)
+        return 0;
+    return (uint8_t)gfxFont->glyph[c - (uint8_t)gfxFont->first].xAdvance * textsize_x;
+}
+
+// Whether drawing c puts anything on screen (classic font cells have a background)
+static bool textDraws(uint8_t c)
+{
+    if (c == '\r')
+        return false;
+    if (!gfxFont)
+        return true;
+    if (c < (uint8_t)gfxFont->first || c > (uint8_t)gfxFont->last)
+        return false;
+    const GFXglyph *glyph = gfxFont->glyph + (c - (uint8_t)gfxFont->first);
+    return glyph->width > 0 && glyph->height > 0;
+}
+
+void GFX_getTextBounds(const char *str, int16_t x, int16_t y, int16_t *x1, int16_t *y1, uint16_t *w,
+                       uint16_t *h)
+{
+    // Walks the text the way GFX_write() moves the cursor, wrapping included
+    int32_t minx = INT16_MAX, miny = INT16_MAX, maxx = INT16_MIN, maxy = INT16_MIN;
+    int16_t right = wrapWidth();
+    int16_t lineHeight = gfxFont ? (uint8_t)gfxFont->yAdvance * textsize_y : 8 * textsize_y;
+    for (const uint8_t *s = reinterpret_cast<const uint8_t *>(str); *s; s++)
+    {
+        uint8_t c = *s;
+        if (c == '\n')
+        {
+            x = 0;
+            y += lineHeight;
+            continue;
+        }
+        if (!textDraws(c))
+        {
+            x += textAdvance(c);
+            continue;
+        }
+        int32_t gx, gy, gw, gh;
+        if (!gfxFont)
+        {
+            if (wrap && x + 6 * textsize_x > right)
+            {
+                x = 0;
+                y += lineHeight;
+            }
+            gx = x;
+            gy = y;
+            gw = 6 * textsize_x;
+            gh = 8 * textsize_y;
+        }
+        else
+        {
+            const GFXglyph *glyph = gfxFont->glyph + (c - (uint8_t)gfxFont->first);
+            if (wrap && x + textsize_x * (glyph->xOffset + glyph->width) > right)
+            {
+                x = 0;
+                y += lineHeight;
+            }
+            gx = x + glyph->xOffset * textsize_x;
+            gy = y + glyph->yOffset * textsize_y;
+            gw = glyph->width * textsize_x;
+            gh = glyph->height * textsize_y;
+        }
+        minx = gx < minx ? gx : minx;
+        miny = gy < miny ? gy : miny;
+        maxx = gx + gw > maxx ? gx + gw : maxx;
+        maxy = gy + gh > maxy ? gy + gh : maxy;
+        x += textAdvance(c);
+    }
+
+    if (maxx < minx)
+    {
+        *x1 = x;
+        *y1 = y;
+        *w = *h = 0;
+        return;
+    }
+    *x1 = minx;
+    *y1 = miny;
+    *w = maxx - minx;
+    *h = maxy - miny;
+}
+
+// Find the line of s that starts at pos: sets its end (exclusive) and width
+// and returns where the next line starts. With wordWrap the line breaks at
+// the last space that keeps it within maxWidth, or mid-word if there is none.
+static size_t breakLine(const uint8_t *s, size_t n, size_t pos, int32_t maxWidth, bool wordWrap,
+                        size_t &end, int32_t &width)
+{
+    int32_t w = 0, spaceWidth = 0;
+    size_t space = pos;
+    for (size_t i = pos; i < n; i++)
+    {
+        if (s[i] == '\n')
+        {
+            end = i;
+            width = w;
+            return i + 1;
+        }
+        int16_t a = textAdvance(s[i]);
+        if (wordWrap && w + a > maxWidth && i > pos)
+        {
+            size_t next = i;
+            if (s[i] != ' ' && space > pos)
+            {
+                next = space;
+                w = spaceWidth;
+            }
+            end = next;
+            while (end > pos && s[end - 1] == ' ')
+                w -= textAdvance(s[--end]);
+            while (next < n && s[next] == ' ')
+                next++;
+            width = w;
+            return next;
+        }
+        if (s[i] == ' ')
+        {
+            space = i;
+            spaceWidth = w;
+        }
+        w += a;
+    }
+    end = n;
+    width = w;
+    return n;
+}
+
+// Where layoutText() puts glyphs: a cache slot, or a buffer that is drawn at
+// (x, y) and emptied whenever it fills
+typedef struct
+{
+    gfxPlacedGlyph *glyphs;
+    uint16_t count, max;
+    bool draw, overflow;
+    int16_t x, y;
+} gfxLayoutOut;
+
+static void drawPlaced(const gfxPlacedGlyph *g, uint16_t n, int16_t x, int16_t y);
+
+static void placeGlyph(gfxLayoutOut &out, int32_t x, int32_t y, uint8_t c)
+{
+    if (out.count == out.max)
+    {
+        if (!out.draw)
+        {
+            out.overflow = true;
+            return;
+        }
+        drawPlaced(out.glyphs, out.count, out.x, out.y);
+        out.count = 0;
+    }
+    gfxPlacedGlyph &g = out.glyphs[out.count++];
+    g.x = x;
+    g.y = y;
+    g.c = c;
+}
+
+// Lay out n characters of s in a w by h box with the current font and text
+// size. Lines that do not fit in the box height are dropped; with
+// GFX_TEXT_ELLIPSIS the last line shown, and any line too wide, ends in
+// "...". Returns false if out ran out of room.
+static bool layoutText(const uint8_t *s, size_t n, int16_t w, int16_t h, uint8_t flags, gfxLayoutOut &out)
+{
+    bool wordWrap = flags & GFX_TEXT_WRAP;
+    int32_t lineHeight = gfxFont ? (uint8_t)gfxFont->yAdvance * textsize_y : 8 * textsize_y;
+    int32_t ascent = 0; // cursor row below the top of a line: the baseline for GFXfont
+    if (gfxFont)
+    {
+        for (uint16_t i = 0; i <= (uint8_t)gfxFont->last - (uint8_t)gfxFont->first; i++)
+            if (-gfxFont->glyph[i].yOffset > ascent)
+                ascent = -gfxFont->glyph[i].yOffset;
+        ascent *= textsize_y;
+    }
+    if (lineHeight == 0)
+        return true;
+
+    // Count the lines first, for vertical alignment
+    int32_t maxLines = h / lineHeight > 0 ? h / lineHeight : 1, lines = 0;
+    size_t end;
+    int32_t width;
+    for (size_t pos = 0; pos < n && lines <= maxLines; lines++)
+        pos = breakLine(s, n, pos, w, wordWrap, end, width);
+    bool more = lines > maxLines;
+    if (more)
+        lines = maxLines;
+
+    int32_t top = 0;
+    if (flags & GFX_ALIGN_MIDDLE)
+        top = (h - lines * lineHeight) / 2;
+    else if (flags & GFX_ALIGN_BOTTOM)
+        top = h - lines * lineHeight;
+
+    int16_t dotWidth = textAdvance('.');
+    size_t pos = 0;
+    for (int32_t line = 0; line < lines; line++)
+    {
+        size_t next = breakLine(s, n, pos, w, wordWrap, end, width);
+        bool dots = (flags & GFX_TEXT_ELLIPSIS) && ((more && line == lines - 1) || width > w);
+        if (dots)
+        {
+            // Keep what fits in front of the dots
+            width = 0;
+            size_t fit = pos;
+            while (fit < end && width + textAdvance(s[fit]) + 3 * dotWidth <= w)
+                width += textAdvance(s[fit++]);
+            while (fit > pos && s[fit - 1] == ' ')
+                width -= textAdvance(s[--fit]);
+            end = fit;
+            width += 3 * dotWidth;
+        }
+
+        int32_t x = 0, y = top + line * lineHeight + ascent;
+        if (flags & GFX_ALIGN_CENTER)
+            x = (w - width) / 2;
+        else if (flags & GFX_ALIGN_RIGHT)
+            x = w - width;
+        for (size_t i = pos; i < end; i++)
+        {
+            if (textDraws(s[i]))
+                placeGlyph(out, x, y, s[i]);
+            x += textAdvance(s[i]);
+        }
+        for (uint8_t i = 0; dots && i < 3; i++, x += dotWidth)
+            if (textDraws('.'))
+                placeGlyph(out, x, y, '.');
+        pos = next;
+    }
+    return !out.overflow;
+}
+
+// Draw placed glyphs relative to (x, y) in the current text colors. Classic
+// font glyphs that sit side by side go through the string renderer.
+static void drawPlaced(const gfxPlacedGlyph *g, uint16_t n, int16_t x, int16_t y)
+{
+    bool batch = !gfxFont && gfxFramebuffer != NULL && !recording();
+    int16_t cellWidth = 6 * textsize_x;
+    while (n > 0)
+    {
+        if (!batch)
+        {
+            GFX_drawChar(x + g->x, y + g->y, g->c, textcolor, textbgcolor, textsize_x, textsize_y);
+            g++;
+            n--;
+            continue;
+        }
+
+        uint8_t run[GFX_TEXT_RUN];
+        uint16_t k = 0;
+        do
+            run[k] = g[k].c;
+        while (++k < n && k < GFX_TEXT_RUN && g[k].y == g->y && g[k].x == g->x + k * cellWidth);
+        int16_t gx = x + g->x, gy = y + g->y;
+        toScreen(gx, gy);
+        writeClassicString(gx, gy, run, k, textcolor, textbgcolor, textsize_x, textsize_y);
+        g += k;
+        n -= k;
+    }
+}
+
+// Find a layout in the cache, or lay the text out into the least recently
+// used slot. Returns NULL if the cache is off or the layout does not fit.
+static const gfxLayout *cachedLayout(const uint8_t *s, size_t n, int16_t w, int16_t h, uint8_t flags)
+{
+    if (gfxLayouts == NULL || n > GFX_LAYOUT_CHARS)
+        return NULL;
+    gfxLayout *victim = gfxLayouts;
+    for (gfxLayout *l = gfxLayouts; l < gfxLayouts + gfxLayoutCount; l++)
+    {
+        if (l->sx == textsize_x && l->len == n && l->w == w && l->h == h && l->flags == flags &&
+            l->sy == textsize_y && l->font == gfxFont && memcmp(l->text, s, n) == 0)
+        {
+            l->lastUse = ++gfxLayoutTick;
+            return l;
+        }
+        if (victim->sx != 0 && (l->sx == 0 || l->lastUse < victim->lastUse))
+            victim = l;
+    }
+
+    // Ellipses can place more glyphs than the text has; such a layout is not
+    // kept and leaves the victim slot empty
+    gfxLayoutOut out = {victim->glyphs, 0, GFX_LAYOUT_CHARS, false, false, 0, 0};
+    victim->sx = 0;
+    if (!layoutText(s, n, w, h, flags, out))
+        return NULL;
+    gfxLayout *l = victim;
+    memcpy(l->text, s, n);
+    l->font = gfxFont;
+    l->w = w;
+    l->h = h;
+    l->sx = textsize_x;
+    l->sy = textsize_y;
+    l->flags = flags;
+    l->len = n;
+    l->count = out.count;
+    l->lastUse = ++gfxLayoutTick;
+    return l;
+}
+
+void GFX_drawTextBox(int16_t x, int16_t y, int16_t w, int16_t h, const char *str, uint8_t flags)
+{
+    const uint8_t *s = reinterpret_cast<const uint8_t *>(str);
+    size_t n = strlen(str);
+    if (!GFX_pushClip(x, y, w, h))
+        return; // clips nested too deeply; unclipped text could spill anywhere
+    const gfxLayout *l = cachedLayout(s, n, w, h, flags);
+    if (l)
+        drawPlaced(l->glyphs, l->count, x, y);
+    else
+    {
+        gfxPlacedGlyph glyphs[GFX_TEXT_RUN];
+        gfxLayoutOut out = {glyphs, 0, GFX_TEXT_RUN, true, false, x, y};
+        layoutText(s, n, w, h, flags, out);
+        drawPlaced(glyphs, out.count, x, y);
+    }
+    GFX_popClip();
+}
+
+void fillCircleHelper(int16_t x0, int16_t y0, int16_t r,
+                      uint8_t corners, int16_t delta,
+                      uint16_t color)
+{
+
+    int16_t f = 1 - r;
+    int16_t ddF_x = 1;
+    int16_t ddF_y = -2 * r;
+    int16_t x = 0;
+    int16_t y = r;
+    int16_t px = x;
+    int16_t py = y;
+
+    delta++; // Avoid some +1's in the loop
+
+    while (x < y)
+    {
+        if (f >= 0)
+        {
+            y--;
+            ddF_y += 2;
+            f += ddF_y;
+        }
+        x++;
+        ddF_x += 2;
+        f += ddF_x;
+        // These checks avoid double-drawing certain lines, important
+        // for the SSD1306 library which has an INVERT drawing mode.
+        if (x < (y + 1))
+        {
+            if (corners & 1)
+                writeFastVLine(x0 + x, y0 - y, 2 * y + delta, color);
+            if (corners & 2)
+                writeFastVLine(x0 - x, y0 - y, 2 * y + delta, color);
+        }
+        if (y != py)
+        {
+            if (corners & 1)
+                writeFastVLine(x0 + py, y0 - px, 2 * px + delta, color);
+            if (corners & 2)
+                writeFastVLine(x0 - py, y0 - px, 2 * px + delta, color);
+            py = y;
+        }
+        px = x;
+    }
+}
+
+void GFX_fillCircle(int16_t x0, int16_t y0, int16_t r,
+                    uint16_t color)
+{
+    toScreen(x0, y0);
+    if (recording())
+    {
+        gfxCmd *c = recordCmd(GFX_OP_FILLCIRCLE, y0 - r, y0 + r);
+        if (c)
+        {
+            c->x0 = x0;
+            c->y0 = y0;
+            c->x1 = r;
+            c->color = color;
+            commitCmd();
+        }
+        return;
+    }
+
+    beginClip();
+    if (clipRejects(x0 - r, y0 - r, 2 * r + 1, 2 * r + 1))
+        return;
+    writeFastVLine(x0, y0 - r, 2 * r + 1, color);
+    fillCircleHelper(x0, y0, r, 3, 0, color);
+    markClipped(x0 - r, y0 - r, 2 * r + 1, 2 * r + 1);
+}
+
+void GFX_drawCircle(int16_t x0, int16_t y0, int16_t r,
+                    uint16_t color)
+{
+    toScreen(x0, y0);
+    if (recording())
+    {
+        gfxCmd *c = recordCmd(GFX_OP_CIRCLE, y0 - r, y0 + r);
+        if (c)
+        {
+            c->x0 = x0;
+            c->y0 = y0;
+            c->x1 = r;
+            c->color = color;
+            commitCmd();
+        }
+        return;
+    }
+
+    int16_t f = 1 - r;
+    int16_t ddF_x = 1;
+    int16_t ddF_y = -2 * r;
+    int16_t x = 0;
+    int16_t y = r;
+
+    beginClip();
+    if (clipRejects(x0 - r, y0 - r, 2 * r + 1, 2 * r + 1))
+        return;
+    markClipped(x0 - r, y0 - r, 2 * r + 1, 2 * r + 1);
+
+    writePixel(x0, y0 + r, color);
+    writePixel(x0, y0 - r, color);
+    writePixel(x0 + r, y0, color);
+    writePixel(x0 - r, y0, color);
+
+    while (x < y)
+    {
+        if (f >= 0)
+        {
+            y--;
+            ddF_y += 2;
+            f += ddF_y;
+        }
+        x++;
+        ddF_x += 2;
+        f += ddF_x;
+
+        writePixel(x0 + x, y0 + y, color);
+        writePixel(x0 - x, y0 + y, color);
+        writePixel(x0 + x, y0 - y, color);
+        writePixel(x0 - x, y0 - y, color);
+        writePixel(x0 + y, y0 + x, color);
+        writePixel(x0 - y, y0 + x, color);
+        writePixel(x0 + y, y0 - x, color);
+        writePixel(x0 - y, y0 - x, color);
+    }
+}
+
+// Blend a pixel with 0..255 coverage if it is inside the clip. Without an
+// RGB565 framebuffer mostly covered pixels are drawn solid.
+static inline void blendClipped(int32_t x, int32_t y, uint16_t color, uint8_t alpha)
+{
+    if ((x < gfxClip.x0) || (y < gfxClip.y0) || (x > gfxClip.x1) || (y > gfxClip.y1))
+        return;
+    uint32_t a = blendScale(alpha);
+    if (gfxFramebuffer == NULL)
+    {
+        if (a > 16)
+            putPixel(x, y, color);
+        return;
+    }
+    uint16_t *p = gfxFramebuffer + x + fbRow(y) * _width;
+    if (a == 32)
+        *p = color;
+    else if (a > 0)
+        *p = blendPixel(*p, color, a);
+}
+
+// Xiaolin Wu's line. Each step along the major axis splits the pixel between
+// the two rows (or columns) straddling the ideal line. A 16-bit accumulator
+// holds the fractional minor position: it steps the minor axis when it wraps
+// and its top byte is the coverage of the far pixel.
+static void writeLineAA(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color)
+{
+    // Horizontal, vertical and diagonal lines cover whole pixels
+    if (x0 == x1 || y0 == y1 || abs(x1 - x0) == abs(y1 - y0))
+    {
+        writeLine(x0, y0, x1, y1, color);
+        return;
+    }
+
+    bool steep = abs(y1 - y0) > abs(x1 - x0);
+    if (steep)
+    {
+        swap(x0, y0);
+        swap(x1, y1);
+    }
+    if (x0 > x1)
+    {
+        swap(x0, x1);
+        swap(y0, y1);
+    }
+    int32_t dx = x1 - x0, dy = abs(y1 - y0);
+    int32_t ystep = y0 < y1 ? 1 : -1;
+    uint16_t adj = ((uint32_t)dy << 16) / dx; // dy < dx, so below 1.0
+    uint16_t acc = 0;
+
+    if (steep)
+    {
+        blendClipped(y0, x0, color, 255);
+        blendClipped(y1, x1, color, 255);
+    }
+    else
+    {
+        blendClipped(x0, y0, color, 255);
+        blendClipped(x1, y1, color, 255);
+    }
+    int32_t y = y0;
+    for (int32_t x = x0 + 1; x < x1; x++)
+    {
+        uint16_t prev = acc;
+        acc += adj;
+        if (acc <= prev)
+            y += ystep;
+        uint8_t far = acc >> 8;
+        if (steep)
+        {
+            blendClipped(y, x, color, 255 - far);
+            blendClipped(y + ystep, x, color, far);
+        }
+        else
+        {
+            blendClipped(x, y, color, 255 - far);
+            blendClipped(x, y + ystep, color, far);
+        }
+    }
+}
+
+// Blend the points mirrored from (x, y) in all octants, each only once
+static void blendOctants(int16_t cx, int16_t cy, int32_t x, int32_t y, uint16_t color, uint8_t alpha)
+{
+    for (int pass = 0; pass < 2; pass++)
+    {
+        blendClipped(cx + x, cy + y, color, alpha);
+        if (x)
+            blendClipped(cx - x, cy + y, color, alpha);
+        if (y)
+            blendClipped(cx + x, cy - y, color, alpha);
+        if (x && y)
+            blendClipped(cx - x, cy - y, color, alpha);
+        if (x == y)
+            return;
+        swap(x, y);
+    }
+}
+
+// Wu-style circle: for each column of the first octant the ideal edge lies
+// at sqrt(r^2 - x^2), between rows y and y + 1. Its position within that gap
+// is interpolated from r^2 - x^2 between y^2 and (y + 1)^2, in integers.
+static void writeCircleAA(int16_t cx, int16_t cy, int16_t r, uint16_t color)
+{
+    int32_t rr = (int32_t)r * r;
+    int32_t y = r;
+    for (int32_t x = 0; x <= y; x++)
+    {
+        int32_t d = rr - x * x;
+        while (y * y > d)
+            y--;
+        if (x > y) // past the diagonal, which the mirrored octant covers
+            break;
+        uint8_t far = ((d - y * y) << 8) / (2 * y + 1); // d - y^2 is at most 2y
+        blendOctants(cx, cy, x, y, color, 255 - far);
+        if (far)
+            blendOctants(cx, cy, x, y + 1, color, far);
+    }
+}
+
+void GFX_drawLineAA(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color)
+{
+    toScreen(x0, y0);
+    toScreen(x1, y1);
+    if (recording())
+    {
+        gfxCmd *c = recordCmd(GFX_OP_LINEAA, y0, y1);
+        if (c)
+        {
+            c->x0 = x0;
+            c->y0 = y0;
+            c->x1 = x1;
+            c->y1 = y1;
+            c->color = color;
+            commitCmd();
+        }
+        return;
+    }
+    int16_t left = x0 < x1 ? x0 : x1, top = y0 < y1 ? y0 : y1;
+    int16_t w = abs(x1 - x0) + 1, h = abs(y1 - y0) + 1;
+    beginClip();
+    if (clipRejects(left, top, w, h))
+        return;
+    writeLineAA(x0, y0, x1, y1, color);
+    markClipped(left, top, w, h);
+}
+
+void GFX_drawCircleAA(int16_t x0, int16_t y0, int16_t r, uint16_t color)
+{
+    toScreen(x0, y0);
+    // The outer pixels reach one past the radius
+    if (recording())
+    {
+        gfxCmd *c = recordCmd(GFX_OP_CIRCLEAA, y0 - r - 1, y0 + r + 1);
+        if (c)
+        {
+            c->x0 = x0;
+            c->y0 = y0;
+            c->x1 = r;
+            c->color = color;
+            commitCmd();
+        }
+        return;
+    }
+    beginClip();
+    if (r < 0 || clipRejects(x0 - r - 1, y0 - r - 1, 2 * r + 3, 2 * r + 3))
+        return;
+    writeCircleAA(x0, y0, r, color);
+    markClipped(x0 - r - 1, y0 - r - 1, 2 * r + 3, 2 * r + 3);
+}
+
+void printString(char s[])
+{
+    writeText(reinterpret_cast<const uint8_t *>(s), strlen(s));
+}
+
+// Formatter output: characters are collected into a run and handed to
+// writeText() whenever the run is full, so output length is unbounded and
+// no heap or format buffer is involved. Without draw, they fill the run and
+// the rest is dropped.
+typedef struct
+{
+    uint8_t *run;
+    uint16_t len, max;
+    bool draw;
+} gfxTextOut;
+
+static inline void putText(gfxTextOut &out, char c)
+{
+    if (out.len == out.max)
+        return;
+    out.run[out.len++] = c;
+    if (out.len == out.max && out.draw)
+    {
+        writeText(out.run, out.len);
+        out.len = 0;
+    }
+}
+
+static void putRepeated(gfxTextOut &out, char c, int32_t n)
+{
+    for (; n > 0; n--)
+        putText(out, c);
+}
+
+// Digits of v in base, least significant first; returns their count
+static uint8_t formatDigits(char *digits, uint64_t v, uint8_t base, bool upper)
+{
+    const char *set = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    uint8_t n = 0;
+    // 32-bit division is done in hardware; 64-bit only while the value needs it
+    for (; v > 0xFFFFFFFFu; v /= base)
+        digits[n++] = set[v % base];
+    for (uint32_t w = v; w != 0 || n == 0; w /= base)
+        digits[n++] = set[w % base];
+    return n;
+}
+
+// Write a formatted number: sign or prefix, zero or space padding to width,
+// then body (digits reversed, with an optional fraction after them)
+static void putNumber(gfxTextOut &out, const char *prefix, const char *digits, uint8_t n,
+                      int32_t minDigits, const char *fraction, uint8_t fracLen,
+                      int32_t width, bool left, bool zero)
+{
+    int32_t prefixLen = strlen(prefix);
+    int32_t body = (n > minDigits ? n : minDigits) + (fracLen ? fracLen + 1 : 0);
+    int32_t pad = width - prefixLen - body;
+    if (!left && !zero)
+        putRepeated(out, ' ', pad);
+    while (*prefix)
+        putText(out, *prefix++);
+    if (!left && zero)
+        putRepeated(out, '0', pad);
+    putRepeated(out, '0', minDigits - n);
+    while (n > 0)
+        putText(out, digits[--n]);
+    if (fracLen)
+    {
+        putText(out, '.');
+        for (uint8_t i = 0; i < fracLen; i++)
+            putText(out, fraction[i]);
+    }
+    if (left)
+        putRepeated(out, ' ', pad);
+}
+
+// Length class matching an integer type, as used by formatText(): 0 is read
+// as int, 1 as long, 2 as long long. size_t and ptrdiff_t are 32-bit on the
+// RP2040 and 64-bit on most hosts.
+#define FORMAT_SIZE(type) (sizeof(type) > sizeof(long) ? 2 : sizeof(type) > sizeof(int) ? 1 : 0)
+#define FORMAT_SIZE_READ(type) \
+    (FORMAT_SIZE(type) == 2 ? sizeof(long long) : FORMAT_SIZE(type) ? sizeof(long) : sizeof(int))
+static_assert(FORMAT_SIZE_READ(size_t) == sizeof(size_t) && FORMAT_SIZE_READ(ptrdiff_t) == sizeof(ptrdiff_t) &&
+                  FORMAT_SIZE_READ(intmax_t) == sizeof(intmax_t),
+              "z, t and j arguments must be read as int, long or long long of the same size");
+
+// printf-style formatting into out, with no intermediate buffer. Supports the
+// flags - + space 0 #, width and precision (also as *), the hh h l ll z j t L
+// length modifiers and d i u o x X c s p f F %. Floating point is split
+// into integer and fraction in 64-bit integers, at most 9 decimals. e E g G
+// a A and n are printed as written, after taking their argument.
+static void formatText(gfxTextOut &out, const char *format, va_list args)
+{
+    for (const char *f = format; *f; f++)
+    {
+        if (*f != '%')
+        {
+            putText(out, *f);
+            continue;
+        }
+
+        bool left = false, plus = false, space = false, zero = false, alt = false;
+        for (;; f++)
+        {
+            if (f[1] == '-')
+                left = true;
+            else if (f[1] == '+')
+                plus = true;
+            else if (f[1] == ' ')
+                space = true;
+            else if (f[1] == '0')
+                zero = true;
+            else if (f[1] == '#')
+                alt = true;
+            else
+                break;
+        }
+        int32_t width = 0, precision = -1;
+        if (f[1] == '*')
+        {
+            width = va_arg(args, int);
+            if (width < 0)
+            {
+                left = true;
+                width = -width;
+            }
+            f++;
+        }
+        for (; f[1] >= '0' && f[1] <= '9'; f++)
+            width = width * 10 + f[1] - '0';
+        if (f[1] == '.')
+        {
+            f++;
+            precision = 0;
+            if (f[1] == '*')
+            {
+                precision = va_arg(args, int);
+                f++;
+            }
+            for (; f[1] >= '0' && f[1] <= '9'; f++)
+                precision = precision * 10 + f[1] - '0';
+        }
+        uint8_t size = 0, half = 0; // size 0 int, 1 long, 2 long long; half 1 short, 2 char
+        bool longDouble = false;
+        for (;; f++)
+        {
+            if (f[1] == 'l')
+                size++;
+            else if (f[1] == 'L')
+                longDouble = true;
+            else if (f[1] == 'z')
+                size = FORMAT_SIZE(size_t);
+            else if (f[1] == 't')
+                size = FORMAT_SIZE(ptrdiff_t);
+            else if (f[1] == 'j')
+                size = FORMAT_SIZE(intmax_t);
+            else if (f[1] == 'h')
+                half++;
+            else
+                break;
+        }
+        char conv = *++f;
+        if (conv == '\0')
+            break;
+
+        char digits[24];
+        const char *prefix = "";
+        switch (conv)
+        {
+        case 'd':
+        case 'i':
+        {
+            int64_t v = size >= 2 ? va_arg(args, long long) : size ? va_arg(args, long) : va_arg(args, int);
+            if (half)
+                v = half > 1 ? (int64_t)(signed char)v : (int64_t)(short)v;
+            uint64_t mag = v < 0 ? 0 - (uint64_t)v : v;
+            prefix = v < 0 ? "-" : plus ? "+" : space ? " " : "";
+            uint8_t n = precision == 0 && mag == 0 ? 0 : formatDigits(digits, mag, 10, false);
+            putNumber(out, prefix, digits, n, precision, NULL, 0, width, left, zero && precision < 0);
+            break;
+        }
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+        case 'p':
+        {
+            uint64_t v = conv == 'p' ? (uintptr_t)va_arg(args, void *)
+                         : size >= 2 ? va_arg(args, unsigned long long)
+                         : size      ? va_arg(args, unsigned long)
+                                     : va_arg(args, unsigned int);
+            if (half && conv != 'p')
+                v = half > 1 ? (uint8_t)v : (uint16_t)v;
+            uint8_t base = conv == 'u' ? 10 : conv == 'o' ? 8 : 16;
+            if (conv == 'p' || (alt && v != 0 && base == 16))
+                prefix = conv == 'X' ? "0X" : "0x";
+            else if (alt && base == 8)
+                prefix = "0";
+            uint8_t n = precision == 0 && v == 0 ? 0 : formatDigits(digits, v, base, conv == 'X');
+            putNumber(out, prefix, digits, n, precision, NULL, 0, width, left, zero && precision < 0);
+            break;
+        }
+        case 'f':
+        case 'F':
+        {
+            double v = longDouble ? (double)va_arg(args, long double) : va_arg(args, double);
+            bool negative = v < 0;
+            if (negative)
+                v = -v;
+            prefix = negative ? "-" : plus ? "+" : space ? " " : "";
+            if (v - v != 0 || v >= 1.8e19) // NaN, infinity, or too big for 64 bits
+            {
+                const char *text = v != v ? "nan" : v - v != 0 ? "inf" : "ovf";
+                putNumber(out, prefix, "", 0, 0, NULL, 0, width - 3, left, false);
+                while (*text)
+                    putText(out, *text++);
+                break;
+            }
+            uint8_t decimals = precision < 0 ? 6 : precision > 9 ? 9 : precision;
+            uint32_t scale = 1;
+            for (uint8_t i = 0; i < decimals; i++)
+                scale *= 10;
+            uint64_t whole = (uint64_t)v;
+            double scaled = (v - (double)whole) * scale;
+            uint32_t frac = (uint32_t)scaled;
+            double rest = scaled - frac;
+            if (rest > 0.5 || (rest == 0.5 && (decimals ? frac : whole) & 1)) // ties to even, as printf
+                frac++;
+            if (frac >= scale)
+            {
+                whole++;
+                frac -= scale;
+            }
+            char fraction[9];
+            for (int8_t i = decimals - 1; i >= 0; i--, frac /= 10)
+                fraction[i] = '0' + frac % 10;
+            uint8_t n = formatDigits(digits, whole, 10, false);
+            if (decimals == 0 && alt)
+            {
+                putNumber(out, prefix, digits, n, 0, "", 0, width - 1, left, zero);
+                putText(out, '.');
+                break;
+            }
+            putNumber(out, prefix, digits, n, 0, fraction, decimals, width, left, zero);
+            break;
+        }
+        case 'c':
+            digits[0] = (char)va_arg(args, int);
+            putNumber(out, "", digits, 1, 0, NULL, 0, width, left, false);
+            break;
+        case 's':
+        {
+            const char *str = va_arg(args, const char *);
+            if (str == NULL)
+                str = "(null)";
+            int32_t len = 0;
+            while (str[len] && (precision < 0 || len < precision))
+                len++;
+            if (!left)
+                putRepeated(out, ' ', width - len);
+            for (int32_t i = 0; i < len; i++)
+                putText(out, str[i]);
+            if (left)
+                putRepeated(out, ' ', width - len);
+            break;
+        }
+        case '%':
+            putText(out, '%');
+            break;
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            // Not supported, but the argument is taken so later ones stay in step
+            if (longDouble)
+                va_arg(args, long double);
+            else
+                va_arg(args, double);
+            putText(out, '%');
+            putText(out, conv);
+            break;
+        case 'n':
+            va_arg(args, void *);
+            putText(out, '%');
+            putText(out, conv);
+            break;
+        default: // unknown conversion: print it as written
+            putText(out, '%');
+            putText(out, conv);
+            break;
+        }
+    }
+}
+
+// Format straight into the text renderer at the cursor
+static void printText(const char *format, va_list args)
+{
+    uint8_t run[GFX_TEXT_RUN];
+    gfxTextOut out = {run, 0, GFX_TEXT_RUN, true};
+    formatText(out, format, args);
+    writeText(out.run, out.len);
+}
+
+void GFX_printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    printText(format, args);
+    va_end(args);
+}
+
+void GFX_printfAt(int16_t x, int16_t y, const char *format, ...)
+{
+    GFX_setCursor(x, y);
+    va_list args;
+    va_start(args, format);
+    printText(format, args);
+    va_end(args);
+}
+
+void GFX_initLabel(GFX_Label *label, int16_t x, int16_t y)
+{
+    label->x = x;
+    label->y = y;
+    label->font = gfxFont;
+    label->sx = textsize_x;
+    label->sy = textsize_y;
+    label->color = textcolor;
+    label->opaque = textbgcolor != textcolor;
+    label->bg = label->opaque ? textbgcolor : clearColour;
+    label->len = 0;
+}
+
+// Box a label glyph covers, relative to the label position; false if it draws nothing
+static bool labelBox(const GFX_Label *label, uint8_t c, int16_t pos, gfxRect &r)
+{
+    if (!label->font)
+    {
+        r.x0 = pos;
+        r.y0 = 0;
+        r.x1 = pos + 6 * label->sx - 1;
+        r.y1 = 8 * label->sy - 1;
+        return true;
+    }
+    if (c < (uint8_t)label->font->first || c > (uint8_t)label->font->last)
+        return false;
+    const GFXglyph *glyph = label->font->glyph + (c - (uint8_t)label->font->first);
+    if (glyph->width == 0 || glyph->height == 0)
+        return false;
+    r.x0 = pos + glyph->xOffset * label->sx;
+    r.y0 = glyph->yOffset * label->sy;
+    r.x1 = r.x0 + glyph->width * label->sx - 1;
+    r.y1 = r.y0 + glyph->height * label->sy - 1;
+    return true;
+}
+
+static bool rectsOverlap(const gfxRect &a, const gfxRect &b)
+{
+    return a.x0 <= b.x1 && b.x0 <= a.x1 && a.y0 <= b.y1 && b.y0 <= a.y1;
+}
+
+// Draw the label's new text against what it drew last. A glyph is unchanged
+// if the same character sits at the same pen position. Old glyphs that
+// changed are erased to the background, except opaque classic cells that the
+// new glyph covers anyway; new glyphs that changed, or that overlap an erased
+// box, are drawn. Every call marks only the area it touches as damaged.
+static void updateLabel(GFX_Label *label, const uint8_t *s, uint8_t n)
+{
+    GFXfont *font = gfxFont;
+    gfxFont = (GFXfont *)label->font;
+    bool covers = !label->font && label->opaque; // a new cell hides the old one
+    // Band strips and the back buffer of a double framebuffer do not hold
+    // the text last drawn, so there every glyph is drawn again
+    bool redrawAll = gfxCmds != NULL || gfxFramebufs[1] != NULL;
+
+    int16_t pos[GFX_LABEL_CHARS];
+    int32_t pen = 0;
+    for (uint8_t i = 0; i < n; i++)
+    {
+        pos[i] = pen;
+        if (label->font)
+        {
+            const GFXfont *f = label->font;
+            if (s[i] >= (uint8_t)f->first && s[i] <= (uint8_t)f->last)
+                pen += (uint8_t)f->glyph[s[i] - (uint8_t)f->first].xAdvance * label->sx;
+        }
+        else
+            pen += 6 * label->sx;
+    }
+
+    gfxRect erased[GFX_LABEL_CHARS];
+    uint8_t erasedCount = 0;
+    gfxRect r;
+    for (uint8_t i = 0; i < label->len; i++)
+    {
+        if (!redrawAll && i < n && s[i] == label->text[i] && pos[i] == label->pos[i])
+            continue;
+        if ((covers && i < n) || !labelBox(label, label->text[i], label->pos[i], r))
+            continue;
+        GFX_fillRect(label->x + r.x0, label->y + r.y0, r.x1 - r.x0 + 1, r.y1 - r.y0 + 1, label->bg);
+        erased[erasedCount++] = r;
+    }
+
+    for (uint8_t i = 0; i < n; i++)
+    {
+        if (!labelBox(label, s[i], pos[i], r))
+            continue;
+        bool changed = redrawAll || i >= label->len || s[i] != label->text[i] || pos[i] != label->pos[i];
+        for (uint8_t k = 0; k < erasedCount && !changed; k++)
+            changed = rectsOverlap(r, erased[k]);
+        if (changed)
+            GFX_drawChar(label->x + pos[i], label->y, s[i], label->color,
+                         label->opaque ? label->bg : label->color, label->sx, label->sy);
+    }
+
+    memcpy(label->text, s, n);
+    memcpy(label->pos, pos, n * sizeof(pos[0]));
+    label->len = n;
+    gfxFont = font;
+}
+
+void GFX_setLabel(GFX_Label *label, const char *text)
+{
+    size_t n = strlen(text);
+    updateLabel(label, reinterpret_cast<const uint8_t *>(text), n < GFX_LABEL_CHARS ? n : GFX_LABEL_CHARS);
+}
+
+void GFX_printLabel(GFX_Label *label, const char *format, ...)
+{
+    uint8_t text[GFX_LABEL_CHARS];
+    gfxTextOut out = {text, 0, GFX_LABEL_CHARS, false};
+    va_list args;
+    va_start(args, format);
+    formatText(out, format, args);
+    va_end(args);
+    updateLabel(label, text, out.len);
+}
+
+void GFX_createFramebuf(bool doubleBuffer)
+{
+    size_t size = _width * _height * sizeof(uint16_t);
+
+    gfxFramebufs[0] = static_cast<uint16_t *>(malloc(size));
+    gfxFramebufs[1] = doubleBuffer ? static_cast<uint16_t *>(malloc(size)) : NULL;
+    gfxFramebuffer = gfxFramebufs[0];
+}
+
+bool GFX_createIndexedFramebuf()
+{
+    gfxIndexBuf = static_cast<uint8_t *>(malloc(_width * _height));
+    if (gfxIndexBuf == NULL)
+        return false;
+
+    // Until GFX_setPalette() is called, indices read as RGB332
+    for (uint16_t i = 0; i < 256; i++)
+    {
+        uint8_t r = i >> 5, g = (i >> 2) & 7, b = i & 3;
+        gfxPalette[i] = ((r * 31 / 7) << 11) | ((g * 63 / 7) << 5) | (b * 31 / 3);
+    }
+    return true;
+}
+
+void GFX_setPalette(uint8_t first, const uint16_t *colors, uint16_t count)
+{
+    if (queueing())
+        GFX_waitFlush(); // core1 may be expanding pixels through the palette
+    if (count > 256 - first)
+        count = 256 - first;
+    memcpy(gfxPalette + first, colors, count * sizeof(uint16_t));
+    markDirty(0, 0, _width, _height); // every pixel may have changed color
+    gfxRowHashValid = false;          // and the indices do not show it
+}
+
+uint16_t GFX_getPalette(uint8_t index)
+{
+    return gfxPalette[index];
+}
+
+bool GFX_createBandBuffer(uint16_t lines, uint16_t maxCommands)
+{
+    if (lines == 0 || maxCommands == 0)
+        return false;
+    if (lines > _height)
+        lines = _height;
+
+    size_t size = _width * lines * sizeof(uint16_t);
+    gfxBandBufs[0] = static_cast<uint16_t *>(malloc(size));
+    gfxBandBufs[1] = static_cast<uint16_t *>(malloc(size));
+    gfxCmds = static_cast<gfxCmd *>(malloc(maxCommands * sizeof(gfxCmd)));
+    if (gfxBandBufs[0] == NULL || gfxBandBufs[1] == NULL || gfxCmds == NULL)
+    {
+        GFX_destroyFramebuf();
+        return false;
+    }
+
+    gfxBandLines = lines;
+    gfxCmdMax = maxCommands;
+    gfxCmdCount = 0;
+    gfxCmdOverflow = false;
+    gfxBandClip = gfxClipArea;
+    return true;
+}
+
+bool GFX_displayListOverflowed()
+{
+    return gfxCmdOverflow;
+}
+
+void GFX_destroyFramebuf()
+{
+    GFX_stopCore1();
+    GFX_waitFlush(); // the panel may still be reading the front buffer
+    if (gfxHwScroll)
+        LCD_disableVerticalScroll();
+    gfxHwScroll = false;
+    gfxScrollRow = 0;
+    gfxScrollPending = false;
+    free(gfxFramebufs[0]);
+    free(gfxFramebufs[1]);
+    gfxFramebufs[0] = gfxFramebufs[1] = NULL;
+    gfxFramebuffer = NULL;
+    free(gfxIndexBuf);
+    gfxIndexBuf = NULL;
+    free(gfxRowHash);
+    gfxRowHash = NULL;
+
+    free(gfxBandBufs[0]);
+    free(gfxBandBufs[1]);
+    free(gfxCmds);
+    gfxBandBufs[0] = gfxBandBufs[1] = NULL;
+    gfxCmds = NULL;
+    gfxCmdMax = gfxCmdCount = 0;
+    gfxBandLines = 0;
+}
+
+static void reverseRows(uint16_t first, uint16_t last)
+{
+    while (last - first > 1)
+    {
+        uint16_t *a = gfxFramebuffer + first++ * _width;
+        uint16_t *b = gfxFramebuffer + --last * _width;
+        for (uint16_t i = 0; i < _width; i++)
+        {
+            uint16_t t = a[i];
+            a[i] = b[i];
+            b[i] = t;
+        }
+    }
+}
+
+// Rotate the framebuffer rows so screen row 0 is stored first again
+static void unrollScroll()
+{
+    if (gfxScrollRow != 0 && gfxFramebuffer != NULL)
+    {
+        reverseRows(0, gfxScrollRow);
+        reverseRows(gfxScrollRow, _height);
+        reverseRows(0, _height);
+        markDirty(0, 0, _width, _height);
+    }
+    gfxScrollRow = 0;
+    gfxScrollPending = false;
+}
+
+static void syncScroll()
+{
+    // LCD_setRotation() drops the panel scroll definition
+    if (gfxHwScroll && !LCD_isVerticalScrollEnabled())
+    {
+        gfxHwScroll = false;
+        unrollScroll();
+    }
+}
+
+static void sendScroll()
+{
+    // Moved only after the new rows are in frame memory so they never show stale
+    if (gfxScrollPending)
+    {
+        LCD_setScrollOffset(gfxScrollRow);
+        gfxScrollPending = false;
+    }
+}
+
+bool GFX_setHardwareScroll(bool enable)
+{
+    if (queueing())
+        GFX_waitFlush(); // with the core1 worker idle its state can be changed from here
+    syncScroll();
+    unrollScroll();
+    if (gfxHwScroll)
+    {
+        LCD_disableVerticalScroll();
+        gfxHwScroll = false;
+    }
+
+    if (!enable)
+        return true;
+    if (gfxFramebuffer == NULL || gfxFramebufs[1] != NULL)
+        return false;
+    gfxHwScroll = LCD_enableVerticalScroll();
+    return gfxHwScroll;
+}
+
+static void replayCmd(const gfxCmd &c)
+{
+    switch (c.op)
+    {
+    case GFX_OP_PIXEL:
+        GFX_drawPixel(c.x0, c.y0, c.color);
+        break;
+    case GFX_OP_LINE:
+        drawLine(c.x0, c.y0, c.x1, c.y1, c.color, c.c, c.bg);
+        break;
+    case GFX_OP_VLINE:
+        GFX_drawFastVLine(c.x0, c.y0, c.y1, c.color);
+        break;
+    case GFX_OP_HLINE:
+        GFX_drawFastHLine(c.x0, c.y0, c.x1, c.color);
+        break;
+    case GFX_OP_FILLRECT:
+        GFX_fillRect(c.x0, c.y0, c.x1, c.y1, c.color);
+        break;
+    case GFX_OP_CHAR:
+        writeChar((const GFXfont *)c.data, c.x0, c.y0, c.c, c.color, c.bg, c.sx, c.sy);
+        break;
+    case GFX_OP_CIRCLE:
+        GFX_drawCircle(c.x0, c.y0, c.x1, c.color);
+        break;
+    case GFX_OP_FILLCIRCLE:
+        GFX_fillCircle(c.x0, c.y0, c.x1, c.color);
+        break;
+    case GFX_OP_BITMAP:
+        GFX_drawBitmap(c.x0, c.y0, (const uint8_t *)c.data, c.x1, c.y1, c.color, c.bg);
+        break;
+    case GFX_OP_BITMAPMASK:
+        GFX_drawBitmapMask(c.x0, c.y0, (const uint8_t *)c.data, c.x1, c.y1, c.color);
+        break;
+    case GFX_OP_FILLRECTALPHA:
+        GFX_fillRectAlpha(c.x0, c.y0, c.x1, c.y1, c.color, c.bg);
+        break;
+    case GFX_OP_RGBBITMAPALPHA:
+        GFX_drawRGBBitmapAlpha(c.x0, c.y0, (const uint16_t *)c.data, c.x1, c.y1, c.bg);
+        break;
+    case GFX_OP_ALPHAMASK:
+        GFX_drawAlphaMask(c.x0, c.y0, (const uint8_t *)c.data, c.x1, c.y1, c.color);
+        break;
+    case GFX_OP_LINEAA:
+        GFX_drawLineAA(c.x0, c.y0, c.x1, c.y1, c.color);
+        break;
+    case GFX_OP_CIRCLEAA:
+        GFX_drawCircleAA(c.x0, c.y0, c.x1, c.color);
+        break;
+    case GFX_OP_CLIP:
+        gfxDrawClip.x0 = c.x0;
+        gfxDrawClip.y0 = c.y0;
+        gfxDrawClip.x1 = c.x1;
+        gfxDrawClip.y1 = c.y1;
+        break;
+    case GFX_OP_FLUSH:
+        GFX_flush();
+        break;
+    case GFX_OP_FLUSHASYNC:
+        GFX_flushAsync();
+        break;
+    case GFX_OP_FLUSHVSYNC:
+        GFX_flushVsync();
+        break;
+    case GFX_OP_UPDATE:
+        GFX_Update();
+        break;
+    case GFX_OP_SCROLL:
+        GFX_scrollUp(c.x0);
+        break;
+    }
+}
+
+// Core1 entry point: run queued calls in order. A call is only released
+// from the queue once it has run, so an empty queue means core1 is idle.
+static void workerMain()
+{
+    for (;;)
+    {
+        const gfxCmd *c = static_cast<const gfxCmd *>(SPSC_beginPop(&gfxQueue));
+        bool stop = c->op == GFX_OP_STOP;
+        replayCmd(*c);
+        SPSC_endPop(&gfxQueue);
+        if (stop)
+            return;
+    }
+}
+
+bool GFX_startCore1(uint16_t queueLength)
+{
+    // Band mode records on core0 anyway, and direct mode has no frame for core1 to own
+    if (gfxWorker || gfxCmds != NULL || (gfxFramebuffer == NULL && gfxIndexBuf == NULL))
+        return false;
+    if (!SPSC_init(&gfxQueue, sizeof(gfxCmd), queueLength))
+        return false;
+
+    GFX_waitFlush();
+    gfxWorker = true;
+    multicore_launch_core1(workerMain);
+    return true;
+}
+
+void GFX_stopCore1()
+{
+    if (!queueing())
+        return;
+    queueOp(GFX_OP_STOP, 0);
+    GFX_waitFlush();
+    multicore_reset_core1();
+    gfxWorker = false;
+    SPSC_free(&gfxQueue);
+}
+
+// Replay the display list one strip at a time. Each strip is sent while the
+// next renders into the other buffer; a buffer is only reused after the strip
+// sent from it has been followed by another, so its transfer has finished.
+static void flushBands()
+{
+    GFX_waitFlush();
+    uint8_t strip = 0;
+    for (int16_t top = 0; top < _height; top += gfxBandLines, strip ^= 1)
+    {
+        uint16_t rows = _height - top < gfxBandLines ? _height - top : gfxBandLines;
+        gfxFramebuffer = gfxBandBufs[strip];
+        gfxBandTop = top;
+        gfxBandBottom = top + rows;
+        gfxDrawClip = gfxBandClip; // as it was when the list started
+
+        for (uint32_t i = 0; i < (uint32_t)_width * rows; i++)
+            gfxFramebuffer[i] = clearColour;
+        for (uint16_t i = 0; i < gfxCmdCount; i++)
+        {
+            const gfxCmd &c = gfxCmds[i];
+            if (c.bottom >= top && c.top < gfxBandBottom)
+                replayCmd(c);
+        }
+
+        LCD_WriteBitmapAsync(0, top, _width, rows, gfxFramebuffer, NULL);
+    }
+
+    gfxFramebuffer = NULL;
+    gfxBandTop = 0;
+    gfxBandBottom = 0;
+    gfxCmdCount = 0;
+    gfxCmdOverflow = false;
+    gfxDrawClip = gfxBandClip = gfxClipArea;
+}
+
+// Expand a region of the indexed framebuffer through the palette in chunks.
+// Each chunk is sent while the next one is expanded into the other buffer.
+static void sendIndexed(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    static uint16_t chunk[2][GFX_INDEX_CHUNK];
+    uint16_t rowsPerChunk = GFX_INDEX_CHUNK / w;
+    uint8_t buf = 0;
+
+    LCD_waitWrite(); // a chunk buffer may still be in flight from the last call
+    while (h > 0)
+    {
+        uint16_t rows = h < rowsPerChunk ? h : rowsPerChunk;
+        uint16_t *out = chunk[buf];
+        for (uint16_t r = 0; r < rows; r++)
+        {
+            const uint8_t *in = gfxIndexBuf + x + (y + r) * _width;
+            for (uint16_t i = 0; i < w; i++)
+                *out++ = gfxPalette[in[i]];
+        }
+        LCD_WriteBitmapAsync(x, y, w, rows, chunk[buf], NULL);
+        y += rows;
+        h -= rows;
+        buf ^= 1;
+    }
+}
+
+// FNV-1a over 32-bit words. Rows keep their alignment from frame to frame,
+// so the unaligned head and tail only need to be hashed consistently.
+static uint32_t rowHash(const uint8_t *p, uint32_t bytes)
+{
+    uint32_t h = 2166136261u;
+    while (((uintptr_t)p & 3) && bytes > 0)
+    {
+        h = (h ^ *p++) * 16777619u;
+        bytes--;
+    }
+    const uint32_t *w = reinterpret_cast<const uint32_t *>(p);
+    for (uint32_t i = bytes / 4; i > 0; i--)
+        h = (h ^ *w++) * 16777619u;
+    p = reinterpret_cast<const uint8_t *>(w);
+    for (bytes &= 3; bytes > 0; bytes--)
+        h = (h ^ *p++) * 16777619u;
+    return h;
+}
+
+// Send only the runs of rows whose hash differs from the frame last sent.
+// Rows go out in storage order like GFX_flush(), so the hashes follow the
+// frame memory rows and hardware scrolling needs no special care. Each run
+// is sent while the rows after it are hashed.
+static void flushDiff()
+{
+    GFX_waitFlush();
+    syncScroll();
+    if (rotation != gfxRowHashRotation)
+        gfxRowHashValid = false; // the panel maps its frame memory differently now
+    gfxRowHashRotation = rotation;
+    uint32_t rowBytes = gfxIndexBuf != NULL ? _width : _width * 2u;
+    const uint8_t *fb = gfxIndexBuf != NULL ? gfxIndexBuf : reinterpret_cast<const uint8_t *>(gfxFramebuffer);
+    int32_t start = -1;
+
+    for (uint16_t row = 0; row <= _height; row++)
+    {
+        bool changed = false;
+        if (row < _height)
+        {
+            uint32_t h = rowHash(fb + row * rowBytes, rowBytes);
+            changed = !gfxRowHashValid || h != gfxRowHash[row];
+            gfxRowHash[row] = h;
+        }
+        if (changed && start < 0)
+            start = row;
+        else if (!changed && start >= 0)
+        {
+            if (gfxIndexBuf != NULL)
+                sendIndexed(0, start, _width, row - start);
+            else
+                LCD_WriteBitmapAsync(0, start, _width, row - start, gfxFramebuffer + start * _width, NULL);
+            start = -1;
+        }
+    }
+
+    LCD_waitWrite();
+    gfxRowHashValid = true;
+    sendScroll();
+    gfxDirtyCount = 0;
+}
+
+bool GFX_setDiffFlush(bool enable)
+{
+    if (queueing())
+        GFX_waitFlush(); // with the core1 worker idle its state can be changed from here
+    free(gfxRowHash);
+    gfxRowHash = NULL;
+    gfxRowHashValid = false;
+
+    if (!enable)
+        return true;
+    if (gfxFramebuffer == NULL && gfxIndexBuf == NULL)
+        return false;
+    // Enough rows for any rotation
+    uint16_t rows = _width > _height ? _width : _height;
+    gfxRowHash = static_cast<uint32_t *>(malloc(rows * sizeof(uint32_t)));
+    return gfxRowHash != NULL;
+}
+
+bool GFX_setGlyphCache(uint16_t glyphs)
+{
+    if (queueing())
+        GFX_waitFlush(); // core1 draws text, so wait until it is idle
+    free(gfxGlyphs);
+    gfxGlyphs = NULL;
+    gfxGlyphCount = 0;
+    if (glyphs == 0)
+        return true;
+    gfxGlyphs = static_cast<gfxGlyph *>(calloc(glyphs, sizeof(gfxGlyph)));
+    if (gfxGlyphs == NULL)
+        return false;
+    gfxGlyphCount = glyphs;
+    return true;
+}
+
+bool GFX_setLayoutCache(uint16_t layouts)
+{
+    free(gfxLayouts);
+    gfxLayouts = NULL;
+    gfxLayoutCount = 0;
+    if (layouts == 0)
+        return true;
+    gfxLayouts = static_cast<gfxLayout *>(calloc(layouts, sizeof(gfxLayout)));
+    if (gfxLayouts == NULL)
+        return false;
+    gfxLayoutCount = layouts;
+    return true;
+}
+
+void GFX_flush()
+{
+    if (queueing())
+    {
+        queueOp(GFX_OP_FLUSH, 0);
+        GFX_waitFlush();
+        return;
+    }
+
+    if (gfxCmds != NULL)
+    {
+        flushBands();
+        return;
+    }
+
+    if (gfxRowHash != NULL)
+    {
+        flushDiff();
+        return;
+    }
+
+    if (gfxIndexBuf != NULL)
+    {
+        GFX_waitFlush();
+        sendIndexed(0, 0, _width, _height);
+        gfxDirtyCount = 0;
+        return;
+    }
+
+    if (gfxFramebuffer != NULL)
+    {
+        GFX_waitFlush();
+        syncScroll();
+        // Rows go out in storage order; the panel scroll offset puts them in place
+        LCD_WriteBitmap(0, 0, _width, _height, gfxFramebuffer);
+        sendScroll();
+        gfxDirtyCount = 0;
+    }
+}
+
+void GFX_flushAsync()
 {
-    cursor_x = x;
-    cursor_y = y;
+    if (queueing())
+    {
+        queueOp(GFX_OP_FLUSHASYNC, 0);
+        return;
+    }
+
+    if (gfxFramebufs[1] == NULL)
+    {
+        // Single buffer: the caller would draw into the buffer being sent
+        GFX_flush();
+        if (gfxFlushCallback)
+            gfxFlushCallback();
+        return;
+    }
+
+    // Hand the finished frame to the panel and draw the next one into the
+    // other buffer. The DMA engine owns the front buffer until the fence.
+    GFX_waitFlush();
+    uint16_t *front = gfxFramebuffer;
+    LCD_WriteBitmapAsync(0, 0, _width, _height, front, gfxFlushCallback);
+    gfxRowHashValid = false; // rows are only hashed by GFX_flush()
+    gfxFramebuffer = (front == gfxFramebufs[0]) ? gfxFramebufs[1] : gfxFramebufs[0];
+    gfxDirtyCount = 0;
 }
 
-void GFX_setTextColor(uint16_t color)
+bool GFX_isFlushDone()
 {
-    textcolor = color;
+    if (queueing() && SPSC_count(&gfxQueue) != 0)
+        return false;
+    return !gfxVsyncBusy && LCD_isWriteDone();
 }
 
-void GFX_setTextBack(uint16_t color)
+void GFX_waitFlush()
 {
-    textbgcolor = color;
+    // On core0 first let the worker run everything queued so far
+    while (queueing() && SPSC_count(&gfxQueue) != 0)
+        tight_loop_contents();
+    while (gfxVsyncBusy)
+        tight_loop_contents();
+    LCD_waitWrite();
 }
 
-void GFX_setFont(const GFXfont *f)
+uint64_t GFX_vsyncBandStart(uint64_t teTime, uint32_t period, uint16_t line0, uint16_t line1,
+                            uint32_t sendTime, bool ascending)
 {
-    if (f)
-    { // Font struct pointer passed in?
-        if (!gfxFont)
-        { // And no current font struct?
-            // Switching from classic to new font behavior.
-            // Move cursor pos down 6 pixels so it's on baseline.
-            cursor_y += 6;
-        }
-    }
-    else if (gfxFont)
-    { // NULL passed.  Current font struct defined?
-        // Switching from new to classic font behavior.
-        // Move cursor pos up 6 pixels so it's at top-left of char.
-        cursor_y -= 6;
-    }
-    gfxFont = (GFXfont *)f;
+    // The scan reaches panel line n at teTime + n * period / ST7789_RAM_ROWS
+    uint64_t scan0 = teTime + (uint64_t)line0 * period / ST7789_RAM_ROWS;
+    uint64_t scan1 = teTime + (uint64_t)line1 * period / ST7789_RAM_ROWS;
+
+    if (!ascending)
+        return scan1; // the first row written is the last one scanned
+
+    // Both advance linearly, so the write stays behind the scan if its first
+    // and last rows do
+    uint64_t end = scan1 > teTime + sendTime ? scan1 - sendTime : teTime;
+    return scan0 > end ? scan0 : end;
 }
 
-void fillCircleHelper(int16_t x0, int16_t y0, int16_t r,
-                      uint8_t corners, int16_t delta,
-                      uint16_t color)
+static void vsyncBandRows(uint16_t &row0, uint16_t &row1)
 {
+    // With MY set the panel scans the screen from the bottom up
+    uint8_t band = rotation == 0 ? gfxVsyncBands - 1 - gfxVsyncBand : gfxVsyncBand;
+    row0 = (uint32_t)_height * band / gfxVsyncBands;
+    row1 = (uint32_t)_height * (band + 1) / gfxVsyncBands;
+}
 
-    int16_t f = 1 - r;
-    int16_t ddF_x = 1;
-    int16_t ddF_y = -2 * r;
-    int16_t x = 0;
-    int16_t y = r;
-    int16_t px = x;
-    int16_t py = y;
+static void vsyncBandDone();
 
-    delta++; // Avoid some +1's in the loop
+static void vsyncSendBand()
+{
+    uint16_t row0, row1;
+    vsyncBandRows(row0, row1);
+    gfxVsyncSent = time_us_64();
+    LCD_WriteFramePart(0, row0, _width, row1 - row0, gfxVsyncBuf + row0 * _width, vsyncBandDone);
+}
 
-    while (x < y)
-    {
-        if (f >= 0)
-        {
-            y--;
-            ddF_y += 2;
-            f += ddF_y;
-        }
-        x++;
-        ddF_x += 2;
-        f += ddF_x;
-        // These checks avoid double-drawing certain lines, important
-        // for the SSD1306 library which has an INVERT drawing mode.
-        if (x < (y + 1))
-        {
-            if (corners & 1)
-                GFX_drawFastVLine(x0 + x, y0 - y, 2 * y + delta, color);
-            if (corners & 2)
-                GFX_drawFastVLine(x0 - x, y0 - y, 2 * y + delta, color);
-        }
-        if (y != py)
-        {
-            if (corners & 1)
-                GFX_drawFastVLine(x0 + py, y0 - px, 2 * px + delta, color);
-            if (corners & 2)
-                GFX_drawFastVLine(x0 - py, y0 - px, 2 * px + delta, color);
-            py = y;
-        }
-        px = x;
-    }
+static int64_t vsyncAlarm(alarm_id_t, void *)
+{
+    vsyncSendBand();
+    return 0;
 }
 
-void GFX_fillCircle(int16_t x0, int16_t y0, int16_t r,
-                    uint16_t color)
+static void vsyncNextBand()
 {
+    uint16_t row0, row1;
+    vsyncBandRows(row0, row1);
+    uint32_t sendTime = (gfxVsyncRowTime * (row1 - row0)) >> 4;
+    uint32_t period = LCD_getTEPeriod();
+    uint64_t start;
 
-    GFX_drawFastVLine(x0, y0 - r, 2 * r + 1, color);
-    fillCircleHelper(x0, y0, r, 3, 0, color);
+    switch (rotation)
+    {
+    case 2:
+        start = GFX_vsyncBandStart(gfxVsyncTe, period, _ystart + row0, _ystart + row1, sendTime, true);
+        break;
+    case 0:
+        start = GFX_vsyncBandStart(gfxVsyncTe, period, ST7789_RAM_ROWS - _ystart - row1,
+                                   ST7789_RAM_ROWS - _ystart - row0, sendTime, false);
+        break;
+    default: // rows and columns exchanged: every row crosses the whole scan
+        start = gfxVsyncTe;
+        break;
+    }
+
+    uint64_t now = time_us_64();
+    if (start > now && add_alarm_in_us(start - now, vsyncAlarm, NULL, true) >= 0)
+        return;
+    vsyncSendBand();
 }
 
-void GFX_drawCircle(int16_t x0, int16_t y0, int16_t r,
-                    uint16_t color)
+static void vsyncBandDone()
 {
+    uint16_t row0, row1;
+    vsyncBandRows(row0, row1);
+    uint32_t rowTime = (uint32_t)((time_us_64() - gfxVsyncSent) << 4) / (row1 - row0);
+    gfxVsyncRowTime = (gfxVsyncRowTime + rowTime) / 2;
 
-    int16_t f = 1 - r;
-    int16_t ddF_x = 1;
-    int16_t ddF_y = -2 * r;
-    int16_t x = 0;
-    int16_t y = r;
+    if (++gfxVsyncBand < gfxVsyncBands)
+    {
+        vsyncNextBand();
+        return;
+    }
+
+    LCD_endFrame();
+    gfxVsyncBusy = false;
+    if (gfxFlushCallback)
+        gfxFlushCallback();
+}
 
-    GFX_drawPixel(x0, y0 + r, color);
-    GFX_drawPixel(x0, y0 - r, color);
-    GFX_drawPixel(x0 + r, y0, color);
-    GFX_drawPixel(x0 - r, y0, color);
+static void vsyncOnTE()
+{
+    if (!gfxVsyncArmed)
+        return;
+    gfxVsyncArmed = false;
+    gfxVsyncTe = LCD_getTETime();
+    vsyncNextBand();
+}
 
-    while (x < y)
+void GFX_flushVsync()
+{
+    if (queueing())
     {
-        if (f >= 0)
-        {
-            y--;
-            ddF_y += 2;
-            f += ddF_y;
-        }
-        x++;
-        ddF_x += 2;
-        f += ddF_x;
+        queueOp(GFX_OP_FLUSHVSYNC, 0);
+        return;
+    }
 
-        GFX_drawPixel(x0 + x, y0 + y, color);
-        GFX_drawPixel(x0 - x, y0 + y, color);
-        GFX_drawPixel(x0 + x, y0 - y, color);
-        GFX_drawPixel(x0 - x, y0 - y, color);
-        GFX_drawPixel(x0 + y, y0 + x, color);
-        GFX_drawPixel(x0 - y, y0 + x, color);
-        GFX_drawPixel(x0 + y, y0 - x, color);
-        GFX_drawPixel(x0 - y, y0 - x, color);
+    if (gfxFramebuffer == NULL && gfxCmds == NULL && gfxIndexBuf == NULL)
+        return;
+    if (!LCD_hasTE() || gfxHwScroll || gfxFramebuffer == NULL)
+    {
+        // No TE line, frame memory rows no longer match scan lines, or the
+        // frame is rendered or expanded chunk by chunk as it goes out
+        GFX_flushAsync();
+        return;
     }
+
+    GFX_waitFlush();
+    if (gfxVsyncRowTime == 0)
+        gfxVsyncRowTime = (_width * 16u * 16u) / 40u; // 16-bit pixels at a nominal 40 MHz
+
+    gfxVsyncBuf = gfxFramebuffer;
+    gfxRowHashValid = false;
+    gfxVsyncBand = 0;
+    gfxVsyncBands = (rotation & 1) ? 1 : GFX_VSYNC_BANDS;
+    gfxVsyncBusy = true;
+    LCD_beginFrame(); // LCD_* calls wait for the whole frame, not just a band
+    LCD_setTECallback(vsyncOnTE);
+    gfxVsyncArmed = true;
+    gfxDirtyCount = 0;
+
+    if (gfxFramebufs[1] != NULL)
+        gfxFramebuffer = (gfxVsyncBuf == gfxFramebufs[0]) ? gfxFramebufs[1] : gfxFramebufs[0];
+    else
+        GFX_waitFlush(); // the caller would draw into the frame being sent
 }
 
-char printBuf[100];
-void printString(char s[])
+void GFX_setFlushCallback(void (*cb)(void))
 {
-    uint8_t n = strlen(s);
-    for (int i = 0; i < n; i++)
-        GFX_write(s[i]);
+    gfxFlushCallback = cb;
 }
 
-void GFX_printf(const char *format, ...)
+// Send one dirty region from the framebuffer. Whole rows can go out
+// asynchronously as one block; other regions are written row by row.
+static void sendRegion(const gfxRect &r, bool async)
 {
-    va_list args;
-    va_start(args, format);
-    vsprintf(printBuf, format, args);
-    printString(printBuf);
-    va_end(args);
+    uint16_t w = r.x1 - r.x0 + 1;
+    uint16_t h = r.y1 - r.y0 + 1;
+    uint16_t row = fbRow(r.y0);
+
+    if (async && w == _width && row + h <= _height)
+    {
+        LCD_WriteBitmapAsync(0, row, w, h, gfxFramebuffer + row * _width, NULL);
+        return;
+    }
+
+    // A region may wrap round the end of the row ring
+    if (row + h > _height)
+    {
+        uint16_t part = _height - row;
+        LCD_WriteBitmapStride(r.x0, row, w, part, gfxFramebuffer + r.x0 + row * _width, _width);
+        h -= part;
+        row = 0;
+    }
+    LCD_WriteBitmapStride(r.x0, row, w, h, gfxFramebuffer + r.x0 + row * _width, _width);
 }
 
-void GFX_createFramebuf()
+void GFX_Update()
 {
-    // fixed casting issue
-    void *some_void_pointer = malloc(_width * _height * sizeof(uint16_t));
+    if (queueing())
+    {
+        queueOp(GFX_OP_UPDATE, 0);
+        return;
+    }
 
-    gfxFramebuffer = static_cast<uint16_t *>(some_void_pointer);
+    if (gfxCmds != NULL)
+    {
+        // Band mode keeps no frame between flushes to send parts of
+        GFX_flush();
+        return;
+    }
+
+    if (gfxDirtyCount == 0)
+        return;
+
+    if (gfxFramebufs[1] != NULL || gfxRowHash != NULL)
+    {
+        // The draw buffer only holds this frame's changes on top of the frame
+        // before last, so a partial update would resend stale pixels. A diff
+        // flush finds the changes itself.
+        GFX_flush();
+        return;
+    }
+
+    GFX_waitFlush();
+    if (gfxIndexBuf != NULL)
+    {
+        for (uint8_t i = 0; i < gfxDirtyCount; i++)
+        {
+            const gfxRect &r = gfxDirty[i];
+            sendIndexed(r.x0, r.y0, r.x1 - r.x0 + 1, r.y1 - r.y0 + 1);
+        }
+        gfxDirtyCount = 0;
+        return;
+    }
+
+    syncScroll();
+    LCD_beginWrite();
+    for (uint8_t i = 0; i < gfxDirtyCount; i++)
+        sendRegion(gfxDirty[i], false);
+    LCD_endWrite();
+    sendScroll();
+    gfxDirtyCount = 0;
 }
-void GFX_destroyFramebuf()
+
+// Find the save slot of a display, allocating one on first use
+static gfxState *displayState(LCD_Display *display)
 {
-    free(gfxFramebuffer);
-    gfxFramebuffer = NULL;
+    int8_t slot = -1;
+    for (uint8_t i = 0; i < LCD_MAX_DISPLAYS; i++)
+    {
+        if (gfxSlots[i].display == display)
+            return gfxSlots[i].state;
+        if (gfxSlots[i].display == NULL && slot < 0)
+            slot = i;
+    }
+    if (slot < 0)
+        return NULL;
+
+    gfxState *s = static_cast<gfxState *>(calloc(1, sizeof(gfxState)));
+    if (s == NULL)
+        return NULL;
+    s->textsize_x = 1;
+    s->textsize_y = 1;
+    s->textcolor = GFX_WHITE;
+    s->textbgcolor = GFX_BLACK;
+    s->clearColour = GFX_BLACK;
+    s->wrap = 1;
+    s->gfxClipArea = gfxNoClip;
+    s->gfxDrawClip = gfxNoClip;
+    s->gfxBandClip = gfxNoClip;
+    gfxSlots[slot].display = display;
+    gfxSlots[slot].state = s;
+    return s;
 }
 
-void GFX_flush()
+bool GFX_selectDisplay(LCD_Display *display)
 {
-    if (gfxFramebuffer != NULL)
+    if (gfxWorker)
+        return false; // core1 owns the drawing state
+    LCD_Display *current = LCD_getDisplay();
+    gfxState *from = displayState(current);
+    if (from == NULL)
+        return false;
+
+    // Vsync state is not saved, and the palette chunk buffers are shared
+    while (gfxVsyncBusy)
+        tight_loop_contents();
+    if (gfxIndexBuf != NULL)
+        LCD_waitWrite();
+
+    LCD_selectDisplay(display);
+    display = LCD_getDisplay();
+    if (display == current)
+        return true;
+    gfxState *to = displayState(display);
+    if (to == NULL)
     {
-        LCD_WriteBitmap(0, 0, _width, _height, gfxFramebuffer);
-        gfxFbUpdated = false;
+        LCD_selectDisplay(current);
+        return false;
     }
+
+    gfxState *s = from;
+    GFX_DISPLAY_STATE(GFX_SAVE)
+    s = to;
+    GFX_DISPLAY_STATE(GFX_LOAD)
+    return true;
 }
 
-void GFX_Update()
+void GFX_updateDisplays(LCD_Display *const *displays, uint8_t count)
 {
-    if (gfxFbUpdated)
-        GFX_flush();
+    if (count > LCD_MAX_DISPLAYS)
+        count = LCD_MAX_DISPLAYS;
+    LCD_Display *previous = LCD_getDisplay();
+    int8_t next[LCD_MAX_DISPLAYS]; ///< Next dirty region to send, -1 before the first
+    bool done[LCD_MAX_DISPLAYS] = {false};
+    uint8_t pending = count;
+
+    for (uint8_t k = 0; k < count; k++)
+        next[k] = -1;
+
+    // Start one region per panel whose bus is idle, then move on, so panels
+    // on separate buses receive their regions at the same time
+    while (pending > 0)
+    {
+        for (uint8_t k = 0; k < count; k++)
+        {
+            if (done[k])
+                continue;
+            // Switching copies the whole drawing state, so only switch to a
+            // panel that can take its next region now
+            if (!LCD_isDisplayIdle(displays[k]))
+                continue; // still sending its last region
+            if (!GFX_selectDisplay(displays[k]))
+            {
+                done[k] = true;
+                pending--;
+                continue;
+            }
+
+            if (next[k] < 0)
+            {
+                next[k] = 0;
+                if (gfxCmds != NULL || gfxIndexBuf != NULL || gfxFramebuffer == NULL || gfxRowHash != NULL)
+                {
+                    // Rendered or expanded chunk by chunk as it goes out, or
+                    // diffed against the frame last sent
+                    GFX_Update();
+                }
+                else if (gfxDirtyCount > 0 && gfxFramebufs[1] != NULL)
+                {
+                    // A partial update would resend stale pixels. The buffers
+                    // are not swapped, as the send is waited for below.
+                    LCD_WriteBitmapAsync(0, 0, _width, _height, gfxFramebuffer, NULL);
+                    next[k] = gfxDirtyCount;
+                    continue;
+                }
+                else
+                    syncScroll();
+            }
+            if (next[k] < gfxDirtyCount)
+            {
+                sendRegion(gfxDirty[next[k]++], true);
+                continue;
+            }
+
+            // Every region has left the bus
+            sendScroll();
+            gfxDirtyCount = 0;
+            done[k] = true;
+            pending--;
+        }
+        tight_loop_contents();
+    }
+
+    GFX_selectDisplay(previous);
 }
 
 void initGfxDmaChan()
@@ -486,12 +3529,28 @@ void initGfxDmaChan()
     }
 }
 
-void dma_memset(void *dest, uint8_t val, size_t num)
+// Widest DMA transfer that the addresses and byte count are all aligned to
+static enum dma_channel_transfer_size dmaTransferSize(uintptr_t bits)
+{
+    if ((bits & 3) == 0)
+        return DMA_SIZE_32;
+    if ((bits & 1) == 0)
+        return DMA_SIZE_16;
+    return DMA_SIZE_8;
+}
+
+// Fill num bytes at dest with a repeating 32-bit pattern whose bytes or
+// halfwords are all the same
+static void dmaFill(void *dest, uint32_t pattern, size_t num)
 {
     initGfxDmaChan();
 
+    static uint32_t fill; // read repeatedly by the DMA
+    fill = pattern;
+    enum dma_channel_transfer_size size = dmaTransferSize((uintptr_t)dest | num);
+
     dma_channel_config c = dma_channel_get_default_config(memcpy_dma_chan);
-    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_transfer_data_size(&c, size);
     channel_config_set_read_increment(&c, false);
     channel_config_set_write_increment(&c, true);
 
@@ -499,8 +3558,8 @@ void dma_memset(void *dest, uint8_t val, size_t num)
         memcpy_dma_chan, // Channel to be configured
         &c,              // The configuration we just created
         dest,            // The initial write address
-        &val,            // The initial read address
-        num,             // Number of transfers; in this case each is 1 byte.
+        &fill,           // The initial read address
+        num >> size,     // Number of transfers of 1 << size bytes each
         true             // Start immediately.
     );
 
@@ -510,12 +3569,19 @@ void dma_memset(void *dest, uint8_t val, size_t num)
     dma_channel_wait_for_finish_blocking(memcpy_dma_chan);
 }
 
+void dma_memset(void *dest, uint8_t val, size_t num)
+{
+    dmaFill(dest, val * 0x01010101u, num);
+}
+
 void dma_memcpy(void *dest, void *src, size_t num)
 {
     initGfxDmaChan();
 
+    enum dma_channel_transfer_size size = dmaTransferSize((uintptr_t)dest | (uintptr_t)src | num);
+
     dma_channel_config c = dma_channel_get_default_config(memcpy_dma_chan);
-    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_transfer_data_size(&c, size);
     channel_config_set_read_increment(&c, true);
     channel_config_set_write_increment(&c, true);
 
@@ -524,7 +3590,7 @@ void dma_memcpy(void *dest, void *src, size_t num)
         &c,              // The configuration we just created
         dest,            // The initial write address
         src,             // The initial read address
-        num,             // Number of transfers; in this case each is 1 byte.
+        num >> size,     // Number of transfers of 1 << size bytes each
         true             // Start immediately.
     );
 
@@ -534,18 +3600,70 @@ void dma_memcpy(void *dest, void *src, size_t num)
     dma_channel_wait_for_finish_blocking(memcpy_dma_chan);
 }
 
+// Move damage recorded before a scroll to where that content now is
+static void scrollDirty(int n)
+{
+    for (uint8_t i = 0; i < gfxDirtyCount;)
+    {
+        gfxRect &r = gfxDirty[i];
+        r.y0 -= n;
+        r.y1 -= n;
+        if (r.y1 < 0)
+        {
+            r = gfxDirty[--gfxDirtyCount];
+            continue;
+        }
+        if (r.y0 < 0)
+            r.y0 = 0;
+        i++;
+    }
+}
+
 void GFX_scrollUp(int n)
 {
+    if (queueing())
+    {
+        queueOp(GFX_OP_SCROLL, n > _height ? _height : n);
+        return;
+    }
+
+    if (gfxIndexBuf)
+    {
+        if (n > _height)
+            n = _height;
+        size_t linesCopy = _width * (_height - n);
+        dma_memcpy(gfxIndexBuf, gfxIndexBuf + _width * n, linesCopy);
+        dma_memset(gfxIndexBuf + linesCopy, 0, _width * n);
+        markDirty(0, 0, _width, _height);
+        return;
+    }
+
     if (gfxFramebuffer)
     {
         if (n > _height)
             n = _height;
+
+        syncScroll();
+        if (gfxHwScroll)
+        {
+            // Advance the ring instead of moving pixels; only the rows that
+            // wrap round to the bottom need clearing and sending.
+            gfxScrollRow = fbRow(n == _height ? 0 : n);
+            gfxScrollPending = true;
+            scrollDirty(n);
+            clipToScreen();
+            writeFillRect(0, _height - n, _width, n, 0);
+            markDirty(0, _height - n, _width, n);
+            return;
+        }
+
         uint16_t *src = gfxFramebuffer + (_width * n);
         size_t linesCopy = _width * (_height - n);
         size_t linesFill = _width * n;
 
         dma_memcpy(gfxFramebuffer, src, 2 * linesCopy);
         dma_memset(gfxFramebuffer + linesCopy, 0, 2 * linesFill);
+        markDirty(0, 0, _width, _height);
     }
 }
 
@@ -557,25 +3675,54 @@ void GFX_setTextSize(uint8_t size)
 
 void GFX_drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int16_t h, uint16_t color, uint16_t bg)
 {
+    toScreen(x, y);
+    if (recording())
+    {
+        gfxCmd *c = recordCmd(GFX_OP_BITMAP, y, y + h - 1);
+        if (c)
+        {
+            c->x0 = x;
+            c->y0 = y;
+            c->x1 = w;
+            c->y1 = h;
+            c->color = color;
+            c->bg = bg;
+            c->data = bitmap;
+            commitCmd();
+        }
+        return;
+    }
+
     int16_t byteWidth = (w + 7) / 8; // Bitmap width in bytes
     uint8_t byte = 0;
 
-    for (int16_t j = 0; j < h; j++, y++)
+    beginClip();
+    if (clipRejects(x, y, w, h))
+        return;
+    markClipped(x, y, w, h);
+
+    // Only the part inside the clip, so pixels need no further checks
+    int16_t j0 = y < gfxClip.y0 ? gfxClip.y0 - y : 0;
+    int16_t j1 = gfxClip.y1 + 1 - y < h ? gfxClip.y1 + 1 - y : h;
+    int16_t i0 = x < gfxClip.x0 ? gfxClip.x0 - x : 0;
+    int16_t i1 = gfxClip.x1 + 1 - x < w ? gfxClip.x1 + 1 - x : w;
+
+    for (int16_t j = j0; j < j1; j++)
     {
-        for (int16_t i = 0; i < w; i++)
+        for (int16_t i = i0; i < i1; i++)
         {
-            if (i & 7)
-                byte <<= 1;
+            if (i == i0 || !(i & 7))
+                byte = bitmap[j * byteWidth + i / 8] << (i & 7);
             else
-                byte = bitmap[j * byteWidth + i / 8];
+                byte <<= 1;
 
             if (byte & 0x80)
             {
-                GFX_drawPixel(x + i, y, color);
+                putPixel(x + i, y + j, color);
             }
             else
             {
-                GFX_drawPixel(x + i, y, bg);
+                putPixel(x + i, y + j, bg);
             }
         }
     }
@@ -583,23 +3730,165 @@ void GFX_drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int1
 
 void GFX_drawBitmapMask(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int16_t h, uint16_t color)
 {
+    toScreen(x, y);
+    if (recording())
+    {
+        gfxCmd *c = recordCmd(GFX_OP_BITMAPMASK, y, y + h - 1);
+        if (c)
+        {
+            c->x0 = x;
+            c->y0 = y;
+            c->x1 = w;
+            c->y1 = h;
+            c->color = color;
+            c->data = bitmap;
+            commitCmd();
+        }
+        return;
+    }
+
     int16_t byteWidth = (w + 7) / 8; // Bitmap width in bytes
     uint8_t byte = 0;
 
-    for (int16_t j = 0; j < h; j++, y++)
+    beginClip();
+    if (clipRejects(x, y, w, h))
+        return;
+    markClipped(x, y, w, h);
+
+    // Only the part inside the clip, so pixels need no further checks
+    int16_t j0 = y < gfxClip.y0 ? gfxClip.y0 - y : 0;
+    int16_t j1 = gfxClip.y1 + 1 - y < h ? gfxClip.y1 + 1 - y : h;
+    int16_t i0 = x < gfxClip.x0 ? gfxClip.x0 - x : 0;
+    int16_t i1 = gfxClip.x1 + 1 - x < w ? gfxClip.x1 + 1 - x : w;
+
+    for (int16_t j = j0; j < j1; j++)
     {
-        for (int16_t i = 0; i < w; i++)
+        for (int16_t i = i0; i < i1; i++)
         {
-            if (i & 7)
-                byte <<= 1;
+            if (i == i0 || !(i & 7))
+                byte = bitmap[j * byteWidth + i / 8] << (i & 7);
             else
-                byte = bitmap[j * byteWidth + i / 8];
+                byte <<= 1;
 
             if (byte & 0x80)
             {
-                GFX_drawPixel(x + i, y, color);
+                putPixel(x + i, y + j, color);
             }
             // Don't draw background pixels - they remain transparent
         }
     }
-}
\ No newline at end of file
+}
+
+void GFX_drawRGBBitmapAlpha(int16_t x, int16_t y, const uint16_t *bitmap, int16_t w, int16_t h, uint8_t alpha)
+{
+    if (gfxIndexBuf != NULL)
+        return; // RGB565 pixels are not palette indices
+    toScreen(x, y);
+    if (recording())
+    {
+        gfxCmd *c = alpha ? recordCmd(GFX_OP_RGBBITMAPALPHA, y, y + h - 1) : NULL;
+        if (c)
+        {
+            c->x0 = x;
+            c->y0 = y;
+            c->x1 = w;
+            c->y1 = h;
+            c->bg = alpha;
+            c->data = bitmap;
+            commitCmd();
+        }
+        return;
+    }
+
+    uint32_t a = blendScale(alpha);
+    int32_t x0, y0, x1, y1;
+    beginClip();
+    if (!clipRect(x, y, w, h, x0, y0, x1, y1))
+        return;
+    markClipped(x, y, w, h);
+    const uint16_t *src = bitmap + (x0 - x) + (y0 - y) * w;
+
+    if (gfxFramebuffer == NULL)
+    {
+        // Nothing to blend with: mostly opaque bitmaps are drawn solid
+        if (a > 16)
+            LCD_WriteBitmapStride(x0, y0, x1 - x0, y1 - y0, src, w);
+        return;
+    }
+
+    int32_t row = fbRow(y0);
+    for (uint16_t *p = gfxFramebuffer + x0 + row * _width; y0 < y1; y0++, src += w)
+    {
+        if (a == 32)
+            memcpy(p, src, (x1 - x0) * 2);
+        else if (a > 0)
+            blendRow(p, src, x1 - x0, a);
+        p += _width;
+        if (++row == _height)
+        {
+            row = 0;
+            p = gfxFramebuffer + x0;
+        }
+    }
+}
+
+void GFX_drawAlphaMask(int16_t x, int16_t y, const uint8_t *mask, int16_t w, int16_t h, uint16_t color)
+{
+    toScreen(x, y);
+    if (recording())
+    {
+        gfxCmd *c = recordCmd(GFX_OP_ALPHAMASK, y, y + h - 1);
+        if (c)
+        {
+            c->x0 = x;
+            c->y0 = y;
+            c->x1 = w;
+            c->y1 = h;
+            c->color = color;
+            c->data = mask;
+            commitCmd();
+        }
+        return;
+    }
+
+    int32_t x0, y0, x1, y1;
+    beginClip();
+    if (!clipRect(x, y, w, h, x0, y0, x1, y1))
+        return;
+    markClipped(x, y, w, h);
+    const uint8_t *src = mask + (x0 - x) + (y0 - y) * w;
+
+    if (gfxFramebuffer == NULL)
+    {
+        // Nothing to blend with: mostly covered pixels are drawn solid
+        for (int32_t j = y0; j < y1; j++, src += w)
+            for (int32_t i = x0; i < x1; i++)
+                if (blendScale(src[i - x0]) > 16)
+                    putPixel(i, j, color);
+        return;
+    }
+
+    uint32_t f = (color | (uint32_t)color << 16) & GFX_BLEND_SPREAD;
+    int32_t row = fbRow(y0);
+    for (uint16_t *p = gfxFramebuffer + x0 + row * _width; y0 < y1; y0++, src += w)
+    {
+        for (int32_t i = 0; i < x1 - x0; i++)
+        {
+            uint32_t a = blendScale(src[i]);
+            if (a == 32)
+                p[i] = color;
+            else if (a > 0)
+            {
+                uint32_t b = (p[i] | (uint32_t)p[i] << 16) & GFX_BLEND_SPREAD;
+                uint32_t r = ((f * a + b * (32 - a)) >> 5) & GFX_BLEND_SPREAD;
+                p[i] = r | r >> 16;
+            }
+        }
+        p += _width;
+        if (++row == _height)
+        {
+            row = 0;
+            p = gfxFramebuffer + x0;
+        }
+    }
+}
@@ -13,6 +13,7 @@
 
 #include "pico/stdlib.h"
 #include "gfxfont.h"
+#include "st7789.h"
 
 /**
  * @brief Convert 8-bit RGB values to 16-bit RGB565 format
@@ -26,15 +27,204 @@
 // Framebuffer Management
 /**
  * @brief Create and allocate memory for the framebuffer
+ * @param doubleBuffer Allocate a second buffer so GFX_flushAsync() can send one
+ *                     frame while the next is drawn (doubles memory use)
  * @note Must be called before any drawing operations
  */
-void GFX_createFramebuf();
+void GFX_createFramebuf(bool doubleBuffer = false);
+
+/**
+ * @brief Create an 8-bit indexed framebuffer instead of GFX_createFramebuf()
+ * @return true if the buffer was allocated
+ * @note Uses half the memory of the RGB565 framebuffer. Color arguments of
+ *       all drawing functions are then palette indices (low 8 bits), which
+ *       the flush functions expand to RGB565 as they send. The palette starts
+ *       out reading indices as RGB332. Hardware scrolling is not available.
+ */
+bool GFX_createIndexedFramebuf();
+
+/**
+ * @brief Set palette entries of the indexed framebuffer
+ * @param first First index to set
+ * @param colors RGB565 colors
+ * @param count Number of entries
+ * @note Marks the whole screen for GFX_Update(), so cycling the palette
+ *       animates the screen without redrawing it.
+ */
+void GFX_setPalette(uint8_t first, const uint16_t *colors, uint16_t count);
+
+/**
+ * @brief Get a palette entry of the indexed framebuffer
+ * @param index Palette index
+ * @return RGB565 color
+ */
+uint16_t GFX_getPalette(uint8_t index);
+
+/**
+ * @brief Render through a display list and two small strip buffers instead of a framebuffer
+ * @param lines Rows per strip
+ * @param maxCommands Number of drawing calls the display list can hold
+ * @return true if the buffers were allocated
+ * @note Drawing calls are recorded rather than drawn. GFX_flush() replays
+ *       them into one strip at a time, each starting from the clear color,
+ *       sends the strip while the next one renders, then empties the list.
+ *       Uses 4 * lines * width bytes plus about 28 bytes per command. Bitmaps
+ *       are referenced, not copied, and must stay valid until the flush.
+ *       GFX_scrollUp() and hardware scrolling are not available in this mode.
+ */
+bool GFX_createBandBuffer(uint16_t lines, uint16_t maxCommands);
+
+/**
+ * @brief Check whether drawing calls were dropped because the display list was full
+ * @return true if calls were dropped since the last GFX_flush()
+ */
+bool GFX_displayListOverflowed();
+
+/**
+ * @brief Send only the rows that changed since the last flush
+ * @param enable true to keep a hash of every row as sent, false to stop
+ * @return true if enabled. Needs a framebuffer from GFX_createFramebuf() or
+ *         GFX_createIndexedFramebuf().
+ * @note Meant for loops that clear and redraw the whole frame, which defeats
+ *       damage tracking. GFX_flush() and GFX_Update() hash each row (a few
+ *       cycles per pixel), compare it with the frame last sent and send runs
+ *       of changed rows. Costs 4 bytes per row. GFX_flushAsync() with a double
+ *       framebuffer and GFX_flushVsync() send whole frames as before. Call
+ *       again after writing to the panel with LCD_* functions.
+ */
+bool GFX_setDiffFlush(bool enable);
+
+/**
+ * @brief Keep recently drawn glyphs pre-scaled and run-length encoded
+ * @param glyphs Number of glyphs to keep (about 108 bytes each), or 0 to free
+ *               the cache
+ * @return true if the cache was allocated
+ * @note Glyphs are keyed by font, character and text size and drawn as one
+ *       fill per run of set pixels instead of one per pixel. When the cache
+ *       is full the least recently drawn glyph is replaced. Works with the
+ *       classic font and GFXfont fonts; glyphs with more runs than a slot
+ *       holds are drawn as before. Shared by all displays.
+ */
+bool GFX_setGlyphCache(uint16_t glyphs);
+
+/**
+ * @brief Keep the layouts of recent GFX_drawTextBox() calls
+ * @param layouts Number of layouts to keep (about 360 bytes each), or 0 to
+ *                free the cache
+ * @return true if the cache was allocated
+ * @note Layouts are keyed by text, box size, flags, font and text size, so a
+ *       static label is measured and line-broken once and later draws replay
+ *       its glyph positions. The least recently drawn layout is replaced when
+ *       the cache is full. Text longer than 48 characters is laid out on
+ *       every draw. Shared by all displays.
+ */
+bool GFX_setLayoutCache(uint16_t layouts);
+
+/**
+ * @brief Hand rendering and display transfers to core1
+ * @param queueLength Drawing calls that can wait for core1, rounded up to a
+ *                    power of two (about 24 bytes each)
+ * @return true if core1 was started. Needs a framebuffer from
+ *         GFX_createFramebuf() or GFX_createIndexedFramebuf(); not available
+ *         in band mode.
+ * @note From then on drawing calls made on core0 only queue the call, and
+ *       core1 draws into the framebuffer and runs the flushes in order.
+ *       GFX_flushAsync(), GFX_flushVsync(), GFX_Update() and GFX_scrollUp()
+ *       return at once; GFX_flush() and GFX_waitFlush() wait for core1 to catch
+ *       up. When the queue is full core0 waits instead of dropping calls.
+ *       Bitmaps and fonts are referenced, not copied. Do not call LCD_*
+ *       functions or change rotation or framebuffers while core1 is running.
+ *       Completion callbacks still run on the core that called LCD_initDisplay().
+ */
+bool GFX_startCore1(uint16_t queueLength);
+
+/**
+ * @brief Wait for queued calls to finish and stop the core1 worker
+ * @note Called by GFX_destroyFramebuf(). Must be called on core0.
+ */
+void GFX_stopCore1();
+
+/**
+ * @brief Make a display the target of all following GFX_* and LCD_* calls
+ * @param display Display from LCD_createDisplay(), or NULL for the default one
+ * @return false if core1 is running or the drawing state could not be saved
+ * @note Use instead of LCD_selectDisplay() once GFX_* functions are used.
+ *       Each display keeps its own framebuffer, damage, cursor, text style
+ *       and flush callback. A frame still being sent by GFX_flushVsync(), or
+ *       from an indexed framebuffer, is completed before switching.
+ */
+bool GFX_selectDisplay(LCD_Display *display);
+
+/**
+ * @brief Send the changed regions of several displays, interleaved
+ * @param displays Displays to update (NULL for the default one)
+ * @param count Number of displays, at most LCD_MAX_DISPLAYS
+ * @note Does what GFX_Update() does for each display, but starts a region
+ *       on every panel whose bus is idle before waiting on any, so panels
+ *       on separate SPI peripherals or PIO blocks are written at the same
+ *       time. Returns when all are sent, with the previous display selected.
+ */
+void GFX_updateDisplays(LCD_Display *const *displays, uint8_t count);
 
 /**
  * @brief Destroy and free framebuffer memory
+ * @note Also frees the buffers allocated by GFX_createBandBuffer()
  */
 void GFX_destroyFramebuf();
 
+// Clipping and Origin
+/**
+ * @brief Restrict drawing to a rectangle within the current clip
+ * @param x Left edge, relative to the current origin
+ * @param y Top edge, relative to the current origin
+ * @param w Width of the rectangle
+ * @param h Height of the rectangle
+ * @return false if GFX_pushClip() calls are nested too deeply; nothing changes
+ * @note Every drawing call honours the clip, including GFX_fillScreen() and
+ *       GFX_clearScreen(), which then fill only the clipped area. Calls wholly
+ *       outside it are dropped before they are drawn or recorded. Restore the
+ *       previous clip with GFX_popClip().
+ */
+bool GFX_pushClip(int16_t x, int16_t y, int16_t w, int16_t h);
+
+/**
+ * @brief Clip to a rectangle and move the origin to its top-left corner
+ * @param x Left edge, relative to the current origin
+ * @param y Top edge, relative to the current origin
+ * @param w Width of the viewport
+ * @param h Height of the viewport
+ * @return false if GFX_pushClip() calls are nested too deeply; nothing changes
+ * @note Coordinates of drawing calls are relative to the viewport until the
+ *       matching GFX_popClip(). Text wraps at its right edge.
+ */
+bool GFX_pushViewport(int16_t x, int16_t y, int16_t w, int16_t h);
+
+/**
+ * @brief Restore the clip and origin saved by the last GFX_pushClip() or GFX_pushViewport()
+ */
+void GFX_popClip();
+
+/**
+ * @brief Set the screen position that coordinates of drawing calls are relative to
+ * @param x Screen column of x = 0
+ * @param y Screen row of y = 0
+ * @note Does not change the clip. GFX_popClip() restores the origin saved by
+ *       its GFX_pushClip().
+ */
+void GFX_setOrigin(int16_t x, int16_t y);
+
+/**
+ * @brief Get the screen column of the current origin
+ * @return Column set by GFX_setOrigin() or GFX_pushViewport()
+ */
+int16_t GFX_getOriginX();
+
+/**
+ * @brief Get the screen row of the current origin
+ * @return Row set by GFX_setOrigin() or GFX_pushViewport()
+ */
+int16_t GFX_getOriginY();
+
 // Basic Drawing Functions
 /**
  * @brief Draw a single pixel in the framebuffer
@@ -94,6 +284,54 @@ void GFX_setTextSize(uint8_t size);
  */
 void GFX_setFont(const GFXfont *f);
 
+/** @brief GFX_drawTextBox() flags: horizontal alignment (left is the default) */
+#define GFX_ALIGN_LEFT 0x00
+#define GFX_ALIGN_CENTER 0x01
+#define GFX_ALIGN_RIGHT 0x02
+/** @brief GFX_drawTextBox() flags: vertical alignment (top is the default) */
+#define GFX_ALIGN_TOP 0x00
+#define GFX_ALIGN_MIDDLE 0x04
+#define GFX_ALIGN_BOTTOM 0x08
+/** @brief GFX_drawTextBox() flag: break lines between words to fit the box width */
+#define GFX_TEXT_WRAP 0x10
+/** @brief GFX_drawTextBox() flag: end text cut off by the box with "..." */
+#define GFX_TEXT_ELLIPSIS 0x20
+
+/**
+ * @brief Measure text as GFX_write() would draw it from a cursor position
+ * @param str Text to measure
+ * @param x Cursor X coordinate to start from
+ * @param y Cursor Y coordinate to start from
+ * @param x1 Set to the left edge of the drawn pixels
+ * @param y1 Set to the top edge of the drawn pixels
+ * @param w Set to the width of the drawn pixels, 0 if the text draws nothing
+ * @param h Set to the height of the drawn pixels, 0 if the text draws nothing
+ * @note Uses the current font, text size and wrap setting. With a GFXfont
+ *       font the bounds are those of the glyph bitmaps around the baseline.
+ */
+void GFX_getTextBounds(const char *str, int16_t x, int16_t y, int16_t *x1, int16_t *y1, uint16_t *w,
+                       uint16_t *h);
+
+/**
+ * @brief Draw text laid out in a box
+ * @param x Left edge of the box
+ * @param y Top edge of the box
+ * @param w Box width
+ * @param h Box height
+ * @param str Text to draw; '\n' starts a new line
+ * @param flags GFX_ALIGN_* and GFX_TEXT_* flags, or'ed together
+ * @note Uses the current font, text size and colors and leaves the cursor
+ *       alone. Drawing is clipped to the box; lines that do not fully fit in
+ *       its height are left out, and GFX_TEXT_ELLIPSIS ends the last line
+ *       shown with "..." when text was left out. Without GFX_TEXT_WRAP only
+ *       '\n' breaks lines, and GFX_TEXT_ELLIPSIS also shortens lines wider
+ *       than the box. Lines are aligned by the sum of their glyph advances;
+ *       GFXfont text is placed with the tallest glyph of the font at the top.
+ *       Draws nothing if GFX_pushClip() calls are already nested too deeply
+ *       to clip to the box.
+ */
+void GFX_drawTextBox(int16_t x, int16_t y, int16_t w, int16_t h, const char *str, uint8_t flags);
+
 // Line Drawing Functions
 /**
  * @brief Draw a line between two points
@@ -105,6 +343,46 @@ void GFX_setFont(const GFXfont *f);
  */
 void GFX_drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
 
+/**
+ * @brief Draw a translucent line
+ * @param x0 Starting X coordinate
+ * @param y0 Starting Y coordinate
+ * @param x1 Ending X coordinate
+ * @param y1 Ending Y coordinate
+ * @param color 16-bit RGB565 color
+ * @param alpha Opacity, 0 (invisible) to 255 (same as GFX_drawLine())
+ * @note Blending needs an RGB565 framebuffer (GFX_createFramebuf() or
+ *       GFX_createBandBuffer()). Drawing straight to the panel or into an
+ *       indexed framebuffer, alpha above about half draws solid and the
+ *       rest is skipped. The same applies to the other *Alpha functions,
+ *       except that GFX_drawRGBBitmapAlpha() draws nothing into an indexed
+ *       framebuffer.
+ */
+void GFX_drawLineAlpha(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color, uint8_t alpha);
+
+/**
+ * @brief Draw lines joining a series of points, e.g. a plotted signal
+ * @param xs X coordinates of the points
+ * @param ys Y coordinates of the points
+ * @param n Number of points
+ * @param color 16-bit RGB565 color
+ * @note Draws the same pixels as GFX_drawLine() for each pair of neighbours,
+ *       but sets up clipping and damage tracking once for the whole series
+ *       and draws each joint pixel once.
+ */
+void GFX_drawPolyline(const int16_t *xs, const int16_t *ys, uint16_t n, uint16_t color);
+
+/**
+ * @brief Draw a batch of separate lines
+ * @param xy Endpoints, four values per line: x0, y0, x1, y1
+ * @param count Number of lines
+ * @param color 16-bit RGB565 color
+ * @note Like GFX_drawPolyline(), clipping and damage tracking are set up once
+ *       per batch, and a line starting where the previous one ended does not
+ *       draw the shared pixel again.
+ */
+void GFX_drawSegments(const int16_t *xy, uint16_t count, uint16_t color);
+
 /**
  * @brief Draw a fast vertical line
  * @param x X coordinate
@@ -144,6 +422,19 @@ void GFX_drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
  */
 void GFX_fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
 
+/**
+ * @brief Blend a filled rectangle over what is already drawn
+ * @param x Top-left X coordinate
+ * @param y Top-left Y coordinate
+ * @param w Width of the rectangle
+ * @param h Height of the rectangle
+ * @param color 16-bit RGB565 color
+ * @param alpha Opacity, 0 (invisible) to 255 (same as GFX_fillRect())
+ * @note Blends two framebuffer pixels per 32-bit word. See GFX_drawLineAlpha()
+ *       for modes without an RGB565 framebuffer.
+ */
+void GFX_fillRectAlpha(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color, uint8_t alpha);
+
 // Screen Functions
 /**
  * @brief Fill entire screen with a color
@@ -181,20 +472,178 @@ void GFX_drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color);
  */
 void GFX_fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color);
 
+/**
+ * @brief Draw an anti-aliased line
+ * @param x0 Starting X coordinate
+ * @param y0 Starting Y coordinate
+ * @param x1 Ending X coordinate
+ * @param y1 Ending Y coordinate
+ * @param color 16-bit RGB565 color
+ * @note Xiaolin Wu's algorithm: each step splits the pixel between the two
+ *       nearest to the ideal line and blends them by their coverage, using
+ *       integer arithmetic only. See GFX_drawLineAlpha() for modes without
+ *       an RGB565 framebuffer.
+ */
+void GFX_drawLineAA(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
+
+/**
+ * @brief Draw an anti-aliased circle outline
+ * @param x0 Center X coordinate
+ * @param y0 Center Y coordinate
+ * @param r Radius
+ * @param color 16-bit RGB565 color
+ * @note Like GFX_drawLineAA(); pixels may reach r + 1 from the center.
+ */
+void GFX_drawCircleAA(int16_t x0, int16_t y0, int16_t r, uint16_t color);
+
 // Advanced Functions
 /**
  * @brief Print formatted text at current cursor position
  * @param format Printf-style format string
  * @param ... Variable arguments
+ * @note Output is streamed to the text renderer with no intermediate buffer,
+ *       so it has no length limit. Supports the flags - + space 0 #, width and
+ *       precision (including *), the hh h l ll z j t L length modifiers and
+ *       the conversions d i u o x X c s p f F %. %f prints at most 9
+ *       decimals, so precisions above 9 are treated as 9, and shows "ovf"
+ *       for magnitudes beyond 64-bit integers. The unsupported conversions
+ *       e E g G a A and n take their argument, so later ones still line up,
+ *       and are printed as written, e.g. "%g".
  */
 void GFX_printf(const char *format, ...);
 
+/**
+ * @brief Print formatted text at a given position
+ * @param x X coordinate of the cursor
+ * @param y Y coordinate of the cursor
+ * @param format Printf-style format string, as for GFX_printf()
+ * @param ... Variable arguments
+ */
+void GFX_printfAt(int16_t x, int16_t y, const char *format, ...);
+
+/** @brief Longest text a GFX_Label shows; longer text is cut short */
+#define GFX_LABEL_CHARS 32
+
+/**
+ * @brief A line of text that redraws only the characters that change
+ *
+ * Set up with GFX_initLabel(), then update with GFX_setLabel() or
+ * GFX_printLabel(). The label remembers the glyphs it drew and where, so an
+ * update erases and draws only the glyphs whose character or position
+ * changed, and only that area is marked for the next flush.
+ *
+ * That needs a buffer that keeps what was drawn. In band mode
+ * (GFX_createBandBuffer()) and with a double framebuffer
+ * (GFX_createFramebuf(true)) each frame is drawn into a buffer that does not
+ * hold the last text, so every update erases the old glyphs and draws the
+ * whole label. Update it once per frame, after drawing what lies under it.
+ */
+typedef struct
+{
+    /** @brief Cursor position, as for GFX_setCursor() */
+    int16_t x, y;
+    /** @brief Font, text scale and color captured by GFX_initLabel() */
+    const GFXfont *font;
+    uint8_t sx, sy;
+    uint16_t color;
+    /** @brief Background changed glyphs are erased to; drawn behind classic font text if opaque */
+    uint16_t bg;
+    bool opaque;
+    /** @brief Text last drawn and the pen position of each character, relative to x */
+    uint8_t len;
+    uint8_t text[GFX_LABEL_CHARS];
+    int16_t pos[GFX_LABEL_CHARS];
+} GFX_Label;
+
+/**
+ * @brief Set up a label at a cursor position, showing no text yet
+ * @param label Label to set up
+ * @param x Cursor X coordinate of the first character
+ * @param y Cursor Y coordinate (the baseline for GFXfont fonts)
+ * @note Takes the current font, text size and colors. If the text color and
+ *       background are the same, text is drawn transparent and changed
+ *       glyphs are erased to the GFX_setClearColor() color. Set it up again
+ *       after clearing the screen under it, so the next update draws it all.
+ */
+void GFX_initLabel(GFX_Label *label, int16_t x, int16_t y);
+
+/**
+ * @brief Change the text of a label, redrawing only what changed
+ * @param label Label set up with GFX_initLabel()
+ * @param text New text, one line, at most GFX_LABEL_CHARS characters
+ * @note With a GFXfont font a changed advance moves every later glyph, and
+ *       those are redrawn too. Neighbouring glyphs that overlap an erased one
+ *       are drawn again. The label owns the area its glyphs cover.
+ */
+void GFX_setLabel(GFX_Label *label, const char *text);
+
+/**
+ * @brief Format the text of a label, redrawing only what changed
+ * @param label Label set up with GFX_initLabel()
+ * @param format Format string, as for GFX_printf()
+ * @param ... Variable arguments
+ */
+void GFX_printLabel(GFX_Label *label, const char *format, ...);
+
 /**
  * @brief Flush framebuffer contents to the display
  * @note Call this after drawing operations to update the screen
  */
 void GFX_flush();
 
+/**
+ * @brief Start sending the framebuffer and return without waiting
+ * @note With a double framebuffer the buffers are swapped: drawing continues
+ *       in the other buffer, which still holds the frame before last. With a
+ *       single framebuffer this behaves like GFX_flush(). Only overlaps the
+ *       transfer when the driver is built with USE_DMA.
+ */
+void GFX_flushAsync();
+
+/**
+ * @brief Send the framebuffer in step with the panel refresh to avoid tearing
+ * @note Needs a TE pin (see LCD_setTEPin()); otherwise behaves like
+ *       GFX_flushAsync(). The frame is split into bands. The first band
+ *       starts from the TE interrupt, and each later band is held back so the
+ *       write never overtakes the panel scan line. Buffers are handled as for
+ *       GFX_flushAsync(); with a single framebuffer this waits for the frame.
+ *       The bus stays reserved from this call until the last band is sent
+ *       (see LCD_beginFrame()), so LCD_* calls made meanwhile wait for it.
+ */
+void GFX_flushVsync();
+
+/**
+ * @brief Earliest time a band may start so its writes stay behind the scan line
+ * @param teTime Time of the TE edge that started the current scan (us)
+ * @param period Panel refresh period (us)
+ * @param line0 First panel scan line covered by the band
+ * @param line1 One past the last panel scan line covered by the band
+ * @param sendTime Time needed to send the band (us)
+ * @param ascending true if the band is written in scan order
+ * @return Start time in microseconds
+ * @note Pure function used by GFX_flushVsync(), exposed so the schedule can be
+ *       checked against a simulated TE signal.
+ */
+uint64_t GFX_vsyncBandStart(uint64_t teTime, uint32_t period, uint16_t line0, uint16_t line1,
+                            uint32_t sendTime, bool ascending);
+
+/**
+ * @brief Check whether the last GFX_flushAsync() has reached the display
+ * @return true if no flush is in progress
+ */
+bool GFX_isFlushDone();
+
+/**
+ * @brief Block until the last GFX_flushAsync() has reached the display
+ */
+void GFX_waitFlush();
+
+/**
+ * @brief Set a function to call each time an async flush completes
+ * @param cb Callback, or NULL to disable. Runs in DMA interrupt context.
+ */
+void GFX_setFlushCallback(void (*cb)(void));
+
 /**
  * @brief Update display (alias for GFX_flush)
  */
@@ -203,9 +652,21 @@ void GFX_Update();
 /**
  * @brief Scroll screen content up by n lines
  * @param n Number of lines to scroll
+ * @note With hardware scrolling enabled only the n new lines at the bottom are
+ *       cleared and sent; the rest moves when the panel scroll offset is
+ *       updated by the next GFX_flush() or GFX_Update().
  */
 void GFX_scrollUp(int n);
 
+/**
+ * @brief Use the panel's vertical scrolling for GFX_scrollUp()
+ * @param enable true to scroll in hardware, false to copy the framebuffer
+ * @return true if the requested mode is active. Hardware scrolling needs a
+ *         single RGB565 framebuffer and rotation 0 or 2.
+ * @note LCD_setRotation() switches back to software scrolling.
+ */
+bool GFX_setHardwareScroll(bool enable);
+
 // Utility Functions
 /**
  * @brief Get framebuffer width
@@ -243,4 +704,30 @@ void GFX_drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int1
  */
 void GFX_drawBitmapMask(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int16_t h, uint16_t color);
 
+/**
+ * @brief Draw an RGB565 image with constant opacity
+ * @param x Top-left X coordinate
+ * @param y Top-left Y coordinate
+ * @param bitmap RGB565 pixels, w per row
+ * @param w Width of the image
+ * @param h Height of the image
+ * @param alpha Opacity, 0 (invisible) to 255 (copied as is)
+ * @note Draws nothing into an indexed framebuffer, whose pixels are palette
+ *       indices rather than RGB565 colors. Drawing straight to the panel,
+ *       alpha above about half draws the image solid and the rest is skipped.
+ */
+void GFX_drawRGBBitmapAlpha(int16_t x, int16_t y, const uint16_t *bitmap, int16_t w, int16_t h, uint8_t alpha);
+
+/**
+ * @brief Draw a color through an 8-bit coverage mask (A8), e.g. anti-aliased glyphs or icons
+ * @param x Top-left X coordinate
+ * @param y Top-left Y coordinate
+ * @param mask Opacity of each pixel, 0 to 255, w bytes per row
+ * @param w Width of the mask
+ * @param h Height of the mask
+ * @param color 16-bit RGB565 color
+ * @note See GFX_drawLineAlpha() for modes without an RGB565 framebuffer.
+ */
+void GFX_drawAlphaMask(int16_t x, int16_t y, const uint8_t *mask, int16_t w, int16_t h, uint16_t color);
+
 #endif
\ No newline at end of file
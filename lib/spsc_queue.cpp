@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <string.h>
+#include "spsc_queue.h"
+
+#if PICO_ON_DEVICE
+#include "hardware/sync.h"
+// Sleep until the other core signals; the event latch means a signal sent
+// just before the wait is not lost
+#define SPSC_WAIT() __wfe()
+#define SPSC_SIGNAL() __sev()
+#else
+#include <thread>
+#define SPSC_WAIT() std::this_thread::yield()
+#define SPSC_SIGNAL() ((void)0)
+#endif
+
+bool SPSC_init(SPSC_Queue *q, uint32_t slotSize, uint32_t capacity)
+{
+    uint32_t n = 1;
+    while (n < capacity)
+        n <<= 1;
+
+    q->slots = static_cast<uint8_t *>(malloc(n * slotSize));
+    if (q->slots == NULL)
+        return false;
+    q->slotSize = slotSize;
+    q->mask = n - 1;
+    q->head.store(0, std::memory_order_relaxed);
+    q->tail.store(0, std::memory_order_relaxed);
+    return true;
+}
+
+void SPSC_free(SPSC_Queue *q)
+{
+    free(q->slots);
+    q->slots = NULL;
+}
+
+uint32_t SPSC_count(const SPSC_Queue *q)
+{
+    // Free-running counters, so the difference is right across wrap-around
+    return q->head.load(std::memory_order_acquire) - q->tail.load(std::memory_order_acquire);
+}
+
+static void *tryBeginPush(SPSC_Queue *q)
+{
+    uint32_t head = q->head.load(std::memory_order_relaxed);
+    if (head - q->tail.load(std::memory_order_acquire) > q->mask)
+        return NULL;
+    return q->slots + (head & q->mask) * q->slotSize;
+}
+
+void *SPSC_beginPush(SPSC_Queue *q)
+{
+    void *slot;
+    while ((slot = tryBeginPush(q)) == NULL)
+        SPSC_WAIT();
+    return slot;
+}
+
+void SPSC_endPush(SPSC_Queue *q)
+{
+    // Release: the slot contents become visible before the new head
+    q->head.store(q->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    SPSC_SIGNAL();
+}
+
+void SPSC_push(SPSC_Queue *q, const void *item)
+{
+    memcpy(SPSC_beginPush(q), item, q->slotSize);
+    SPSC_endPush(q);
+}
+
+bool SPSC_tryPush(SPSC_Queue *q, const void *item)
+{
+    void *slot = tryBeginPush(q);
+    if (slot == NULL)
+        return false;
+    memcpy(slot, item, q->slotSize);
+    SPSC_endPush(q);
+    return true;
+}
+
+static void *tryBeginPop(SPSC_Queue *q)
+{
+    uint32_t tail = q->tail.load(std::memory_order_relaxed);
+    if (q->head.load(std::memory_order_acquire) == tail)
+        return NULL;
+    return q->slots + (tail & q->mask) * q->slotSize;
+}
+
+void *SPSC_beginPop(SPSC_Queue *q)
+{
+    void *slot;
+    while ((slot = tryBeginPop(q)) == NULL)
+        SPSC_WAIT();
+    return slot;
+}
+
+void SPSC_endPop(SPSC_Queue *q)
+{
+    // Release: the slot has been read before the producer may reuse it
+    q->tail.store(q->tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    SPSC_SIGNAL();
+}
+
+void SPSC_pop(SPSC_Queue *q, void *item)
+{
+    memcpy(item, SPSC_beginPop(q), q->slotSize);
+    SPSC_endPop(q);
+}
+
+bool SPSC_tryPop(SPSC_Queue *q, void *item)
+{
+    void *slot = tryBeginPop(q);
+    if (slot == NULL)
+        return false;
+    memcpy(item, slot, q->slotSize);
+    SPSC_endPop(q);
+    return true;
+}
@@ -0,0 +1,111 @@
+/**
+ * @file spsc_queue.h
+ * @brief Lock-free single-producer single-consumer ring of fixed-size slots
+ * @date 2025
+ *
+ * One thread (or core) pushes and one pops; neither ever takes a lock. Each
+ * side only writes its own index, so plain atomic loads and stores are
+ * enough, which the Cortex-M0+ supports without exclusive access
+ * instructions. A full ring makes the producer wait rather than drop items.
+ *
+ * Depends only on the C++ standard library when built without the Pico SDK,
+ * so the same code can be exercised on a host with std::thread.
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+typedef struct
+{
+    uint8_t *slots;
+    uint32_t slotSize;
+    uint32_t mask;              ///< Capacity - 1; the capacity is a power of two
+    std::atomic<uint32_t> head; ///< Items pushed so far, written by the producer only
+    std::atomic<uint32_t> tail; ///< Items popped so far, written by the consumer only
+} SPSC_Queue;
+
+/**
+ * @brief Allocate the slots of a queue
+ * @param q Queue to initialise
+ * @param slotSize Size of one item in bytes
+ * @param capacity Number of slots, rounded up to a power of two
+ * @return true if the slots were allocated
+ */
+bool SPSC_init(SPSC_Queue *q, uint32_t slotSize, uint32_t capacity);
+
+/**
+ * @brief Free the slots of a queue
+ * @param q Queue, which neither side may be using
+ */
+void SPSC_free(SPSC_Queue *q);
+
+/**
+ * @brief Number of items pushed but not yet popped
+ * @param q Queue
+ * @return Item count, exact when called from either side
+ */
+uint32_t SPSC_count(const SPSC_Queue *q);
+
+/**
+ * @brief Get the next free slot to fill in place, waiting while the ring is full
+ * @param q Queue
+ * @return Slot of SPSC_Queue::slotSize bytes, published by SPSC_endPush()
+ * @note Producer side only.
+ */
+void *SPSC_beginPush(SPSC_Queue *q);
+
+/**
+ * @brief Publish the slot returned by SPSC_beginPush()
+ * @param q Queue
+ */
+void SPSC_endPush(SPSC_Queue *q);
+
+/**
+ * @brief Copy an item into the ring, waiting while it is full
+ * @param q Queue
+ * @param item SPSC_Queue::slotSize bytes to copy
+ */
+void SPSC_push(SPSC_Queue *q, const void *item);
+
+/**
+ * @brief Copy an item into the ring unless it is full
+ * @param q Queue
+ * @param item SPSC_Queue::slotSize bytes to copy
+ * @return false if the ring was full
+ */
+bool SPSC_tryPush(SPSC_Queue *q, const void *item);
+
+/**
+ * @brief Get the oldest item in place, waiting while the ring is empty
+ * @param q Queue
+ * @return Slot holding the item, valid until SPSC_endPop()
+ * @note Consumer side only.
+ */
+void *SPSC_beginPop(SPSC_Queue *q);
+
+/**
+ * @brief Release the slot returned by SPSC_beginPop() to the producer
+ * @param q Queue
+ */
+void SPSC_endPop(SPSC_Queue *q);
+
+/**
+ * @brief Copy out the oldest item, waiting while the ring is empty
+ * @param q Queue
+ * @param item Receives SPSC_Queue::slotSize bytes
+ */
+void SPSC_pop(SPSC_Queue *q, void *item);
+
+/**
+ * @brief Copy out the oldest item unless the ring is empty
+ * @param q Queue
+ * @param item Receives SPSC_Queue::slotSize bytes
+ * @return false if the ring was empty
+ */
+bool SPSC_tryPop(SPSC_Queue *q, void *item);
+
+#endif
@@ -9,6 +9,8 @@
 #include "pico/stdlib.h"
 #include "hardware/spi.h"
 #include "hardware/dma.h"
+#include "hardware/irq.h"
+#include <new>
 
 uint16_t _colstart = 0, _rowstart = 0, _colstart2 = 0, _rowstart2 = 0;
 
@@ -25,9 +27,11 @@ int16_t _ystart = 0; ///< Internal framebuffer Y offset
 
 uint8_t rotation;
 
-spi_inst_t *st7789_spi = spi_default;
+static bool st7789_ready = false;            ///< Init sequence has been sent
+
+static bool st7789_scrollOn = false; ///< VSCRDEF set up for the visible window
+static uint16_t st7789_scrollTop;    ///< Top fixed area of the scroll definition
 
-uint16_t st7789_pinCS = 17;
 uint16_t st7789_pinDC = 16;
 int16_t st7789_pinRST = -1;
 
@@ -36,6 +40,81 @@ uint16_t st7789_pinTX = PICO_DEFAULT_SPI_TX_PIN;
 
 // uint16_t st7789_pinRST;
 
+static uint8_t st7789_spiBits = 0;    ///< Current SPI frame size, 0 if unknown
+static int8_t st7789_dcState = -1;    ///< Current DC level, -1 if unknown
+static uint8_t st7789_colmod = ST7789_COLMOD_565; ///< Pixel format on the wire
+
+/** @brief RGB444 groups (4 pixels in 3 halfwords) per packed transfer */
+#define ST7789_PACK_GROUPS 128
+void initSPI();
+static void spiCommand(uint8_t cmd, const uint8_t *data, size_t len);
+static void spiWindow(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1);
+static void spiPixels(const uint16_t *pixels, uint32_t count, bool repeat, void (*done)(void *arg), void *arg);
+static bool spiBusy();
+
+static const LCD_Transport st7789_spiTransport = {initSPI, spiCommand, spiWindow, spiPixels, spiBusy};
+static const LCD_Transport *st7789_bus = &st7789_spiTransport;
+
+// File-scope state of the selected display. LCD_selectDisplay() saves it
+// into the outgoing LCD_Display and loads the incoming one's.
+#define ST7789_DISPLAY_STATE(X)                                                      \
+    X(_colstart) X(_rowstart) X(_colstart2) X(_rowstart2) X(_width) X(_height)       \
+    X(windowWidth) X(windowHeight) X(_xstart) X(_ystart) X(rotation) X(st7789_ready) \
+    X(st7789_scrollOn) X(st7789_scrollTop) X(st7789_pinDC) X(st7789_pinRST)          \
+    X(st7789_pinSCK) X(st7789_pinTX) X(st7789_spiBits) X(st7789_dcState)             \
+    X(st7789_colmod) X(st7789_bus)
+
+#define ST7789_SAVED_FIELD(v) decltype(::v) v;
+
+struct LCD_Display
+{
+    // Used by interrupt handlers and transfers in flight, so kept in place
+    spi_inst_t *spi = spi_default;
+    uint16_t pinCS = 17;
+    int16_t pinTE = -1;
+    int dmaChan = -1;                  ///< Pixel DMA channel, -1 until claimed
+    volatile uint32_t tePeriod = 16667; ///< Smoothed TE edge interval (us)
+    volatile uint64_t teTime;          ///< Time of the last TE edge (us)
+    void (*teCallback)(void);          ///< Called from the TE edge interrupt
+    bool selected;                     ///< Current CS state
+    uint8_t writeDepth;                ///< Nesting of LCD_beginWrite() calls
+    void (*writeCb)(void);             ///< Caller's callback for the pixel write in flight
+#ifdef USE_DMA
+    dma_channel_config dmaCfg;
+    volatile bool dmaBusy;             ///< Set while a pixel transfer owns the bus
+    void (*dmaDone)(void *arg);        ///< Called from the DMA IRQ when a write completes
+    void *dmaArg;
+#endif
+    uint16_t fillColor;                ///< Source of repeated fills, re-read by the transport
+    uint8_t initStep;                  ///< Stage of the init sequence in progress
+    uint8_t initLeft;                  ///< Init list commands still to send
+    const uint8_t *initPos;            ///< Next init list entry
+    volatile bool initBusy;            ///< Init sequence started but not finished
+    volatile bool frameBusy;           ///< LCD_beginFrame() holds the bus between parts
+    uint64_t initStart;                ///< When the init sequence started (us)
+    uint32_t initTime;                 ///< Time the last init sequence took (us)
+    uint16_t packBuf[2][ST7789_PACK_GROUPS * 3]; ///< One fills while the other is sent
+
+    // Copy of the file-scope state while another display is selected
+    ST7789_DISPLAY_STATE(ST7789_SAVED_FIELD)
+};
+
+static LCD_Display st7789_default;
+static LCD_Display *lcd = &st7789_default; ///< Selected display
+static LCD_Display *st7789_displays[LCD_MAX_DISPLAYS] = {&st7789_default};
+static uint8_t st7789_displayCount = 1;
+
+#define ST7789_SAVE(v) lcd->v = v;
+#define ST7789_LOAD(v) v = lcd->v;
+
+// Whether two displays talk over the same bus, so their transfers cannot overlap
+static bool ST7789_SharesBus(const LCD_Display *a, const LCD_Display *b)
+{
+    const LCD_Transport *busA = a == lcd ? st7789_bus : a->st7789_bus;
+    const LCD_Transport *busB = b == lcd ? st7789_bus : b->st7789_bus;
+    return busA == busB && (busA != &st7789_spiTransport || a->spi == b->spi);
+}
+
 static const uint8_t generic_st7789[] = { // Init commands for 7789 screens
     9,                                    //  9 commands in list:
     ST77XX_SWRESET, ST_CMD_DELAY,         //  1: Software reset, no args, w/delay
@@ -65,19 +144,38 @@ static const uint8_t generic_st7789[] = { // Init commands for 7789 screens
     10};                         //    10 ms delay
 
 #ifdef USE_DMA
-uint dma_tx;
-dma_channel_config dma_cfg;
 void waitForDMA()
 {
+    while (lcd->dmaBusy)
+        tight_loop_contents();
+}
+
+// Shared by all displays; each has its own channel
+static void dmaIrqHandler()
+{
+    for (uint8_t i = 0; i < st7789_displayCount; i++)
+    {
+        LCD_Display *d = st7789_displays[i];
+        if (d->dmaChan < 0 || !dma_channel_get_irq0_status(d->dmaChan))
+            continue;
+        dma_channel_acknowledge_irq0(d->dmaChan);
 
-    dma_channel_wait_for_finish_blocking(dma_tx);
+        // DMA is done once the last halfword enters the TX FIFO; let it shift out
+        // before releasing CS or the final pixels are lost.
+        while (spi_is_busy(d->spi))
+            tight_loop_contents();
+
+        d->dmaBusy = false;
+        if (d->dmaDone)
+            d->dmaDone(d->dmaArg);
+    }
 }
 #endif
 
 void LCD_setPins(uint16_t dc, uint16_t cs, int16_t rst, uint16_t sck, uint16_t tx)
 {
     st7789_pinDC = dc;
-    st7789_pinCS = cs;
+    lcd->pinCS = cs;
     st7789_pinRST = rst;
     st7789_pinSCK = sck;
     st7789_pinTX = tx;
@@ -85,124 +183,233 @@ void LCD_setPins(uint16_t dc, uint16_t cs, int16_t rst, uint16_t sck, uint16_t t
 
 void LCD_setSPIperiph(spi_inst_t *s)
 {
-    st7789_spi = s;
+    lcd->spi = s;
+    st7789_spiBits = 0;
+}
+
+void ST7789_InitPins()
+{
+    gpio_init(lcd->pinCS);
+    gpio_set_dir(lcd->pinCS, GPIO_OUT);
+    gpio_put(lcd->pinCS, 1);
+    lcd->selected = false;
+
+    if (st7789_pinRST != -1)
+    {
+        gpio_init(st7789_pinRST);
+        gpio_set_dir(st7789_pinRST, GPIO_OUT);
+        gpio_put(st7789_pinRST, 1);
+    }
 }
 
 void initSPI()
 {
-    spi_init(st7789_spi, 1000 * 40000);
-    spi_set_format(st7789_spi, 16, SPI_CPOL_1, SPI_CPHA_1, SPI_MSB_FIRST);
+    spi_init(lcd->spi, 1000 * 40000);
+    spi_set_format(lcd->spi, 16, SPI_CPOL_1, SPI_CPHA_1, SPI_MSB_FIRST);
+    st7789_spiBits = 16;
     gpio_set_function(st7789_pinSCK, GPIO_FUNC_SPI);
     gpio_set_function(st7789_pinTX, GPIO_FUNC_SPI);
 
-    gpio_init(st7789_pinCS);
-    gpio_set_dir(st7789_pinCS, GPIO_OUT);
-    gpio_put(st7789_pinCS, 1);
-
     gpio_init(st7789_pinDC);
     gpio_set_dir(st7789_pinDC, GPIO_OUT);
     gpio_put(st7789_pinDC, 1);
+    st7789_dcState = 1;
 
-    if (st7789_pinRST != -1)
+#ifdef USE_DMA
+    static bool irqAdded = false;
+    if (lcd->dmaChan < 0)
     {
-        gpio_init(st7789_pinRST);
-        gpio_set_dir(st7789_pinRST, GPIO_OUT);
-        gpio_put(st7789_pinRST, 1);
+        lcd->dmaChan = dma_claim_unused_channel(true);
+        dma_channel_set_irq0_enabled(lcd->dmaChan, true);
+    }
+    lcd->dmaCfg = dma_channel_get_default_config(lcd->dmaChan);
+    channel_config_set_transfer_data_size(&lcd->dmaCfg, DMA_SIZE_16);
+    channel_config_set_dreq(&lcd->dmaCfg, spi_get_dreq(lcd->spi, true));
+    if (!irqAdded)
+    {
+        irq_add_shared_handler(DMA_IRQ_0, dmaIrqHandler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(DMA_IRQ_0, true);
+        irqAdded = true;
     }
-
-#ifdef USE_DMA
-    dma_tx = dma_claim_unused_channel(true);
-    dma_cfg = dma_channel_get_default_config(dma_tx);
-    channel_config_set_transfer_data_size(&dma_cfg, DMA_SIZE_16);
-    channel_config_set_dreq(&dma_cfg, spi_get_dreq(st7789_spi, true));
 #endif
 }
 
-void ST7789_Reset()
+/** @brief Stages of the init sequence */
+enum
 {
-    if (st7789_pinRST != -1)
+    ST7789_INIT_RESET, ///< RST held low
+    ST7789_INIT_LIST,  ///< Sending generic_st7789
+    ST7789_INIT_COLMOD ///< Waiting for a pixel format change to settle
+};
+
+void ST7789_Select()
+{
+    if (!lcd->selected)
     {
-        gpio_put(st7789_pinRST, 0);
-        sleep_ms(5);
-        gpio_put(st7789_pinRST, 1);
+        lcd->selected = true; // before CS, so an init alarm never sees a low CS unmarked
+        gpio_put(lcd->pinCS, 0);
     }
 }
 
-void ST7789_Select()
+static void ST7789_Release(LCD_Display *d)
 {
-    gpio_put(st7789_pinCS, 0);
+    // Inside LCD_beginWrite()/LCD_endWrite() CS stays asserted
+    if (d->selected && d->writeDepth == 0)
+    {
+        gpio_put(d->pinCS, 1);
+        d->selected = false;
+    }
 }
 
 void ST7789_DeSelect()
 {
-    gpio_put(st7789_pinCS, 1);
+    ST7789_Release(lcd);
 }
 
 void ST7789_RegCommand()
 {
-    gpio_put(st7789_pinDC, 0);
+    if (st7789_dcState != 0)
+    {
+        gpio_put(st7789_pinDC, 0);
+        st7789_dcState = 0;
+    }
 }
 
 void ST7789_RegData()
 {
-    gpio_put(st7789_pinDC, 1);
+    if (st7789_dcState != 1)
+    {
+        gpio_put(st7789_pinDC, 1);
+        st7789_dcState = 1;
+    }
+}
+
+void ST7789_SetFrameSize(uint8_t bits)
+{
+    if (st7789_spiBits != bits)
+    {
+        spi_set_format(lcd->spi, bits, SPI_CPOL_1, SPI_CPHA_1, SPI_MSB_FIRST);
+        st7789_spiBits = bits;
+    }
 }
 
 void ST7789_WriteCommand(uint8_t cmd)
 {
     ST7789_RegCommand();
-    spi_set_format(st7789_spi, 8, SPI_CPOL_1, SPI_CPHA_1, SPI_MSB_FIRST);
-    spi_write_blocking(st7789_spi, &cmd, sizeof(cmd));
+    ST7789_SetFrameSize(8);
+    spi_write_blocking(lcd->spi, &cmd, sizeof(cmd));
 }
 
 void ST7789_WriteData(const uint8_t *buff, size_t buff_size)
 {
     ST7789_RegData();
-    spi_set_format(st7789_spi, 8, SPI_CPOL_1, SPI_CPHA_1, SPI_MSB_FIRST);
-    spi_write_blocking(st7789_spi, buff, buff_size);
+    ST7789_SetFrameSize(8);
+    spi_write_blocking(lcd->spi, buff, buff_size);
 }
 
-void ST7789_SendCommand(uint8_t commandByte, const uint8_t *dataBytes,
-                        uint8_t numDataBytes)
+static void spiCommand(uint8_t cmd, const uint8_t *data, size_t len)
 {
-    ST7789_Select();
-
-    ST7789_WriteCommand(commandByte);
-    ST7789_WriteData(dataBytes, numDataBytes);
-
-    ST7789_DeSelect();
+    ST7789_WriteCommand(cmd);
+    if (len)
+        ST7789_WriteData(data, len);
 }
 
-void ST7789_displayInit(const uint8_t *addr)
+static void spiWindow(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
 {
+    // Everything goes out in 16-bit frames so the SPI format does not change
+    // between the window and the pixel data. The high byte of each command
+    // frame is a NOP, which the controller ignores.
+    uint16_t caset[2] = {x0, x1};
+    uint16_t raset[2] = {y0, y1};
+    uint16_t cmd;
 
-    uint8_t numCommands, cmd, numArgs;
-    uint16_t ms;
+    ST7789_SetFrameSize(16);
 
-    numCommands = *(addr++); // Number of commands to follow
-    while (numCommands--)
-    {                                // For each command...
-        cmd = *(addr++);             // Read command
-        numArgs = *(addr++);         // Number of args to follow
-        ms = numArgs & ST_CMD_DELAY; // If hibit set, delay follows args
-        numArgs &= ~ST_CMD_DELAY;    // Mask out delay bit
-        ST7789_SendCommand(cmd, addr, numArgs);
-        addr += numArgs;
+    cmd = ST77XX_CASET;
+    ST7789_RegCommand();
+    spi_write16_blocking(lcd->spi, &cmd, 1);
+    ST7789_RegData();
+    spi_write16_blocking(lcd->spi, caset, 2);
 
-        if (ms)
+    // row address set
+    cmd = ST77XX_RASET;
+    ST7789_RegCommand();
+    spi_write16_blocking(lcd->spi, &cmd, 1);
+    ST7789_RegData();
+    spi_write16_blocking(lcd->spi, raset, 2);
+
+    // write to RAM
+    cmd = ST77XX_RAMWR;
+    ST7789_RegCommand();
+    spi_write16_blocking(lcd->spi, &cmd, 1);
+}
+
+static void spiPixels(const uint16_t *pixels, uint32_t count, bool repeat, void (*done)(void *arg), void *arg)
+{
+    ST7789_RegData();
+    ST7789_SetFrameSize(16);
+#ifdef USE_DMA
+    dma_channel_config cfg = lcd->dmaCfg;
+    channel_config_set_read_increment(&cfg, !repeat);
+    lcd->dmaDone = done;
+    lcd->dmaArg = arg;
+    lcd->dmaBusy = true;
+    dma_channel_configure(lcd->dmaChan, &cfg,
+                          &spi_get_hw(lcd->spi)->dr,   // write address
+                          pixels,                      // read address
+                          count,                       // element count (each element is of size transfer_data_size)
+                          true);                       // start asap
+#else
+    if (repeat)
+    {
+        uint16_t line[32];
+        for (uint8_t i = 0; i < 32; i++)
+            line[i] = *pixels;
+        while (count)
         {
-            ms = *(addr++); // Read post-command delay time (ms)
-            if (ms == 255)
-                ms = 500; // If 255, delay for 500 ms
-            sleep_ms(ms);
+            uint32_t chunk = count < 32 ? count : 32;
+            spi_write16_blocking(lcd->spi, line, chunk);
+            count -= chunk;
         }
     }
+    else
+        spi_write16_blocking(lcd->spi, pixels, count);
+    if (done)
+        done(arg);
+#endif
+}
+
+static bool spiBusy()
+{
+#ifdef USE_DMA
+    return lcd->dmaBusy;
+#else
+    return false;
+#endif
+}
+
+void ST7789_SendCommand(uint8_t commandByte, const uint8_t *dataBytes,
+                        uint8_t numDataBytes)
+{
+    LCD_waitWrite();
+    ST7789_Select();
+
+    st7789_bus->command(commandByte, dataBytes, numDataBytes);
+
+    ST7789_DeSelect();
 }
 
 void LCD_setRotation(uint8_t m)
 {
     uint8_t madctl = 0;
 
+    // A frame in flight is sent with the current geometry
+    LCD_waitWrite();
+
+    // The scroll definition is tied to the old orientation
+    if (st7789_scrollOn)
+        LCD_disableVerticalScroll();
+
     rotation = m & 3; // can't be higher than 3
 
     switch (rotation)
@@ -240,10 +447,239 @@ void LCD_setRotation(uint8_t m)
     ST7789_SendCommand(ST77XX_MADCTL, &madctl, 1);
 }
 
-void LCD_initDisplay(uint16_t width, uint16_t height)
+// Shared by the TE pins of all displays
+static void teIrqHandler()
+{
+    for (uint8_t i = 0; i < st7789_displayCount; i++)
+    {
+        LCD_Display *d = st7789_displays[i];
+        if (d->pinTE == -1 || !(gpio_get_irq_event_mask(d->pinTE) & GPIO_IRQ_EDGE_RISE))
+            continue;
+        gpio_acknowledge_irq(d->pinTE, GPIO_IRQ_EDGE_RISE);
+
+        uint64_t now = time_us_64();
+        uint32_t interval = (uint32_t)(now - d->teTime);
+        if (interval > 5000 && interval < 50000) // ignore the first and any missed edges
+            d->tePeriod = (d->tePeriod * 3 + interval) / 4;
+        d->teTime = now;
+
+        if (d->teCallback)
+            d->teCallback();
+    }
+}
+
+static void ST7789_EnableTE()
+{
+    uint8_t mode = 0x00; // TE pulses at V-blank only
+    ST7789_SendCommand(ST77XX_TEON, &mode, 1);
+}
+
+void LCD_setTEPin(int16_t te)
+{
+    if (lcd->pinTE != -1)
+        gpio_set_irq_enabled(lcd->pinTE, GPIO_IRQ_EDGE_RISE, false);
+
+    lcd->pinTE = te;
+    if (te == -1)
+    {
+        if (st7789_ready)
+            ST7789_SendCommand(ST77XX_TEOFF, NULL, 0);
+        return;
+    }
+
+    gpio_init(te);
+    gpio_set_dir(te, GPIO_IN);
+    gpio_add_raw_irq_handler(te, teIrqHandler);
+    gpio_set_irq_enabled(te, GPIO_IRQ_EDGE_RISE, true);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+
+    if (st7789_ready)
+        ST7789_EnableTE(); // otherwise sent at the end of LCD_initDisplay()
+}
+
+bool LCD_hasTE()
+{
+    return lcd->pinTE != -1;
+}
+
+void LCD_setTECallback(void (*cb)(void))
+{
+    lcd->teCallback = cb;
+}
+
+uint64_t LCD_getTETime()
+{
+    return lcd->teTime;
+}
+
+uint32_t LCD_getTEPeriod()
+{
+    return lcd->tePeriod;
+}
+
+static void ST7789_SendScrollDef(uint16_t top, uint16_t area, uint16_t bottom)
+{
+    uint8_t def[6] = {(uint8_t)(top >> 8), (uint8_t)top,
+                      (uint8_t)(area >> 8), (uint8_t)area,
+                      (uint8_t)(bottom >> 8), (uint8_t)bottom};
+    ST7789_SendCommand(ST77XX_VSCRDEF, def, sizeof(def));
+}
+
+static void ST7789_SendScrollStart(uint16_t row)
+{
+    uint8_t start[2] = {(uint8_t)(row >> 8), (uint8_t)row};
+    ST7789_SendCommand(ST77XX_VSCSAD, start, sizeof(start));
+}
+
+bool LCD_enableVerticalScroll()
+{
+    uint16_t bottom;
+
+    switch (rotation)
+    {
+    case 2: // rows run top to bottom in frame memory
+        st7789_scrollTop = _ystart;
+        bottom = ST7789_RAM_ROWS - _ystart - _height;
+        break;
+    case 0: // MY set: the screen top is the high end of frame memory
+        st7789_scrollTop = ST7789_RAM_ROWS - _ystart - _height;
+        bottom = _ystart;
+        break;
+    default: // MV set: panel rows are screen columns
+        return false;
+    }
+
+    ST7789_SendScrollDef(st7789_scrollTop, _height, bottom);
+    st7789_scrollOn = true;
+    LCD_setScrollOffset(0);
+    return true;
+}
+
+void LCD_disableVerticalScroll()
+{
+    ST7789_SendScrollDef(0, ST7789_RAM_ROWS, 0);
+    ST7789_SendScrollStart(0);
+    st7789_scrollOn = false;
+}
+
+bool LCD_isVerticalScrollEnabled()
+{
+    return st7789_scrollOn;
+}
+
+void LCD_setScrollOffset(uint16_t lines)
+{
+    if (!st7789_scrollOn)
+        return;
+
+    lines %= _height;
+    // With MY set the panel scans the window bottom-up, so scrolling the
+    // content up moves the start address down.
+    if (rotation == 0 && lines)
+        lines = _height - lines;
+    ST7789_SendScrollStart(st7789_scrollTop + lines);
+}
+
+// Send init commands to the selected display up to the next delay. Bus
+// operations wait while initBusy is set, so the commands go to the bus directly.
+// Returns the delay in ms, or 0 once the panel is ready.
+static uint32_t ST7789_InitStep()
+{
+    switch (lcd->initStep)
+    {
+    case ST7789_INIT_RESET:
+        gpio_put(st7789_pinRST, 1);
+        lcd->initStep = ST7789_INIT_LIST;
+        // fall through
+    case ST7789_INIT_LIST:
+        while (lcd->initLeft > 0)
+        {
+            const uint8_t *addr = lcd->initPos;
+            uint8_t cmd = *(addr++);              // Read command
+            uint8_t numArgs = *(addr++);          // Number of args to follow
+            uint32_t ms = numArgs & ST_CMD_DELAY; // If hibit set, delay follows args
+            numArgs &= ~ST_CMD_DELAY;             // Mask out delay bit
+            ST7789_Select();
+            st7789_bus->command(cmd, addr, numArgs);
+            ST7789_DeSelect();
+            addr += numArgs;
+            if (ms)
+            {
+                ms = *(addr++); // Read post-command delay time (ms)
+                if (ms == 255)
+                    ms = 500; // If 255, delay for 500 ms
+            }
+            lcd->initPos = addr;
+            lcd->initLeft--;
+            if (ms)
+                return ms;
+        }
+
+        lcd->initStep = ST7789_INIT_COLMOD;
+        if (st7789_colmod != ST7789_COLMOD_565) // the init list selects 16-bit
+        {
+            ST7789_Select();
+            st7789_bus->command(ST77XX_COLMOD, &st7789_colmod, 1);
+            ST7789_DeSelect();
+            return 10;
+        }
+        // fall through
+    default:
+        break;
+    }
+
+    lcd->initBusy = false;
+    LCD_setRotation(2);
+    st7789_ready = true;
+    if (lcd->pinTE != -1)
+        ST7789_EnableTE();
+    lcd->initTime = (uint32_t)(time_us_64() - lcd->initStart);
+    return 0;
+}
+
+static int64_t ST7789_InitAlarm(alarm_id_t, void *user_data)
 {
+    LCD_Display *d = static_cast<LCD_Display *>(user_data);
+    if (d == lcd)
+        return -(int64_t)ST7789_InitStep() * 1000; // 0 stops the alarm; negative counts from now
 
-    initSPI();
+    // Another display is selected. If it is in the middle of a command or
+    // write on the same bus, try again shortly.
+    bool shared = ST7789_SharesBus(d, lcd);
+    if (shared && (lcd->selected || st7789_bus->busy()))
+        return -100;
+
+    // Run the step on d's state, then restore the selected display's. The
+    // interrupted code sees its own variables unchanged.
+    LCD_Display *selected = lcd;
+    ST7789_DISPLAY_STATE(ST7789_SAVE)
+    lcd = d;
+    ST7789_DISPLAY_STATE(ST7789_LOAD)
+    if (shared)
+    {
+        st7789_spiBits = 0; // the selected panel may have changed the bus setup
+        st7789_dcState = -1;
+    }
+    uint32_t ms = ST7789_InitStep();
+    ST7789_DISPLAY_STATE(ST7789_SAVE)
+    lcd = selected;
+    ST7789_DISPLAY_STATE(ST7789_LOAD)
+    if (shared)
+    {
+        st7789_spiBits = 0;
+        st7789_dcState = -1;
+    }
+    return -(int64_t)ms * 1000;
+}
+
+// Set up pins, bus and geometry and start the reset. Returns the time in ms
+// until ST7789_InitStep() is due.
+static uint32_t ST7789_StartInit(uint16_t width, uint16_t height, uint8_t colorMode)
+{
+    LCD_waitWrite(); // also lets a previous init finish
+    lcd->initStart = time_us_64();
+    ST7789_InitPins();
+    st7789_bus->init();
 
     if (width == 172 && height == 320)
     {
@@ -284,10 +720,109 @@ void LCD_initDisplay(uint16_t width, uint16_t height)
 
     windowWidth = width;
     windowHeight = height;
-    ST7789_Select();
-    ST7789_Reset();
-    ST7789_displayInit(generic_st7789);
-    LCD_setRotation(2);
+    _width = width; // as LCD_setRotation(2) leaves them, so drawing can start early
+    _height = height;
+    st7789_scrollOn = false; // SWRESET clears the scroll definition
+    st7789_ready = false;
+    st7789_colmod = colorMode == ST7789_COLMOD_444 ? ST7789_COLMOD_444 : ST7789_COLMOD_565;
+    lcd->initPos = generic_st7789 + 1;
+    lcd->initLeft = generic_st7789[0];
+    lcd->initBusy = true;
+
+    if (st7789_pinRST == -1)
+    {
+        lcd->initStep = ST7789_INIT_LIST;
+        return ST7789_InitStep();
+    }
+    gpio_put(st7789_pinRST, 0);
+    lcd->initStep = ST7789_INIT_RESET;
+    return 5;
+}
+
+void LCD_initDisplay(uint16_t width, uint16_t height, uint8_t colorMode)
+{
+    for (uint32_t ms = ST7789_StartInit(width, height, colorMode); ms != 0; ms = ST7789_InitStep())
+        sleep_ms(ms);
+}
+
+void LCD_initDisplayAsync(uint16_t width, uint16_t height, uint8_t colorMode)
+{
+    uint32_t ms = ST7789_StartInit(width, height, colorMode);
+    if (ms != 0 && add_alarm_in_ms(ms, ST7789_InitAlarm, lcd, true) < 0)
+    {
+        // No alarm slot free: finish the sequence here instead
+        sleep_ms(ms);
+        while ((ms = ST7789_InitStep()) != 0)
+            sleep_ms(ms);
+    }
+}
+
+bool LCD_isInitDone()
+{
+    return !lcd->initBusy;
+}
+
+uint32_t LCD_getInitTime()
+{
+    return lcd->initTime;
+}
+
+uint8_t LCD_getColorMode()
+{
+    return st7789_colmod;
+}
+
+void LCD_setTransport(const LCD_Transport *transport)
+{
+    st7789_bus = transport ? transport : &st7789_spiTransport;
+}
+
+LCD_Display *LCD_createDisplay()
+{
+    if (st7789_displayCount == LCD_MAX_DISPLAYS)
+        return NULL;
+    LCD_Display *d = new (std::nothrow) LCD_Display();
+    if (d == NULL)
+        return NULL;
+
+    // Defaults of the file-scope variables
+    d->st7789_pinDC = 16;
+    d->st7789_pinRST = -1;
+    d->st7789_pinSCK = PICO_DEFAULT_SPI_SCK_PIN;
+    d->st7789_pinTX = PICO_DEFAULT_SPI_TX_PIN;
+    d->st7789_dcState = -1;
+    d->st7789_colmod = ST7789_COLMOD_565;
+    d->st7789_bus = &st7789_spiTransport;
+    st7789_displays[st7789_displayCount++] = d;
+    return d;
+}
+
+void LCD_selectDisplay(LCD_Display *display)
+{
+    if (display == NULL)
+        display = &st7789_default;
+    if (display == lcd)
+        return;
+
+    // Panels sharing a bus cannot overlap: finish the outgoing write, which
+    // also releases its CS
+    bool shared = ST7789_SharesBus(display, lcd);
+    if (shared)
+        LCD_waitWrite();
+
+    // An init alarm must not see a half-loaded display
+    uint32_t irq = save_and_disable_interrupts();
+    ST7789_DISPLAY_STATE(ST7789_SAVE)
+    lcd = display;
+    ST7789_DISPLAY_STATE(ST7789_LOAD)
+    restore_interrupts(irq);
+    if (shared)
+        st7789_spiBits = 0; // the other panel may have changed the frame size
+}
+
+LCD_Display *LCD_getDisplay()
+{
+    return lcd;
 }
 
 void LCD_setAddrWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
@@ -296,50 +831,269 @@ void LCD_setAddrWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
     x += _xstart;
     y += _ystart;
 
-    uint32_t xa = ((uint32_t)x << 16) | (x + w - 1);
-    uint32_t ya = ((uint32_t)y << 16) | (y + h - 1);
+    st7789_bus->window(x, y, x + w - 1, y + h - 1);
+}
 
-    xa = __builtin_bswap32(xa);
-    ya = __builtin_bswap32(ya);
+// Runs when the last pixel of a write has left the bus; arg is its display,
+// which need not be the selected one by then
+static void ST7789_WriteDone(void *arg)
+{
+    LCD_Display *d = static_cast<LCD_Display *>(arg);
+    ST7789_Release(d);
+    if (d->writeCb)
+        d->writeCb();
+}
 
-    ST7789_WriteCommand(ST77XX_CASET);
-    ST7789_WriteData((uint8_t *)&xa, sizeof(xa));
+// Wait for the bus itself, ignoring a frame in progress. Only the frame's own
+// parts and the internal steps of a write may use this.
+static void ST7789_WaitBus()
+{
+    while (lcd->initBusy || st7789_bus->busy())
+        tight_loop_contents();
+}
 
-    // row address set
-    ST7789_WriteCommand(ST77XX_RASET);
-    ST7789_WriteData((uint8_t *)&ya, sizeof(ya));
+// Send pixels to an open RAMWR window. Only the last part of a write passes
+// last = true; CS is released and done is called once it has been sent.
+static void ST7789_WritePixels(const uint16_t *pixels, uint32_t count, bool repeat, bool last, void (*done)(void))
+{
+    ST7789_WaitBus();
+    lcd->writeCb = done;
+    st7789_bus->pixels(pixels, count, repeat, last ? ST7789_WriteDone : NULL, lcd);
+}
 
-    // write to RAM
-    ST7789_WriteCommand(ST77XX_RAMWR);
+void LCD_packRGB444(const uint16_t *src, uint16_t *dst, uint32_t groups)
+{
+    while (groups--)
+    {
+        // Two pixels per word: keep the top 4 bits of each RGB565 channel
+        uint32_t q0 = src[0] | (uint32_t)src[1] << 16;
+        uint32_t q1 = src[2] | (uint32_t)src[3] << 16;
+        q0 = ((q0 >> 4) & 0x0F000F00) | ((q0 >> 3) & 0x00F000F0) | ((q0 >> 1) & 0x000F000F);
+        q1 = ((q1 >> 4) & 0x0F000F00) | ((q1 >> 3) & 0x00F000F0) | ((q1 >> 1) & 0x000F000F);
+
+        // 4 x 12 bits -> 3 x 16 bits, first pixel in the high bits
+        dst[0] = (uint16_t)(q0 << 4) | (uint16_t)(q0 >> 24);
+        dst[1] = (uint16_t)((q0 >> 8) & 0xFF00) | (uint16_t)((q1 & 0xFFF) >> 4);
+        dst[2] = (uint16_t)(q1 << 12) | (uint16_t)(q1 >> 16);
+        src += 4;
+        dst += 3;
+    }
 }
 
-void LCD_WriteBitmap(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t *bitmap)
+// Stream a w x h image to an open RAMWR window in RGB444, packing into one
+// buffer while the other is sent. The panel takes pixels in pairs, so the
+// last group is always sent whole, padded with the image's own first pixels:
+// padding wraps round to the start of the window and rewrites it unchanged.
+static void ST7789_WriteRGB444(const uint16_t *bitmap, uint16_t w, uint16_t h, uint16_t stride, void (*done)(void))
+{
+    uint32_t n = (uint32_t)w * h;
+    uint16_t group[4];
+    uint8_t pending = 0;
+    uint16_t len = 0;
+    uint8_t buf = 0;
+
+    for (uint16_t row = 0; row < h; row++, bitmap += stride)
+    {
+        uint16_t i = 0;
+        while (i < w)
+        {
+            if (len == ST7789_PACK_GROUPS * 3)
+            {
+                ST7789_WritePixels(lcd->packBuf[buf], len, false, false, NULL);
+                buf ^= 1;
+                len = 0;
+            }
+
+            if (pending == 0 && w - i >= 4)
+            {
+                uint16_t groups = (w - i) / 4;
+                uint16_t room = ST7789_PACK_GROUPS - len / 3;
+                if (groups > room)
+                    groups = room;
+                LCD_packRGB444(bitmap + i, lcd->packBuf[buf] + len, groups);
+                i += groups * 4;
+                len += groups * 3;
+                continue;
+            }
+
+            // A group split across rows
+            group[pending++] = bitmap[i++];
+            if (pending == 4)
+            {
+                LCD_packRGB444(group, lcd->packBuf[buf] + len, 1);
+                len += 3;
+                pending = 0;
+            }
+        }
+    }
+
+    if (pending)
+    {
+        if (len == ST7789_PACK_GROUPS * 3)
+        {
+            ST7789_WritePixels(lcd->packBuf[buf], len, false, false, NULL);
+            buf ^= 1;
+            len = 0;
+        }
+        bitmap -= (uint32_t)h * stride;
+        for (uint8_t k = 0; pending + k < 4; k++)
+        {
+            uint32_t idx = k % n;
+            group[pending + k] = bitmap[(idx / w) * stride + idx % w];
+        }
+        LCD_packRGB444(group, lcd->packBuf[buf] + len, 1);
+        len += 3;
+    }
+    ST7789_WritePixels(lcd->packBuf[buf], len, false, true, done);
+}
+
+void LCD_beginWrite()
+{
+    LCD_waitWrite();
+    lcd->writeDepth++;
+    ST7789_Select();
+}
+
+void LCD_endWrite()
+{
+    LCD_waitWrite();
+    if (lcd->writeDepth > 0 && --lcd->writeDepth == 0)
+        ST7789_DeSelect();
+}
+
+static void ST7789_WriteBitmap(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *bitmap,
+                               void (*done)(void))
 {
     ST7789_Select();
     LCD_setAddrWindow(x, y, w, h); // Clipped area
-    ST7789_RegData();
-    spi_set_format(st7789_spi, 16, SPI_CPOL_1, SPI_CPHA_1, SPI_MSB_FIRST);
+    if (st7789_colmod == ST7789_COLMOD_444)
+        ST7789_WriteRGB444(bitmap, w, h, w, done);
+    else
+        ST7789_WritePixels(bitmap, (uint32_t)w * h, false, true, done);
+}
+
+void LCD_WriteBitmapAsync(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *bitmap, void (*done)(void))
+{
+    LCD_waitWrite();
+    ST7789_WriteBitmap(x, y, w, h, bitmap, done);
+}
+
+void LCD_beginFrame()
+{
+    LCD_waitWrite();
+    lcd->frameBusy = true;
+}
+
+void LCD_endFrame()
+{
+    lcd->frameBusy = false;
+}
+
+void LCD_WriteFramePart(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *bitmap,
+                        void (*done)(void))
+{
+    ST7789_WaitBus();
+    ST7789_WriteBitmap(x, y, w, h, bitmap, done);
+}
+
+bool LCD_isWriteDone()
+{
+    return !lcd->initBusy && !lcd->frameBusy && !st7789_bus->busy();
+}
+
+bool LCD_isDisplayIdle(LCD_Display *display)
+{
+    if (display == NULL)
+        display = &st7789_default;
+    if (display == lcd || ST7789_SharesBus(display, lcd))
+        return LCD_isWriteDone();
+    if (display->initBusy || display->frameBusy)
+        return false;
+    if (display->st7789_bus != &st7789_spiTransport)
+        return !display->st7789_bus->busy();
 #ifdef USE_DMA
-    dma_channel_configure(dma_tx, &dma_cfg,
-                          &spi_get_hw(st7789_spi)->dr, // write address
-                          bitmap,                      // read address
-                          w * h,                       // element count (each element is of size transfer_data_size)
-                          true);                       // start asap
-    waitForDMA();
+    return !display->dmaBusy;
 #else
-
-    spi_write16_blocking(st7789_spi, bitmap, w * h);
+    return true;
 #endif
+}
 
-    ST7789_DeSelect();
+void LCD_waitWrite()
+{
+    // The init sequence owns the bus until the panel is ready, and a frame
+    // sent in parts owns it between the parts
+    while (lcd->initBusy || lcd->frameBusy || st7789_bus->busy())
+        tight_loop_contents();
+}
+
+void LCD_WriteBitmap(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t *bitmap)
+{
+    LCD_WriteBitmapAsync(x, y, w, h, bitmap, NULL);
+    LCD_waitWrite();
+}
+
+void LCD_WriteBitmapStride(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *bitmap, uint16_t stride)
+{
+    if (stride == w)
+    {
+        LCD_WriteBitmapAsync(x, y, w, h, bitmap, NULL);
+        LCD_waitWrite();
+        return;
+    }
+
+    LCD_waitWrite();
+    ST7789_Select();
+    LCD_setAddrWindow(x, y, w, h);
+    if (st7789_colmod == ST7789_COLMOD_444)
+        ST7789_WriteRGB444(bitmap, w, h, stride, NULL);
+    else
+    {
+        for (uint16_t row = 0; row < h; row++, bitmap += stride)
+            ST7789_WritePixels(bitmap, w, false, row == h - 1, NULL);
+    }
+    LCD_waitWrite();
+}
+
+void LCD_fillRect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color)
+{
+    if (w == 0 || h == 0)
+        return;
+
+    LCD_waitWrite();
+    ST7789_Select();
+    LCD_setAddrWindow(x, y, w, h);
+    if (st7789_colmod == ST7789_COLMOD_444)
+    {
+        // Four pixels of one color pack to the same three halfwords, and any
+        // padding is that color too
+        uint16_t group[4] = {color, color, color, color};
+        uint16_t *pattern = lcd->packBuf[0];
+        for (uint16_t i = 0; i < ST7789_PACK_GROUPS; i++)
+            LCD_packRGB444(group, pattern + i * 3, 1);
+
+        uint32_t len = ((uint32_t)w * h + 3) / 4 * 3;
+        while (len > ST7789_PACK_GROUPS * 3)
+        {
+            ST7789_WritePixels(pattern, ST7789_PACK_GROUPS * 3, false, false, NULL);
+            len -= ST7789_PACK_GROUPS * 3;
+        }
+        ST7789_WritePixels(pattern, len, false, true, NULL);
+        return;
+    }
+
+    // The transport may keep re-reading the color after this returns
+    lcd->fillColor = color;
+    ST7789_WritePixels(&lcd->fillColor, (uint32_t)w * h, true, true, NULL);
 }
 
 void LCD_WritePixel(int x, int y, uint16_t col)
 {
+    LCD_waitWrite();
     ST7789_Select();
     LCD_setAddrWindow(x, y, 1, 1); // Clipped area
-    ST7789_RegData();
-    spi_set_format(st7789_spi, 16, SPI_CPOL_1, SPI_CPHA_1, SPI_MSB_FIRST);
-    spi_write16_blocking(st7789_spi, &col, 1);
-    ST7789_DeSelect();
-}
\ No newline at end of file
+    if (st7789_colmod == ST7789_COLMOD_444)
+        ST7789_WriteRGB444(&col, 1, 1, 1, NULL);
+    else
+        ST7789_WritePixels(&col, 1, false, true, NULL);
+    LCD_waitWrite();
+}
@@ -21,6 +21,13 @@
 /** @brief Special signifier for command lists with delays */
 #define ST_CMD_DELAY 0x80
 
+/** @brief Number of rows in the ST7789 frame memory */
+#define ST7789_RAM_ROWS 320
+
+/** @brief Pixel transfer formats (COLMOD values) for LCD_initDisplay() */
+#define ST7789_COLMOD_565 0x55 ///< 16-bit RGB565, 2 bytes per pixel
+#define ST7789_COLMOD_444 0x53 ///< 12-bit RGB444, 1.5 bytes per pixel
+
 // ST77XX Command Definitions
 #define ST77XX_NOP 0x00     ///< No operation
 #define ST77XX_SWRESET 0x01 ///< Software reset
@@ -41,11 +48,13 @@
 #define ST77XX_RAMWR 0x2C   ///< Memory write
 #define ST77XX_RAMRD 0x2E   ///< Memory read
 
-#define ST77XX_PTLAR 0x30  ///< Partial area
-#define ST77XX_TEOFF 0x34  ///< Tearing effect line off
-#define ST77XX_TEON 0x35   ///< Tearing effect line on
-#define ST77XX_MADCTL 0x36 ///< Memory access control
-#define ST77XX_COLMOD 0x3A ///< Pixel format set
+#define ST77XX_PTLAR 0x30   ///< Partial area
+#define ST77XX_VSCRDEF 0x33 ///< Vertical scrolling definition
+#define ST77XX_TEOFF 0x34   ///< Tearing effect line off
+#define ST77XX_TEON 0x35    ///< Tearing effect line on
+#define ST77XX_MADCTL 0x36  ///< Memory access control
+#define ST77XX_VSCSAD 0x37  ///< Vertical scroll start address of RAM
+#define ST77XX_COLMOD 0x3A  ///< Pixel format set
 
 // Memory Access Control Register bits
 #define ST77XX_MADCTL_MY 0x80  ///< Row address order
@@ -70,6 +79,75 @@
 #define ST77XX_YELLOW 0xFFE0  ///< Yellow color (RGB: 255,255,0)
 #define ST77XX_ORANGE 0xFC00  ///< Orange color (RGB: 255,128,0)
 
+/**
+ * @brief Bus operations the driver uses to reach the panel
+ *
+ * The default transport is hardware SPI. LCD_setTransport() can substitute
+ * another bus (see st7789_pio.h) or a host-side mock. The driver drives CS
+ * and RST itself and waits for busy() to return false before every call.
+ */
+typedef struct
+{
+    /** @brief Claim and configure the bus; called by LCD_initDisplay() */
+    void (*init)(void);
+    /** @brief Send a command byte (DC low) followed by its parameters (DC high) */
+    void (*command)(uint8_t cmd, const uint8_t *data, size_t len);
+    /** @brief Send CASET and RASET for an inclusive frame memory area, then RAMWR */
+    void (*window)(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1);
+    /**
+     * @brief Send 16-bit pixel words (DC high), most significant byte first
+     * @note May return before the transfer ends. If repeat is true, pixels[0]
+     *       is sent count times. done(arg) (done may be NULL) runs once the
+     *       last bit has left the bus, possibly in interrupt context.
+     */
+    void (*pixels)(const uint16_t *pixels, uint32_t count, bool repeat, void (*done)(void *arg), void *arg);
+    /** @brief Check whether a pixels() transfer is still in progress */
+    bool (*busy)(void);
+} LCD_Transport;
+
+/** @brief Most displays that can be open at once, including the default one */
+#define LCD_MAX_DISPLAYS 4
+
+/**
+ * @brief State of one panel: pins, bus, geometry and transfers in flight
+ *
+ * All LCD_* functions act on the selected display. A program with one panel
+ * never needs to create or select one.
+ */
+typedef struct LCD_Display LCD_Display;
+
+/**
+ * @brief Create another display with default settings
+ * @return New display, or NULL if LCD_MAX_DISPLAYS are open or memory ran out
+ * @note Select it, then set it up as usual with LCD_setPins(),
+ *       LCD_setSPIperiph() and LCD_initDisplay().
+ */
+LCD_Display *LCD_createDisplay();
+
+/**
+ * @brief Make a display the target of all following LCD_* calls
+ * @param display Display to select, or NULL for the default display
+ * @note A write still in progress on the previous display continues when
+ *       the two use different buses, so transfers to both can overlap. On a
+ *       shared bus it is completed first. Do not switch between
+ *       LCD_beginWrite() and LCD_endWrite().
+ */
+void LCD_selectDisplay(LCD_Display *display);
+
+/**
+ * @brief Get the selected display
+ * @return Selected display; before any LCD_selectDisplay() call, the default one
+ */
+LCD_Display *LCD_getDisplay();
+
+/**
+ * @brief Replace the bus used to talk to the panel
+ * @param transport Transport to use, or NULL for the built-in SPI transport
+ * @note Call before LCD_initDisplay(). The transport must stay valid while
+ *       the display is in use.
+ */
+void LCD_setTransport(const LCD_Transport *transport);
+
 /**
  * @brief Configure GPIO pins for ST7789 display connection
  * @param dc Data/Command pin (GPIO number)
@@ -80,6 +158,38 @@
  */
 void LCD_setPins(uint16_t dc, uint16_t cs, int16_t rst, uint16_t sck, uint16_t tx);
 
+/**
+ * @brief Connect the panel's tearing effect (TE) output
+ * @param te GPIO number wired to TE, or -1 to disable
+ * @note Enables the TE line (V-blank mode) on the panel and a rising-edge
+ *       interrupt on the GPIO. May be called before or after LCD_initDisplay().
+ */
+void LCD_setTEPin(int16_t te);
+
+/**
+ * @brief Check whether a TE pin is configured
+ * @return true if LCD_setTEPin() was given a GPIO
+ */
+bool LCD_hasTE();
+
+/**
+ * @brief Set a function to run on every TE edge (start of vertical blanking)
+ * @param cb Callback, or NULL to disable. Runs in GPIO interrupt context.
+ */
+void LCD_setTECallback(void (*cb)(void));
+
+/**
+ * @brief Get the time of the most recent TE edge
+ * @return Timestamp in microseconds (time_us_64() time base)
+ */
+uint64_t LCD_getTETime();
+
+/**
+ * @brief Get the measured panel refresh period
+ * @return Smoothed interval between TE edges in microseconds
+ */
+uint32_t LCD_getTEPeriod();
+
 /**
  * @brief Set which SPI peripheral to use
  * @param s Pointer to SPI instance (spi0 or spi1)
@@ -90,9 +200,55 @@ void LCD_setSPIperiph(spi_inst_t *s);
  * @brief Initialize the ST7789 display
  * @param width Display width in pixels
  * @param height Display height in pixels
+ * @param colorMode Pixel format sent to the panel: ST7789_COLMOD_565, or
+ *                  ST7789_COLMOD_444 to cut SPI traffic by a quarter at the
+ *                  cost of color depth. All functions still take RGB565 and
+ *                  convert as they send.
  * @note This function includes specific offset handling for 170x320 displays
  */
-void LCD_initDisplay(uint16_t width, uint16_t height);
+void LCD_initDisplay(uint16_t width, uint16_t height, uint8_t colorMode = ST7789_COLMOD_565);
+
+/**
+ * @brief Start initializing the display and return without waiting
+ * @param width Display width in pixels
+ * @param height Display height in pixels
+ * @param colorMode As for LCD_initDisplay()
+ * @note The reset and init commands are sent from an alarm callback over the
+ *       next 200 ms or so, leaving the caller free to load assets and draw the
+ *       first frame into a framebuffer. Writes to the display wait until the
+ *       panel is ready. Other LCD_* settings of this display must wait for
+ *       LCD_isInitDone(). The sequence advances whichever display is
+ *       selected; a step that falls due while another panel on the same bus
+ *       is mid-command or mid-write is retried once the bus is free.
+ */
+void LCD_initDisplayAsync(uint16_t width, uint16_t height, uint8_t colorMode = ST7789_COLMOD_565);
+
+/**
+ * @brief Check whether the init sequence of the display has finished
+ * @return true once the panel accepts pixels, or if it was never initialized
+ */
+bool LCD_isInitDone();
+
+/**
+ * @brief Get how long the last init sequence took
+ * @return Microseconds from the start of LCD_initDisplay() or
+ *         LCD_initDisplayAsync() until the panel was ready
+ */
+uint32_t LCD_getInitTime();
+
+/**
+ * @brief Get the pixel format selected by LCD_initDisplay()
+ * @return ST7789_COLMOD_565 or ST7789_COLMOD_444
+ */
+uint8_t LCD_getColorMode();
+
+/**
+ * @brief Convert RGB565 pixels to packed RGB444 as sent in ST7789_COLMOD_444
+ * @param src Source pixels, 4 per group
+ * @param dst Destination, 3 halfwords per group
+ * @param groups Number of 4-pixel groups
+ */
+void LCD_packRGB444(const uint16_t *src, uint16_t *dst, uint32_t groups);
 
 /**
  * @brief Set display rotation/orientation
@@ -100,6 +256,45 @@ void LCD_initDisplay(uint16_t width, uint16_t height);
  */
 void LCD_setRotation(uint8_t m);
 
+/**
+ * @brief Keep the display selected across several writes
+ * @note Every LCD_beginWrite() must be paired with LCD_endWrite(). Calls may
+ *       nest; CS is released by the outermost LCD_endWrite().
+ */
+void LCD_beginWrite();
+
+/**
+ * @brief End a group of writes started with LCD_beginWrite()
+ */
+void LCD_endWrite();
+
+/**
+ * @brief Make the visible area a hardware vertical scrolling region
+ * @return false if the current rotation swaps rows and columns (1 or 3), where
+ *         the panel can only scroll horizontally
+ * @note LCD_setRotation() turns scrolling off again.
+ */
+bool LCD_enableVerticalScroll();
+
+/**
+ * @brief Restore the unscrolled frame memory mapping
+ */
+void LCD_disableVerticalScroll();
+
+/**
+ * @brief Check whether hardware vertical scrolling is active
+ * @return true between LCD_enableVerticalScroll() and a rotation change or
+ *         LCD_disableVerticalScroll()
+ */
+bool LCD_isVerticalScrollEnabled();
+
+/**
+ * @brief Set how far the content has scrolled up
+ * @param lines Frame memory row (0 to height-1, relative to the display
+ *              window) that appears at the top of the screen
+ */
+void LCD_setScrollOffset(uint16_t lines);
+
 /**
  * @brief Write a single pixel to the display
  * @param x X coordinate (0 to width-1)
@@ -108,6 +303,18 @@ void LCD_setRotation(uint8_t m);
  */
 void LCD_WritePixel(int x, int y, uint16_t col);
 
+/**
+ * @brief Fill a rectangle on the display with a solid color
+ * @param x Starting X coordinate
+ * @param y Starting Y coordinate
+ * @param w Width of the rectangle
+ * @param h Height of the rectangle
+ * @param color 16-bit RGB565 color value
+ * @note Uses one address window. With USE_DMA the color is streamed by DMA
+ *       and the function returns before the fill completes.
+ */
+void LCD_fillRect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color);
+
 /**
  * @brief Write a bitmap/image to the display
  * @param x Starting X coordinate
@@ -118,4 +325,74 @@ void LCD_WritePixel(int x, int y, uint16_t col);
  */
 void LCD_WriteBitmap(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t *bitmap);
 
+/**
+ * @brief Write a rectangle cut out of a larger image (e.g. a framebuffer region)
+ * @param x Starting X coordinate
+ * @param y Starting Y coordinate
+ * @param w Width of the rectangle
+ * @param h Height of the rectangle
+ * @param bitmap Pointer to the first pixel of the rectangle
+ * @param stride Distance in pixels between the starts of consecutive rows
+ */
+void LCD_WriteBitmapStride(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *bitmap, uint16_t stride);
+
+/**
+ * @brief Start writing a bitmap to the display and return without waiting
+ * @param x Starting X coordinate
+ * @param y Starting Y coordinate
+ * @param w Width of the bitmap
+ * @param h Height of the bitmap
+ * @param bitmap Pointer to 16-bit RGB565 color data array
+ * @param done Optional callback run when the transfer completes (may be NULL)
+ * @note The bitmap must not be modified until LCD_isWriteDone() returns true.
+ *       With USE_DMA the callback runs in DMA interrupt context; without it the
+ *       write is blocking and the callback runs before this function returns.
+ */
+void LCD_WriteBitmapAsync(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *bitmap, void (*done)(void));
+
+/**
+ * @brief Reserve the bus for a frame sent in several parts
+ * @note Waits for the bus first. Until LCD_endFrame(), every LCD_* call that
+ *       uses the bus (commands such as LCD_setRotation() included) waits,
+ *       and only LCD_WriteFramePart() writes. GFX_flushVsync() holds the bus
+ *       this way so nothing can reprogram the window between its bands.
+ */
+void LCD_beginFrame();
+
+/**
+ * @brief Release the bus reserved by LCD_beginFrame()
+ * @note May be called from interrupt context, e.g. from the done callback of
+ *       the last LCD_WriteFramePart().
+ */
+void LCD_endFrame();
+
+/**
+ * @brief Send one part of a frame started with LCD_beginFrame()
+ * @note Same as LCD_WriteBitmapAsync() except that it does not wait for the
+ *       frame, only for the previous part. Safe to call from the done
+ *       callback of the previous part.
+ */
+void LCD_WriteFramePart(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *bitmap,
+                        void (*done)(void));
+
+/**
+ * @brief Check whether the last LCD_WriteBitmapAsync() transfer has finished
+ * @return true when the bus is idle and the bitmap may be reused
+ * @note Also false while LCD_beginFrame() holds the bus.
+ */
+bool LCD_isWriteDone();
+
+/**
+ * @brief Block until the last LCD_WriteBitmapAsync() transfer has finished
+ */
+void LCD_waitWrite();
+
+/**
+ * @brief Check whether a display could start a write without waiting
+ * @param display Display to check, NULL for the default one; need not be selected
+ * @return false while its init sequence, a frame or a transfer is in
+ *         progress, or while the selected display is busy on a shared bus
+ */
+bool LCD_isDisplayIdle(LCD_Display *display);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,191 @@
+// PIO transport for the ST7789 driver.
+// Commands, address windows and pixels are sent as tagged words (see
+// st7789_pio.pio); the state machine sets DC from each header.
+//
+
+#include "st7789_pio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/clocks.h"
+#include "st7789_pio.pio.h"
+
+#define PIO_HDR_DATA 0x80000000u   ///< Payload is sent with DC high
+#define PIO_HDR_PIXELS 0x40000000u ///< Payload is 16-bit pixels, one per word
+
+extern uint16_t st7789_pinDC;
+extern uint16_t st7789_pinSCK;
+extern uint16_t st7789_pinTX;
+
+static PIO pio_bus;
+static PIO pio_loaded = NULL; ///< Block holding the program, state machine and channels
+static uint pio_offset;
+static uint pio_sm;
+static uint32_t pio_baud;
+static uint pio_dmaQueue;  ///< Sends queued headers, then starts pio_dmaPixels
+static uint pio_dmaPixels; ///< Sends pixel data
+static uint32_t pio_queue[12]; ///< Window commands and pixel header for the next transfer
+static uint8_t pio_queued = 0;
+static volatile bool pio_busy = false;
+static void (*pio_done)(void *arg) = NULL;
+static void *pio_doneArg = NULL;
+
+// Wait until the state machine has shifted out everything and is waiting
+// for the next header
+static void pioWaitIdle()
+{
+    uint32_t stall = 1u << (PIO_FDEBUG_TXSTALL_LSB + pio_sm);
+    pio_bus->fdebug = stall;
+    while (!(pio_bus->fdebug & stall))
+        tight_loop_contents();
+}
+
+static void pioDmaIrqHandler()
+{
+    if (!dma_channel_get_irq0_status(pio_dmaPixels))
+        return;
+    dma_channel_acknowledge_irq0(pio_dmaPixels);
+
+    // The last words are still in the FIFO and shift register
+    pioWaitIdle();
+    pio_busy = false;
+    if (pio_done)
+        pio_done(pio_doneArg);
+}
+
+// Give back the program, state machine and channels of an earlier init
+static void pioRelease()
+{
+    pio_sm_set_enabled(pio_loaded, pio_sm, false);
+    pio_sm_unclaim(pio_loaded, pio_sm);
+    pio_remove_program(pio_loaded, &st7789_pio_program, pio_offset);
+    dma_channel_set_irq0_enabled(pio_dmaPixels, false);
+    dma_channel_unclaim(pio_dmaQueue);
+    dma_channel_unclaim(pio_dmaPixels);
+    pio_loaded = NULL;
+}
+
+static void pioInit()
+{
+    // LCD_initDisplay() may run again, e.g. to change the color mode. The
+    // resources are claimed once per PIO block; only the pins and clock
+    // divider are set up again.
+    if (pio_loaded != pio_bus)
+    {
+        if (pio_loaded != NULL)
+            pioRelease();
+        pio_offset = pio_add_program(pio_bus, &st7789_pio_program);
+        pio_sm = pio_claim_unused_sm(pio_bus, true);
+        pio_dmaQueue = dma_claim_unused_channel(true);
+        pio_dmaPixels = dma_claim_unused_channel(true);
+
+        static bool irqAdded = false;
+        if (!irqAdded)
+        {
+            irq_add_shared_handler(DMA_IRQ_0, pioDmaIrqHandler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+            irqAdded = true;
+        }
+        pio_loaded = pio_bus;
+    }
+
+    float div = (float)clock_get_hz(clk_sys) / (2.0f * pio_baud);
+    if (div < 1.0f)
+        div = 1.0f;
+    st7789_pio_program_init(pio_bus, pio_sm, pio_offset, st7789_pinTX, st7789_pinSCK, st7789_pinDC, div);
+
+    dma_channel_config c = dma_channel_get_default_config(pio_dmaQueue);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_dreq(&c, pio_get_dreq(pio_bus, pio_sm, true));
+    channel_config_set_chain_to(&c, pio_dmaPixels);
+    dma_channel_configure(pio_dmaQueue, &c, &pio_bus->txf[pio_sm], pio_queue, 0, false);
+
+    dma_channel_set_irq0_enabled(pio_dmaPixels, true);
+    irq_set_enabled(DMA_IRQ_0, true);
+}
+
+// Up to four parameter bytes, MSB first, as the state machine shifts them
+static uint32_t pioPackBytes(const uint8_t *data, size_t len, size_t i)
+{
+    uint32_t w = 0;
+    for (size_t j = i; j < i + 4; j++)
+        w = (w << 8) | (j < len ? data[j] : 0);
+    return w;
+}
+
+// Tagged words for a command byte and its parameters
+static uint8_t pioEncodeCommand(uint32_t *words, uint8_t cmd, const uint8_t *data, size_t len)
+{
+    uint8_t n = 0;
+    words[n++] = 8 - 1; // DC low, 8 bits
+    words[n++] = (uint32_t)cmd << 24;
+    if (len)
+    {
+        words[n++] = PIO_HDR_DATA | (len * 8 - 1);
+        for (size_t i = 0; i < len; i += 4)
+            words[n++] = pioPackBytes(data, len, i);
+    }
+    return n;
+}
+
+static void pioCommand(uint8_t cmd, const uint8_t *data, size_t len)
+{
+    pio_sm_put_blocking(pio_bus, pio_sm, 8 - 1);
+    pio_sm_put_blocking(pio_bus, pio_sm, (uint32_t)cmd << 24);
+    if (len)
+    {
+        pio_sm_put_blocking(pio_bus, pio_sm, PIO_HDR_DATA | (len * 8 - 1));
+        for (size_t i = 0; i < len; i += 4)
+            pio_sm_put_blocking(pio_bus, pio_sm, pioPackBytes(data, len, i));
+    }
+    pioWaitIdle(); // the caller releases CS next
+}
+
+static void pioWindow(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
+{
+    // Held back and sent by the same DMA chain as the pixels that follow
+    uint8_t caset[4] = {(uint8_t)(x0 >> 8), (uint8_t)x0, (uint8_t)(x1 >> 8), (uint8_t)x1};
+    uint8_t raset[4] = {(uint8_t)(y0 >> 8), (uint8_t)y0, (uint8_t)(y1 >> 8), (uint8_t)y1};
+
+    pio_queued = pioEncodeCommand(pio_queue, ST77XX_CASET, caset, 4);
+    pio_queued += pioEncodeCommand(pio_queue + pio_queued, ST77XX_RASET, raset, 4);
+    pio_queued += pioEncodeCommand(pio_queue + pio_queued, ST77XX_RAMWR, NULL, 0);
+}
+
+static void pioPixels(const uint16_t *pixels, uint32_t count, bool repeat, void (*done)(void *arg), void *arg)
+{
+    // The header has no way to say zero pixels. A queued window stays queued
+    // for the next write.
+    if (count == 0)
+    {
+        if (done)
+            done(arg);
+        return;
+    }
+
+    pio_queue[pio_queued++] = PIO_HDR_DATA | PIO_HDR_PIXELS | (count - 1);
+
+    dma_channel_config c = dma_channel_get_default_config(pio_dmaPixels);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, !repeat);
+    channel_config_set_dreq(&c, pio_get_dreq(pio_bus, pio_sm, true));
+    dma_channel_configure(pio_dmaPixels, &c, &pio_bus->txf[pio_sm], pixels, count, false);
+
+    pio_done = done;
+    pio_doneArg = arg;
+    pio_busy = true;
+    dma_channel_transfer_from_buffer_now(pio_dmaQueue, pio_queue, pio_queued);
+    pio_queued = 0; // not refilled until the driver has seen busy() go false
+}
+
+static bool pioBusy()
+{
+    return pio_busy;
+}
+
+static const LCD_Transport pio_transport = {pioInit, pioCommand, pioWindow, pioPixels, pioBusy};
+
+const LCD_Transport *LCD_pioTransport(PIO pio, uint32_t baudrate)
+{
+    pio_bus = pio;
+    pio_baud = baudrate;
+    return &pio_transport;
+}
@@ -0,0 +1,32 @@
+/**
+ * @file st7789_pio.h
+ * @brief PIO transport for the ST7789 driver
+ * @date 2025
+ *
+ * Drives SCK, MOSI and DC from a PIO state machine instead of the SPI
+ * peripheral. DC is switched by the state machine from tags in the data
+ * stream, so an address window and its pixels go out as one DMA chain.
+ */
+
+#ifndef ST7789_PIO_H
+#define ST7789_PIO_H
+
+#include "st7789.h"
+#include "hardware/pio.h"
+
+/**
+ * @brief Get a transport that drives the panel from a PIO state machine
+ * @param pio PIO block to load the program into (pio0 or pio1)
+ * @param baudrate SCK frequency in Hz, at most half the system clock
+ *                 (62.5 MHz at 125 MHz)
+ * @return Transport to pass to LCD_setTransport() before LCD_initDisplay()
+ * @note Uses the SCK, TX and DC pins given to LCD_setPins(), one state
+ *       machine and two DMA channels. Transfers are always DMA driven,
+ *       whether or not USE_DMA is defined. The state machine serves a
+ *       single panel, so only one display may use this transport.
+ *       Initialising again reuses the state machine, program and channels;
+ *       after switching to the other PIO block the next init releases them.
+ */
+const LCD_Transport *LCD_pioTransport(PIO pio, uint32_t baudrate);
+
+#endif
@@ -0,0 +1,97 @@
+#include "mock_transport.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+uint16_t mock_gram[320][240];
+uint32_t mock_touched, mock_overlapped, mock_transfers;
+uint32_t mock_pixelsPerUs = 8;
+void (*mock_onCommand)(uint8_t cmd, const uint8_t *data, size_t len);
+void (*mock_onWindow)(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1);
+void (*mock_onDone)(void);
+
+static uint16_t winX0, winY0, winX1, winY1, curX, curY;
+
+static struct
+{
+    bool busy;
+    const uint16_t *pixels;
+    std::vector<uint16_t> copy; ///< Buffer contents when pixels() was called
+    uint32_t count;
+    bool repeat;
+    void (*done)(void *arg);
+    void *arg;
+} pending;
+
+static void mockInit() {}
+
+static void mockCommand(uint8_t cmd, const uint8_t *data, size_t len)
+{
+    if (mock_onCommand)
+        mock_onCommand(cmd, data, len);
+}
+
+static void mockWindow(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
+{
+    winX0 = curX = x0;
+    winY0 = curY = y0;
+    winX1 = x1;
+    winY1 = y1;
+    if (mock_onWindow)
+        mock_onWindow(x0, y0, x1, y1);
+}
+
+static void mockStore(uint16_t c)
+{
+    if (curX < 240 && curY < 320)
+        mock_gram[curY][curX] = c;
+    if (++curX > winX1)
+    {
+        curX = winX0;
+        if (++curY > winY1)
+            curY = winY0;
+    }
+}
+
+static int64_t mockFinish(alarm_id_t, void *)
+{
+    // Check the buffer against the snapshot before anything else can run
+    uint32_t n = pending.repeat ? 1 : pending.count;
+    if (memcmp(pending.pixels, pending.copy.data(), n * sizeof(uint16_t)) != 0)
+    {
+        printf("mock: %u-pixel buffer at %p changed before done()\n", (unsigned)pending.count,
+               (const void *)pending.pixels);
+        mock_touched++;
+    }
+    for (uint32_t i = 0; i < pending.count; i++)
+        mockStore(pending.copy[pending.repeat ? 0 : i]);
+    mock_transfers++;
+    pending.busy = false;
+    if (mock_onDone)
+        mock_onDone();
+    if (pending.done)
+        pending.done(pending.arg);
+    return 0;
+}
+
+static void mockPixels(const uint16_t *pixels, uint32_t count, bool repeat, void (*done)(void *arg), void *arg)
+{
+    if (pending.busy)
+    {
+        printf("mock: pixels() called while the previous transfer is busy\n");
+        mock_overlapped++;
+    }
+    pending.busy = true;
+    pending.pixels = pixels;
+    pending.copy.assign(pixels, pixels + (repeat ? 1 : count));
+    pending.count = count;
+    pending.repeat = repeat;
+    pending.done = done;
+    pending.arg = arg;
+    add_alarm_in_us(1 + count / mock_pixelsPerUs, mockFinish, NULL, true);
+}
+
+static bool mockBusy() { return pending.busy; }
+
+const LCD_Transport mock_transport = {mockInit, mockCommand, mockWindow, mockPixels, mockBusy};
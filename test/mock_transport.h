@@ -0,0 +1,24 @@
+// A host LCD_Transport that checks the driver's buffer ownership rules.
+//
+// pixels() snapshots the caller's buffer and finishes later, from a sim
+// alarm, at a fixed simulated bus rate. When it finishes it compares the
+// buffer with the snapshot: any change means the caller touched a buffer
+// it had handed to the bus before done() fired. It also flags a pixels()
+// call made while the previous one is still busy().
+
+#pragma once
+#include "st7789.h"
+
+/** @brief The mock; install with LCD_setTransport() before LCD_initDisplay() */
+extern const LCD_Transport mock_transport;
+
+extern uint16_t mock_gram[320][240]; ///< Pixels as the mock received them, [row][column]
+extern uint32_t mock_touched;        ///< Transfers whose buffer changed before done()
+extern uint32_t mock_overlapped;     ///< pixels() calls made while busy
+extern uint32_t mock_transfers;      ///< Completed pixels() calls
+extern uint32_t mock_pixelsPerUs;    ///< Simulated bus rate, 8 by default (about 62.5 MHz SPI)
+
+// Optional observers, called with the traffic as it arrives
+extern void (*mock_onCommand)(uint8_t cmd, const uint8_t *data, size_t len);
+extern void (*mock_onWindow)(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1);
+extern void (*mock_onDone)(void); ///< A transfer finished, just before its done()
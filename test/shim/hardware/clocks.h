@@ -0,0 +1,4 @@
+#pragma once
+#include "pico/stdlib.h"
+#define clk_sys 5
+uint32_t clock_get_hz(int);
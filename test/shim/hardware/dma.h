@@ -0,0 +1,28 @@
+#pragma once
+#include "pico/stdlib.h"
+enum dma_channel_transfer_size { DMA_SIZE_8 = 0, DMA_SIZE_16 = 1, DMA_SIZE_32 = 2 };
+typedef struct { uint32_t ctrl; uint size; bool rinc, winc; uint dreq; uint chain; bool bswap; } dma_channel_config;
+int dma_claim_unused_channel(bool required);
+void dma_channel_unclaim(uint ch);
+dma_channel_config dma_channel_get_default_config(uint ch);
+void channel_config_set_transfer_data_size(dma_channel_config*, enum dma_channel_transfer_size);
+void channel_config_set_read_increment(dma_channel_config*, bool);
+void channel_config_set_write_increment(dma_channel_config*, bool);
+void channel_config_set_dreq(dma_channel_config*, uint);
+void channel_config_set_chain_to(dma_channel_config*, uint);
+void channel_config_set_bswap(dma_channel_config*, bool);
+void dma_channel_configure(uint ch, const dma_channel_config*, volatile void *w, const volatile void *r, uint count, bool trigger);
+void dma_channel_set_read_addr(uint ch, const volatile void *r, bool trigger);
+void dma_channel_set_trans_count(uint ch, uint32_t n, bool trigger);
+void dma_channel_transfer_from_buffer_now(uint ch, const volatile void *r, uint32_t n);
+void dma_channel_start(uint ch);
+void dma_channel_wait_for_finish_blocking(uint ch);
+bool dma_channel_is_busy(uint ch);
+void dma_channel_set_irq0_enabled(uint ch, bool en);
+void dma_channel_set_irq1_enabled(uint ch, bool en);
+bool dma_channel_get_irq0_status(uint ch);
+bool dma_channel_get_irq1_status(uint ch);
+void dma_channel_acknowledge_irq0(uint ch);
+void dma_channel_acknowledge_irq1(uint ch);
+void dma_channel_abort(uint ch);
+#define DREQ_FORCE 0x3f
@@ -0,0 +1,10 @@
+#pragma once
+#include "pico/stdlib.h"
+typedef void (*irq_handler_t)(void);
+#define DMA_IRQ_0 11
+#define DMA_IRQ_1 12
+#define IO_IRQ_BANK0 13
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY 0x80
+void irq_set_exclusive_handler(uint num, irq_handler_t h);
+void irq_add_shared_handler(uint num, irq_handler_t h, uint8_t prio);
+void irq_set_enabled(uint num, bool en);
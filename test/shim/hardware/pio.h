@@ -0,0 +1,31 @@
+#pragma once
+#include "pico/stdlib.h"
+typedef struct { volatile uint32_t ctrl, fstat, fdebug, flevel; volatile uint32_t txf[4]; } pio_hw_t;
+typedef pio_hw_t *PIO;
+extern PIO pio0, pio1;
+typedef struct { uint32_t a,b,c,d; } pio_sm_config;
+typedef struct pio_program { const uint16_t *instructions; uint8_t length; int8_t origin; } pio_program_t;
+#define PIO_FDEBUG_TXSTALL_LSB 24
+bool pio_can_add_program(PIO, const pio_program_t*);
+uint pio_add_program(PIO, const pio_program_t*);
+void pio_remove_program(PIO, const pio_program_t*, uint offset);
+int pio_claim_unused_sm(PIO, bool);
+void pio_sm_unclaim(PIO, uint sm);
+void pio_gpio_init(PIO, uint);
+void pio_sm_set_consecutive_pindirs(PIO, uint sm, uint base, uint count, bool out);
+void pio_sm_set_pins_with_mask(PIO, uint sm, uint32_t v, uint32_t mask);
+void pio_sm_init(PIO, uint sm, uint off, const pio_sm_config*);
+void pio_sm_set_enabled(PIO, uint sm, bool);
+void pio_sm_put_blocking(PIO, uint sm, uint32_t);
+bool pio_sm_is_tx_fifo_empty(PIO, uint sm);
+uint pio_get_dreq(PIO, uint sm, bool tx);
+void sm_config_set_sideset_pins(pio_sm_config*, uint);
+void sm_config_set_out_pins(pio_sm_config*, uint, uint);
+void sm_config_set_set_pins(pio_sm_config*, uint, uint);
+void sm_config_set_clkdiv(pio_sm_config*, float);
+void sm_config_set_out_shift(pio_sm_config*, bool right, bool autopull, uint thresh);
+void sm_config_set_fifo_join(pio_sm_config*, int);
+void sm_config_set_wrap(pio_sm_config*, uint, uint);
+void sm_config_set_sideset(pio_sm_config*, uint, bool, bool);
+pio_sm_config pio_get_default_sm_config();
+#define PIO_FIFO_JOIN_TX 1
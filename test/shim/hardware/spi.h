@@ -0,0 +1,17 @@
+#pragma once
+#include "pico/stdlib.h"
+typedef struct { volatile uint32_t cr0, cr1, dr, sr; } spi_hw_t;
+typedef struct spi_inst spi_inst_t;
+extern spi_inst_t *spi0, *spi1;
+#define spi_default spi0
+typedef enum { SPI_CPOL_0 = 0, SPI_CPOL_1 = 1 } spi_cpol_t;
+typedef enum { SPI_CPHA_0 = 0, SPI_CPHA_1 = 1 } spi_cpha_t;
+typedef enum { SPI_LSB_FIRST = 0, SPI_MSB_FIRST = 1 } spi_order_t;
+uint spi_init(spi_inst_t*, uint);
+void spi_set_format(spi_inst_t*, uint bits, spi_cpol_t, spi_cpha_t, spi_order_t);
+int spi_write_blocking(spi_inst_t*, const uint8_t*, size_t);
+int spi_write16_blocking(spi_inst_t*, const uint16_t*, size_t);
+spi_hw_t *spi_get_hw(spi_inst_t*);
+uint spi_get_dreq(spi_inst_t*, bool is_tx);
+bool spi_is_busy(const spi_inst_t*);
+uint spi_get_index(const spi_inst_t*);
@@ -0,0 +1,46 @@
+// Host shim: the parts of the Pico SDK the library uses, implemented in sim.cpp
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+#define PICO_DEFAULT_SPI_SCK_PIN 18
+#define PICO_DEFAULT_SPI_TX_PIN 19
+#define GPIO_OUT 1
+#define GPIO_IN 0
+#define GPIO_FUNC_SPI 1
+#define GPIO_FUNC_PIO0 6
+#define GPIO_FUNC_PIO1 7
+#define GPIO_IRQ_EDGE_RISE 8u
+#define GPIO_IRQ_EDGE_FALL 4u
+#define __not_in_flash_func(f) f
+#define __time_critical_func(f) f
+#define __scratch_x(n)
+#define __scratch_y(n)
+#define count_of(a) (sizeof(a)/sizeof((a)[0]))
+#define hard_assert(x) ((void)0)
+#define PICO_OK 0
+typedef int32_t alarm_id_t;
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *user_data);
+typedef void (*gpio_irq_callback_t)(uint gpio, uint32_t event_mask);
+void gpio_init(uint); void gpio_set_dir(uint,bool); void gpio_put(uint,bool); bool gpio_get(uint);
+void gpio_set_function(uint,int); void gpio_pull_up(uint); void gpio_pull_down(uint);
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t events, bool enabled, gpio_irq_callback_t cb);
+void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled);
+void gpio_add_raw_irq_handler(uint gpio, void (*h)(void));
+void gpio_acknowledge_irq(uint gpio, uint32_t events);
+uint32_t gpio_get_irq_event_mask(uint gpio);
+void sleep_ms(uint32_t); void sleep_us(uint64_t);
+uint64_t time_us_64(); uint32_t time_us_32();
+absolute_time_t get_absolute_time(); int64_t absolute_time_diff_us(absolute_time_t a, absolute_time_t b);
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t cb, void *ud, bool fire_if_past);
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t cb, void *ud, bool fire_if_past);
+bool cancel_alarm(alarm_id_t);
+void tight_loop_contents();
+static inline void __dmb() {}
+static inline void __wfe() {}
+static inline void __sev() {}
+static inline uint32_t save_and_disable_interrupts() {return 0;}
+static inline void restore_interrupts(uint32_t) {}
+bool stdio_init_all();
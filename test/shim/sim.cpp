@@ -0,0 +1,561 @@
+// Host implementation of the Pico SDK subset declared in this directory.
+// See sim.h for the model; everything here runs on the calling thread.
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/spi.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "hardware/clocks.h"
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+SimStats sim_stats;
+int sim_dc_pin = -1, sim_cs_pin = -1;
+uint16_t sim_gram[320][240];
+uint16_t sim_vscsad, sim_tfa = 0, sim_vsa = 320;
+uint8_t sim_colmod = 0x55, sim_madctl;
+uint64_t sim_time_us = 0;
+bool sim_strict_format = false;
+int sim_pio_programs, sim_pio_claimed;
+
+static bool pins[64];
+
+struct spi_inst
+{
+    spi_hw_t hw;
+    uint bits;
+};
+static spi_inst s0, s1;
+spi_inst_t *spi0 = &s0, *spi1 = &s1;
+
+static pio_hw_t p0hw, p1hw;
+PIO pio0 = &p0hw, pio1 = &p1hw;
+
+void sim_reset_stats() { memset(&sim_stats, 0, sizeof sim_stats); }
+
+// ---- Panel model
+
+static uint8_t curCmd;
+static int argIdx;
+static uint8_t args[8];
+static uint16_t xs, xe, ys, ye, px, py;
+static uint8_t pend[3];
+static int npend;
+
+static void panelPixel(uint16_t c)
+{
+    if (px < 240 && py < 320)
+        sim_gram[py][px] = c;
+    if (++px > xe)
+    {
+        px = xs;
+        if (++py > ye)
+            py = ys;
+    }
+}
+
+void sim_panel_write(bool dc, uint8_t b)
+{
+    sim_stats.bytes++;
+    if (sim_cs_pin >= 0 && pins[sim_cs_pin])
+        return;
+    if (!dc)
+    {
+        curCmd = b;
+        argIdx = 0;
+        npend = 0;
+        sim_stats.cmds++;
+        if (b == 0x2C)
+        {
+            px = xs;
+            py = ys;
+        }
+        if (b == 0x2A)
+            sim_stats.windows++;
+        return;
+    }
+    switch (curCmd)
+    {
+    case 0x2A: // CASET
+    case 0x2B: // RASET
+    case 0x33: // VSCRDEF
+        if (argIdx < 8)
+            args[argIdx] = b;
+        argIdx++;
+        if (argIdx == 4 && curCmd == 0x2A)
+        {
+            xs = args[0] << 8 | args[1];
+            xe = args[2] << 8 | args[3];
+        }
+        if (argIdx == 4 && curCmd == 0x2B)
+        {
+            ys = args[0] << 8 | args[1];
+            ye = args[2] << 8 | args[3];
+        }
+        if (argIdx == 4 && curCmd == 0x33)
+        {
+            sim_tfa = args[0] << 8 | args[1];
+            sim_vsa = args[2] << 8 | args[3];
+        }
+        break;
+    case 0x37: // VSCSAD
+        args[argIdx++ & 7] = b;
+        if (argIdx == 2)
+            sim_vscsad = args[0] << 8 | args[1];
+        break;
+    case 0x3A:
+        sim_colmod = b;
+        break;
+    case 0x36:
+        sim_madctl = b;
+        break;
+    case 0x2C: // RAMWR: RGB565 is 2 bytes per pixel, RGB444 3 bytes per 2 pixels
+        pend[npend++] = b;
+        if ((sim_colmod & 7) == 5 && npend == 2)
+        {
+            panelPixel(pend[0] << 8 | pend[1]);
+            npend = 0;
+        }
+        else if ((sim_colmod & 7) == 3 && npend == 3)
+        {
+            uint8_t r0 = pend[0] >> 4, g0 = pend[0] & 15, b0 = pend[1] >> 4;
+            uint8_t r1 = pend[1] & 15, g1 = pend[2] >> 4, b1 = pend[2] & 15;
+            panelPixel((r0 << 12) | (g0 << 7) | (b0 << 1));
+            panelPixel((r1 << 12) | (g1 << 7) | (b1 << 1));
+            npend = 0;
+        }
+        break;
+    }
+}
+
+static void spiPush(spi_inst *s, uint32_t v)
+{
+    bool dc = sim_dc_pin >= 0 && pins[sim_dc_pin];
+    if (s->bits == 16)
+        sim_panel_write(dc, v >> 8);
+    sim_panel_write(dc, v & 0xFF);
+}
+
+// ---- GPIO
+
+static gpio_irq_callback_t gpioCallback;
+static void (*gpioRaw)(void);
+static uint gpioRawPin;
+static uint32_t gpioEvents;
+
+void gpio_init(uint) {}
+void gpio_set_dir(uint, bool) {}
+void gpio_put(uint p, bool v)
+{
+    if ((int)p == sim_cs_pin && pins[p] != v)
+        sim_stats.csToggles++;
+    pins[p] = v;
+}
+bool gpio_get(uint p) { return pins[p]; }
+void gpio_set_function(uint, int) {}
+void gpio_pull_up(uint) {}
+void gpio_pull_down(uint) {}
+void gpio_set_irq_enabled_with_callback(uint, uint32_t, bool, gpio_irq_callback_t cb) { gpioCallback = cb; }
+void gpio_set_irq_enabled(uint, uint32_t, bool) {}
+void gpio_add_raw_irq_handler(uint g, void (*h)(void))
+{
+    gpioRaw = h;
+    gpioRawPin = g;
+}
+void gpio_acknowledge_irq(uint, uint32_t e) { gpioEvents &= ~e; }
+uint32_t gpio_get_irq_event_mask(uint) { return gpioEvents; }
+
+void sim_fire_gpio_irq(uint32_t g, uint32_t ev)
+{
+    gpioEvents = ev;
+    if (gpioRaw && g == gpioRawPin)
+        gpioRaw();
+    else if (gpioCallback)
+        gpioCallback(g, ev);
+}
+
+// ---- Time and alarms
+
+struct Alarm
+{
+    uint64_t at;
+    alarm_callback_t cb;
+    void *ud;
+};
+static std::map<alarm_id_t, Alarm> alarms;
+static alarm_id_t nextAlarm = 1;
+
+static void runAlarms()
+{
+    for (bool again = true; again;)
+    {
+        again = false;
+        for (auto it = alarms.begin(); it != alarms.end(); ++it)
+        {
+            if (it->second.at > sim_time_us)
+                continue;
+            Alarm a = it->second;
+            alarm_id_t id = it->first;
+            alarms.erase(it);
+            // Positive: reschedule relative to the old due time, negative: to now
+            int64_t r = a.cb(id, a.ud);
+            if (r > 0)
+                alarms[id] = {a.at + (uint64_t)r, a.cb, a.ud};
+            else if (r < 0)
+                alarms[id] = {sim_time_us + (uint64_t)-r, a.cb, a.ud};
+            again = true;
+            break;
+        }
+    }
+}
+
+void sleep_us(uint64_t us)
+{
+    sim_time_us += us;
+    sim_tick();
+}
+void sleep_ms(uint32_t ms) { sleep_us(ms * 1000ull); }
+uint64_t time_us_64() { return sim_time_us; }
+uint32_t time_us_32() { return (uint32_t)sim_time_us; }
+absolute_time_t get_absolute_time() { return sim_time_us; }
+int64_t absolute_time_diff_us(absolute_time_t a, absolute_time_t b) { return (int64_t)(b - a); }
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t cb, void *ud, bool)
+{
+    alarm_id_t id = nextAlarm++;
+    alarms[id] = {sim_time_us + us, cb, ud};
+    return id;
+}
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t cb, void *ud, bool past)
+{
+    return add_alarm_in_us(ms * 1000ull, cb, ud, past);
+}
+bool cancel_alarm(alarm_id_t id) { return alarms.erase(id) > 0; }
+bool stdio_init_all() { return true; }
+
+// ---- SPI
+
+uint spi_init(spi_inst_t *s, uint baud)
+{
+    s->bits = 8;
+    return baud;
+}
+void spi_set_format(spi_inst_t *s, uint bits, spi_cpol_t, spi_cpha_t, spi_order_t)
+{
+    sim_stats.fmtChanges++;
+    s->bits = bits;
+}
+int spi_write_blocking(spi_inst_t *s, const uint8_t *b, size_t n)
+{
+    if (sim_strict_format && s->bits != 8)
+    {
+        fprintf(stderr, "8-bit write in %u-bit mode\n", s->bits);
+        abort();
+    }
+    for (size_t i = 0; i < n; i++)
+        spiPush(s, b[i]);
+    return (int)n;
+}
+int spi_write16_blocking(spi_inst_t *s, const uint16_t *b, size_t n)
+{
+    if (sim_strict_format && s->bits != 16)
+    {
+        fprintf(stderr, "16-bit write in %u-bit mode\n", s->bits);
+        abort();
+    }
+    for (size_t i = 0; i < n; i++)
+        spiPush(s, b[i]);
+    return (int)n;
+}
+spi_hw_t *spi_get_hw(spi_inst_t *s) { return &s->hw; }
+uint spi_get_dreq(spi_inst_t *s, bool) { return s == spi0 ? 16 : 18; }
+bool spi_is_busy(const spi_inst_t *) { return false; }
+uint spi_get_index(const spi_inst_t *s) { return s == spi1; }
+
+// ---- IRQ
+
+static std::vector<irq_handler_t> irqHandlers[32];
+void irq_set_exclusive_handler(uint n, irq_handler_t h) { irqHandlers[n].assign(1, h); }
+void irq_add_shared_handler(uint n, irq_handler_t h, uint8_t) { irqHandlers[n].push_back(h); }
+void irq_set_enabled(uint, bool) {}
+
+// ---- DMA: a started channel completes in the next sim_tick()
+
+struct Chan
+{
+    bool claimed, busy, irq0, irq1, st0, st1;
+    dma_channel_config cfg;
+    volatile void *w;
+    const volatile void *r;
+    uint32_t n;
+};
+static Chan chans[12];
+
+int dma_claim_unused_channel(bool)
+{
+    for (int i = 0; i < 12; i++)
+        if (!chans[i].claimed)
+        {
+            chans[i].claimed = true;
+            return i;
+        }
+    fprintf(stderr, "no free DMA channel\n");
+    abort();
+}
+void dma_channel_unclaim(uint c) { chans[c].claimed = false; }
+dma_channel_config dma_channel_get_default_config(uint c)
+{
+    dma_channel_config d{};
+    d.size = DMA_SIZE_32;
+    d.rinc = true;
+    d.dreq = DREQ_FORCE;
+    d.chain = c;
+    return d;
+}
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size s) { c->size = s; }
+void channel_config_set_read_increment(dma_channel_config *c, bool b) { c->rinc = b; }
+void channel_config_set_write_increment(dma_channel_config *c, bool b) { c->winc = b; }
+void channel_config_set_dreq(dma_channel_config *c, uint d) { c->dreq = d; }
+void channel_config_set_chain_to(dma_channel_config *c, uint t) { c->chain = t; }
+void channel_config_set_bswap(dma_channel_config *c, bool b) { c->bswap = b; }
+void dma_channel_start(uint c) { chans[c].busy = true; }
+void dma_channel_configure(uint c, const dma_channel_config *cfg, volatile void *w, const volatile void *r,
+                           uint n, bool trigger)
+{
+    chans[c].cfg = *cfg;
+    chans[c].w = w;
+    chans[c].r = r;
+    chans[c].n = n;
+    if (trigger)
+        dma_channel_start(c);
+}
+void dma_channel_set_read_addr(uint c, const volatile void *r, bool trigger)
+{
+    chans[c].r = r;
+    if (trigger)
+        dma_channel_start(c);
+}
+void dma_channel_set_trans_count(uint c, uint32_t n, bool trigger)
+{
+    chans[c].n = n;
+    if (trigger)
+        dma_channel_start(c);
+}
+void dma_channel_transfer_from_buffer_now(uint c, const volatile void *r, uint32_t n)
+{
+    chans[c].r = r;
+    chans[c].n = n;
+    dma_channel_start(c);
+}
+
+static spi_inst *spiOf(volatile void *w)
+{
+    if (w == &s0.hw.dr)
+        return &s0;
+    if (w == &s1.hw.dr)
+        return &s1;
+    return nullptr;
+}
+
+static int pioOf(volatile void *w, PIO *p)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        if (w == &p0hw.txf[i])
+        {
+            *p = pio0;
+            return i;
+        }
+        if (w == &p1hw.txf[i])
+        {
+            *p = pio1;
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void dmaRun(uint c)
+{
+    Chan &k = chans[c];
+    int size = 1 << k.cfg.size;
+    const uint8_t *r = (const uint8_t *)k.r;
+    uint8_t *w = (uint8_t *)k.w;
+    spi_inst *s = spiOf(k.w);
+    PIO p = nullptr;
+    int sm = pioOf(k.w, &p);
+    for (uint32_t i = 0; i < k.n; i++)
+    {
+        uint32_t v = 0;
+        memcpy(&v, r, size);
+        if (k.cfg.bswap)
+            v = size == 2 ? __builtin_bswap16(v) : size == 4 ? __builtin_bswap32(v) : v;
+        if (s)
+        {
+            if (sim_strict_format && (int)s->bits != 8 * size)
+            {
+                fprintf(stderr, "DMA size %d in %u-bit mode\n", size, s->bits);
+                abort();
+            }
+            spiPush(s, v);
+        }
+        else if (sm >= 0)
+        {
+            // Narrow writes to a FIFO are replicated across the word, as on the bus
+            if (size == 2)
+                v |= v << 16;
+            if (size == 1)
+                v *= 0x01010101u;
+            if (sim_pio_put)
+                sim_pio_put(p, sm, v);
+        }
+        else
+            memcpy(w, &v, size);
+        if (k.cfg.rinc)
+            r += size;
+        if (k.cfg.winc)
+            w += size;
+    }
+    k.busy = false;
+    if (k.irq0)
+    {
+        k.st0 = true;
+        for (auto h : irqHandlers[DMA_IRQ_0])
+            h();
+    }
+    if (k.irq1)
+    {
+        k.st1 = true;
+        for (auto h : irqHandlers[DMA_IRQ_1])
+            h();
+    }
+    if (k.cfg.chain != c)
+        dma_channel_start(k.cfg.chain);
+}
+
+static std::recursive_mutex simMutex;
+
+void sim_tick()
+{
+    std::lock_guard<std::recursive_mutex> lock(simMutex);
+    for (bool any = true; any;)
+    {
+        any = false;
+        for (uint c = 0; c < 12; c++)
+            if (chans[c].busy)
+            {
+                dmaRun(c);
+                any = true;
+            }
+    }
+    runAlarms();
+}
+
+void tight_loop_contents()
+{
+    sim_time_us += 1;
+    sim_tick();
+}
+void dma_channel_wait_for_finish_blocking(uint c)
+{
+    while (chans[c].busy)
+        sim_tick();
+}
+bool dma_channel_is_busy(uint c) { return chans[c].busy; }
+void dma_channel_set_irq0_enabled(uint c, bool e) { chans[c].irq0 = e; }
+void dma_channel_set_irq1_enabled(uint c, bool e) { chans[c].irq1 = e; }
+bool dma_channel_get_irq0_status(uint c) { return chans[c].st0; }
+bool dma_channel_get_irq1_status(uint c) { return chans[c].st1; }
+void dma_channel_acknowledge_irq0(uint c) { chans[c].st0 = false; }
+void dma_channel_acknowledge_irq1(uint c) { chans[c].st1 = false; }
+void dma_channel_abort(uint c) { chans[c].busy = false; }
+
+// ---- Multicore: core 1 is a detached thread
+
+static thread_local uint simCore = 0;
+void multicore_launch_core1(void (*entry)(void))
+{
+    std::thread([entry] {
+        simCore = 1;
+        entry();
+    }).detach();
+}
+void multicore_reset_core1() {}
+uint get_core_num() { return simCore; }
+uint32_t clock_get_hz(int) { return 125000000; }
+
+// ---- PIO: instruction memory and state machines are counted, not run
+
+static uint8_t pioUsed[2];
+static bool pioSm[2][4];
+
+static int pioIndex(PIO p) { return p == pio1; }
+
+bool pio_can_add_program(PIO p, const pio_program_t *prog) { return pioUsed[pioIndex(p)] + prog->length <= 32; }
+uint pio_add_program(PIO p, const pio_program_t *prog)
+{
+    if (!pio_can_add_program(p, prog))
+    {
+        fprintf(stderr, "no program space\n");
+        abort();
+    }
+    uint offset = pioUsed[pioIndex(p)];
+    pioUsed[pioIndex(p)] += prog->length;
+    sim_pio_programs++;
+    return offset;
+}
+void pio_remove_program(PIO p, const pio_program_t *prog, uint)
+{
+    pioUsed[pioIndex(p)] -= prog->length;
+    sim_pio_programs--;
+}
+int pio_claim_unused_sm(PIO p, bool required)
+{
+    for (int i = 0; i < 4; i++)
+        if (!pioSm[pioIndex(p)][i])
+        {
+            pioSm[pioIndex(p)][i] = true;
+            sim_pio_claimed++;
+            return i;
+        }
+    if (required)
+    {
+        fprintf(stderr, "no free state machine\n");
+        abort();
+    }
+    return -1;
+}
+void pio_sm_unclaim(PIO p, uint sm)
+{
+    pioSm[pioIndex(p)][sm] = false;
+    sim_pio_claimed--;
+}
+void pio_gpio_init(PIO, uint) {}
+void pio_sm_set_consecutive_pindirs(PIO, uint, uint, uint, bool) {}
+void pio_sm_set_pins_with_mask(PIO, uint, uint32_t, uint32_t) {}
+void pio_sm_init(PIO, uint, uint, const pio_sm_config *) {}
+void pio_sm_set_enabled(PIO, uint, bool) {}
+void pio_sm_put_blocking(PIO p, uint sm, uint32_t v)
+{
+    if (sim_pio_put)
+        sim_pio_put(p, sm, v);
+}
+bool pio_sm_is_tx_fifo_empty(PIO, uint) { return true; }
+uint pio_get_dreq(PIO, uint sm, bool) { return sm; }
+void sm_config_set_sideset_pins(pio_sm_config *, uint) {}
+void sm_config_set_out_pins(pio_sm_config *, uint, uint) {}
+void sm_config_set_set_pins(pio_sm_config *, uint, uint) {}
+void sm_config_set_clkdiv(pio_sm_config *, float) {}
+void sm_config_set_out_shift(pio_sm_config *, bool, bool, uint) {}
+void sm_config_set_fifo_join(pio_sm_config *, int) {}
+void sm_config_set_wrap(pio_sm_config *, uint, uint) {}
+void sm_config_set_sideset(pio_sm_config *, uint, bool, bool) {}
+pio_sm_config pio_get_default_sm_config() { return {}; }
@@ -0,0 +1,48 @@
+// Host-side stand-in for the RP2040 peripherals the library uses.
+//
+// The Pico SDK headers in this directory declare just enough of the SDK for
+// lib/ to compile on a PC. sim.cpp implements them against a byte-level model
+// of an ST7789: SPI and DMA writes land in sim_gram, alarms and DMA
+// completions run from sim_tick(), and time only advances when the library
+// waits (tight_loop_contents(), sleep_us()) or a test moves sim_time_us.
+
+#pragma once
+#include <stdint.h>
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+
+/** @brief Traffic seen by the panel model since the last sim_reset_stats() */
+struct SimStats
+{
+    uint64_t bytes;      ///< Bytes clocked into the panel (commands and data)
+    uint64_t cmds;       ///< Command bytes
+    uint64_t windows;    ///< CASET commands
+    uint64_t fmtChanges; ///< spi_set_format() calls
+    uint64_t csToggles;  ///< Edges on the CS pin
+};
+extern SimStats sim_stats;
+void sim_reset_stats();
+
+extern int sim_dc_pin, sim_cs_pin; ///< GPIOs the panel model treats as DC and CS
+extern uint16_t sim_gram[320][240]; ///< Panel frame memory, [row][column]
+extern uint16_t sim_vscsad, sim_tfa, sim_vsa; ///< Vertical scroll registers
+extern uint8_t sim_colmod, sim_madctl;
+extern uint64_t sim_time_us;    ///< Simulated time returned by time_us_64()
+extern bool sim_strict_format;  ///< Abort on writes that do not match the SPI frame size
+extern int sim_pio_programs;    ///< Programs currently loaded into either PIO
+extern int sim_pio_claimed;     ///< State machines currently claimed
+
+/** @brief Complete pending DMA and run alarms that are due */
+void sim_tick();
+
+/** @brief Raise a GPIO interrupt as if the pin saw the given edges */
+void sim_fire_gpio_irq(uint32_t gpio, uint32_t events);
+
+/** @brief Clock one byte into the panel model with the given DC level */
+void sim_panel_write(bool dc, uint8_t b);
+
+/**
+ * @brief Receives every word written to a PIO TX FIFO
+ * @note Weak and unset by default; a test defines it to model the program.
+ */
+extern void sim_pio_put(PIO pio, uint sm, uint32_t word) __attribute__((weak));
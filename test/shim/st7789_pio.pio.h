@@ -0,0 +1,28 @@
+// Host shim for the header pioasm generates from lib/st7789_pio.pio
+#pragma once
+#include "hardware/pio.h"
+#define st7789_pio_offset_start 0u
+static const uint16_t st7789_pio_program_instructions[18] = {0};
+static const struct pio_program st7789_pio_program = {st7789_pio_program_instructions, 18, -1};
+static inline pio_sm_config st7789_pio_program_get_default_config(uint) { return pio_get_default_sm_config(); }
+static inline void st7789_pio_program_init(PIO pio, uint sm, uint offset, uint pin_data, uint pin_clk,
+                                           uint pin_dc, float clk_div)
+{
+    pio_gpio_init(pio, pin_data);
+    pio_gpio_init(pio, pin_clk);
+    pio_gpio_init(pio, pin_dc);
+    pio_sm_set_pins_with_mask(pio, sm, (1u << pin_clk) | (1u << pin_dc), (1u << pin_clk) | (1u << pin_dc));
+    pio_sm_set_consecutive_pindirs(pio, sm, pin_data, 1, true);
+    pio_sm_set_consecutive_pindirs(pio, sm, pin_clk, 1, true);
+    pio_sm_set_consecutive_pindirs(pio, sm, pin_dc, 1, true);
+
+    pio_sm_config c = st7789_pio_program_get_default_config(offset);
+    sm_config_set_sideset_pins(&c, pin_clk);
+    sm_config_set_out_pins(&c, pin_data, 1);
+    sm_config_set_set_pins(&c, pin_dc, 1);
+    sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_TX);
+    sm_config_set_clkdiv(&c, clk_div);
+    sm_config_set_out_shift(&c, false, true, 32); // MSB first, autopull
+    pio_sm_init(pio, sm, offset + st7789_pio_offset_start, &c);
+    pio_sm_set_enabled(pio, sm, true);
+}
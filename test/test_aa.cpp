@@ -0,0 +1,120 @@
+// Anti-aliased lines and circles: coverage within a few percent of the exact
+// distance to the ideal curve, the same pixels in band mode, and the time
+// to draw a gauge frame.
+
+#include "test_common.h"
+#include <math.h>
+
+static uint16_t ref[320][170];
+
+// Coverage of a white-on-black pixel, from the 6-bit green channel
+static double coverage(int x, int y) { return ((gram(x, y) >> 5) & 63) / 63.0; }
+
+// Track the worst error of the pixels around one step q of a line, whose
+// ideal position on the minor axis is pf; coverage should be 1 - distance
+static void minorAxis(double &worst, bool steep, int q, double pf)
+{
+    for (int p = (int)floor(pf) - 1; p <= (int)floor(pf) + 2; p++)
+        if (p >= 0 && p < (steep ? 170 : 320))
+            worst = fmax(worst, fabs((steep ? coverage(p, q) : coverage(q, p)) - fmax(0.0, 1 - fabs(p - pf))));
+}
+
+static void draw()
+{
+    GFX_flush();
+    LCD_waitWrite();
+}
+
+static void scene()
+{
+    GFX_fillScreen(0);
+    srand(4);
+    for (int i = 0; i < 60; i++)
+        GFX_drawLineAA(rand() % 220 - 25, rand() % 360 - 20, rand() % 220 - 25, rand() % 360 - 20, rand());
+    for (int i = 0; i < 20; i++)
+        GFX_drawCircleAA(rand() % 170, rand() % 320, rand() % 80, rand());
+}
+
+int main()
+{
+    setup();
+    GFX_createFramebuf(false);
+
+    // Lines: compare each column (or row, for steep lines) with 1 - distance
+    srand(2);
+    double worst = 0;
+    for (int k = 0; k < 200; k++)
+    {
+        int x0 = rand() % 170, y0 = rand() % 320, x1 = rand() % 170, y1 = rand() % 320;
+        int dx = x1 - x0, dy = y1 - y0;
+        GFX_fillScreen(0);
+        GFX_drawLineAA(x0, y0, x1, y1, 0xFFFF);
+        draw();
+        if (dx != 0 && abs(dx) >= abs(dy))
+            for (int x = x0 < x1 ? x0 : x1; x <= (x0 < x1 ? x1 : x0); x++)
+                minorAxis(worst, false, x, y0 + (double)(x - x0) * dy / dx);
+        else if (dy != 0)
+            for (int y = y0 < y1 ? y0 : y1; y <= (y0 < y1 ? y1 : y0); y++)
+                minorAxis(worst, true, y, x0 + (double)(y - y0) * dx / dy);
+    }
+    printf("line   worst coverage error %.3f\n", worst);
+    CHECK(worst < 0.07);
+
+    // Circles: the octant below the centre, and its mirror on the left
+    worst = 0;
+    for (int r = 0; r < 80; r += 3)
+    {
+        GFX_fillScreen(0);
+        GFX_drawCircleAA(85, 160, r, 0xFFFF);
+        draw();
+        for (int x = 0; x <= r * 0.7; x++)
+        {
+            double yf = sqrt((double)r * r - x * x);
+            for (int y = (int)floor(yf) - 1; y <= (int)floor(yf) + 2; y++)
+            {
+                if (y < x)
+                    continue;
+                double e = fmax(0.0, 1 - fabs(y - yf));
+                worst = fmax(worst, fabs(coverage(85 + x, 160 + y) - e));
+                worst = fmax(worst, fabs(coverage(85 - y, 160 - x) - e));
+            }
+        }
+    }
+    printf("circle worst coverage error %.3f\n", worst);
+    CHECK(worst < 0.07);
+
+    // Band mode, with shapes clipped by the screen edges and the strips
+    scene();
+    draw();
+    for (int y = 0; y < 320; y++)
+        for (int x = 0; x < 170; x++)
+            ref[y][x] = gram(x, y);
+    GFX_destroyFramebuf();
+    CHECK(GFX_createBandBuffer(16, 200));
+    GFX_setClearColor(0);
+    scene();
+    draw();
+    for (int y = 0; y < 320; y++)
+        for (int x = 0; x < 170; x++)
+            CHECK(gram(x, y) == ref[y][x]);
+    GFX_destroyFramebuf();
+
+    // Throughput: a gauge of 60 radial needles inside two rings
+    const int frames = 300;
+    GFX_createFramebuf(false);
+    double t = seconds();
+    for (int f = 0; f < frames; f++)
+    {
+        for (int i = 0; i < 60; i++)
+        {
+            double a = i * 0.1 + f * 0.01;
+            GFX_drawLineAA(85, 160, 85 + 80 * cos(a), 160 + 80 * sin(a), 0xFFFF);
+        }
+        GFX_drawCircleAA(85, 160, 82, 0xFFFF);
+        GFX_drawCircleAA(85, 160, 60, 0xFFFF);
+    }
+    t = seconds() - t;
+    GFX_destroyFramebuf();
+    printf("gauge frame %.1f us (60 AA lines, 2 AA circles)\n", t * 1e6 / frames);
+    printf("aa OK\n");
+}
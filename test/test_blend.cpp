@@ -0,0 +1,187 @@
+// Alpha blending: the two-pixel SWAR kernel behind the *Alpha functions must
+// match a plain per-channel blend exactly, in the framebuffer and in bands.
+// Benchmarks the kernel against that per-channel blend.
+
+#include "test_common.h"
+
+extern uint16_t *gfxFramebuffer;
+
+// Per-channel reference; alpha is rounded to the kernel's 5 bits
+static uint16_t naive(uint16_t b, uint16_t f, uint8_t alpha)
+{
+    uint32_t a = (alpha + 4) >> 3;
+    uint32_t r = ((f >> 11) * a + (b >> 11) * (32 - a)) >> 5;
+    uint32_t g = (((f >> 5) & 63) * a + ((b >> 5) & 63) * (32 - a)) >> 5;
+    uint32_t bl = ((f & 31) * a + (b & 31) * (32 - a)) >> 5;
+    return r << 11 | g << 5 | bl;
+}
+
+static uint16_t ref[320][170];
+static uint16_t img[23][37];
+static uint8_t mask[17][29];
+
+static void blendRef(int x, int y, uint16_t c, uint8_t a)
+{
+    if (x >= 0 && x < 170 && y >= 0 && y < 320)
+        ref[y][x] = naive(ref[y][x], c, a);
+}
+
+static void background()
+{
+    srand(1);
+    for (int y = 0; y < 320; y++)
+        for (int x = 0; x < 170; x++)
+            ref[y][x] = rand();
+}
+
+// Random translucent shapes, drawn with the library or applied to ref
+static void scene(bool draw)
+{
+    srand(9);
+    for (int k = 0; k < 200; k++)
+    {
+        int x = rand() % 200 - 15, y = rand() % 340 - 10, w = rand() % 50, h = rand() % 50;
+        uint16_t c = rand();
+        uint8_t a = rand();
+        switch (rand() % 4)
+        {
+        case 0:
+            if (draw)
+                GFX_fillRectAlpha(x, y, w, h, c, a);
+            else if (a)
+                for (int j = y; j < y + h; j++)
+                    for (int i = x; i < x + w; i++)
+                        blendRef(i, j, c, a);
+            break;
+        case 1:
+            if (draw)
+                GFX_drawLineAlpha(x, y, x + w, y, c, a);
+            else if (a)
+                for (int i = x; i <= x + w; i++)
+                    blendRef(i, y, c, a);
+            break;
+        case 2:
+            if (draw)
+                GFX_drawRGBBitmapAlpha(x, y, &img[0][0], 37, 23, a);
+            else
+                for (int j = 0; j < 23; j++)
+                    for (int i = 0; i < 37; i++)
+                        blendRef(x + i, y + j, img[j][i], a);
+            break;
+        case 3:
+            if (draw)
+                GFX_drawAlphaMask(x, y, &mask[0][0], 29, 17, c);
+            else
+                for (int j = 0; j < 17; j++)
+                    for (int i = 0; i < 29; i++)
+                        blendRef(x + i, y + j, c, mask[j][i]);
+            break;
+        }
+    }
+}
+
+static bool matches()
+{
+    GFX_flush();
+    LCD_waitWrite();
+    for (int y = 0; y < 320; y++)
+        for (int x = 0; x < 170; x++)
+            if (gram(x, y) != ref[y][x])
+            {
+                printf("pixel %d,%d is %04x, expected %04x\n", x, y, gram(x, y), ref[y][x]);
+                return false;
+            }
+    return true;
+}
+
+int main()
+{
+    setup();
+    for (auto &row : img)
+        for (auto &p : row)
+            p = rand();
+    for (auto &row : mask)
+        for (auto &m : row)
+            m = rand();
+    mask[0][0] = 0;
+    mask[0][1] = 255;
+
+    static uint16_t base[320][170];
+    GFX_createFramebuf(false);
+    background();
+    memcpy(base, ref, sizeof base);
+    GFX_drawRGBBitmapAlpha(0, 0, &base[0][0], 170, 320, 255);
+    scene(true);
+    scene(false);
+    CHECK(matches());
+
+    // A diagonal translucent line covers the pixels of the opaque one
+    GFX_fillScreen(0);
+    GFX_drawLine(3, 7, 150, 290, 0xFFFF);
+    GFX_flush();
+    LCD_waitWrite();
+    for (int y = 0; y < 320; y++)
+        for (int x = 0; x < 170; x++)
+            ref[y][x] = gram(x, y) ? naive(0, 0xF81F, 100) : 0;
+    GFX_fillScreen(0);
+    GFX_drawLineAlpha(3, 7, 150, 290, 0xF81F, 100);
+    CHECK(matches());
+    GFX_destroyFramebuf();
+
+    // Band mode blends over the strip as each call replays
+    CHECK(GFX_createBandBuffer(16, 400));
+    background();
+    GFX_drawRGBBitmapAlpha(0, 0, &base[0][0], 170, 320, 255);
+    scene(true);
+    scene(false);
+    CHECK(matches());
+    GFX_destroyFramebuf();
+
+    // Without a framebuffer alpha is thresholded at half
+    GFX_fillRectAlpha(0, 0, 10, 10, 0x1234, 200);
+    GFX_fillRectAlpha(20, 0, 10, 10, 0x1234, 60);
+    LCD_waitWrite();
+    CHECK(gram(5, 5) == 0x1234 && gram(25, 5) != 0x1234);
+
+    // Indexed framebuffer: colors are palette indices, thresholded like the
+    // panel, and an RGB565 image has no indices to draw
+    CHECK(GFX_createIndexedFramebuf());
+    GFX_fillScreen(5);
+    GFX_fillRectAlpha(0, 0, 10, 10, 9, 200);
+    GFX_fillRectAlpha(20, 0, 10, 10, 9, 60);
+    GFX_drawRGBBitmapAlpha(40, 0, &img[0][0], 37, 23, 255);
+    GFX_drawRGBBitmapAlpha(80, 0, &img[0][0], 37, 23, 100);
+    GFX_flush();
+    LCD_waitWrite();
+    for (int y = 0; y < 320; y++)
+        for (int x = 0; x < 170; x++)
+            CHECK(gram(x, y) == GFX_getPalette(x < 10 && y < 10 ? 9 : 5));
+    GFX_destroyFramebuf();
+
+    // Benchmark: a translucent full-screen overlay. The odd start column keeps
+    // the kernel's unaligned edge pixel in the measurement.
+    const int reps = 300;
+    const double pixels = reps * 169.0 * 320;
+    GFX_createFramebuf(false);
+    double t = seconds();
+    for (int r = 0; r < reps; r++)
+        GFX_fillRectAlpha(1, 0, 169, 320, 0x1234 + r, 100);
+    double swar = seconds() - t;
+    t = seconds();
+    for (int r = 0; r < reps; r++)
+        for (int y = 0; y < 320; y++)
+        {
+            uint16_t *p = gfxFramebuffer + y * 170;
+            for (int x = 1; x < 170; x++)
+                p[x] = naive(p[x], 0x1234 + r, 100);
+        }
+    double perChannel = seconds() - t;
+    t = seconds();
+    for (int r = 0; r < reps * 20; r++)
+        GFX_drawAlphaMask(r % 140, r % 300, &mask[0][0], 29, 17, 0x1234 + r);
+    double masked = seconds() - t;
+    GFX_destroyFramebuf();
+    printf("constant alpha %6.0f Mpixel/s (per-channel %5.0f)\n", pixels / swar / 1e6, pixels / perChannel / 1e6);
+    printf("A8 mask        %6.0f Mpixel/s\n", reps * 20 * 29.0 * 17 / masked / 1e6);
+    printf("blend OK\n");
+}
@@ -0,0 +1,55 @@
+// Boot time: blocking init versus LCD_initDisplayAsync() with the first frame
+// prepared meanwhile, in simulated microseconds to the first pixel.
+
+#include "test_common.h"
+
+#define ASSET_US 120000 // stand-in for decoding assets before the first frame
+
+static void prepareFrame()
+{
+    for (int i = 0; i < ASSET_US / 100; i++)
+        sleep_us(100); // alarms run as time passes
+    GFX_fillScreen(0x1234);
+    GFX_drawPixel(7, 9, 0xBEEF);
+}
+
+int main()
+{
+    sim_dc_pin = 4;
+    sim_cs_pin = 1;
+    LCD_setPins(4, 1, 5, 2, 3);
+    LCD_setSPIperiph(spi0);
+
+    // Blocking: init, then prepare, then flush
+    uint64_t t0 = sim_time_us;
+    LCD_initDisplay(170, 320);
+    CHECK(LCD_isInitDone() && LCD_getInitTime() >= 155000);
+    GFX_createFramebuf(false);
+    prepareFrame();
+    GFX_flush();
+    uint64_t blocking = sim_time_us - t0;
+    CHECK(gram(7, 9) == 0xBEEF);
+    GFX_destroyFramebuf();
+
+    // Async: prepare while the panel resets, flush once it is ready
+    memset(sim_gram, 0, sizeof sim_gram);
+    sim_madctl = 0xFF;
+    t0 = sim_time_us;
+    LCD_initDisplayAsync(170, 320);
+    CHECK(sim_time_us - t0 < 1000); // returns at once
+    CHECK(!LCD_isInitDone() && !LCD_isWriteDone());
+    GFX_createFramebuf(false);
+    prepareFrame();
+    CHECK(!LCD_isInitDone());
+    GFX_flush(); // waits for the panel
+    uint64_t async = sim_time_us - t0;
+    CHECK(LCD_isInitDone() && LCD_getInitTime() >= 155000);
+    CHECK(gram(0, 0) == 0x1234 && gram(7, 9) == 0xBEEF && gram(169, 319) == 0x1234);
+    CHECK(sim_madctl == 0); // rotation 2 applied at the end of the sequence
+
+    printf("init %u us; first pixel after %llu us blocking, %llu us async (%llu us of assets)\n",
+           (unsigned)LCD_getInitTime(), (unsigned long long)blocking, (unsigned long long)async,
+           (unsigned long long)ASSET_US);
+    CHECK(async + ASSET_US * 9 / 10 < blocking);
+    printf("boot OK\n");
+}
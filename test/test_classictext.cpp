@@ -0,0 +1,161 @@
+// Classic font strings are drawn a pixel row at a time straight into the
+// framebuffer. The result must match drawing the same characters one at a
+// time through the per-character renderer, bit for bit.
+
+#include "test_common.h"
+
+extern uint8_t textsize_x, textsize_y, wrap;
+
+static uint16_t ref[320][170];
+
+// A random string of up to max characters, without line breaks if flat
+static void randomString(char *buf, int max, bool flat)
+{
+    int n = rand() % max;
+    for (int k = 0; k < n; k++)
+        buf[k] = !flat && rand() % 8 == 0 ? '\n' : (char)(rand() % 255 + 1);
+    buf[n] = 0;
+    if (flat)
+        for (int k = 0; k < n; k++)
+            if (buf[k] == '\n' || buf[k] == '\r')
+                buf[k] = 'x';
+}
+
+// Sizes 1-3 in each direction, opaque or transparent
+static void randomStyle(uint16_t &color, uint16_t &bg)
+{
+    textsize_x = 1 + rand() % 3;
+    textsize_y = 1 + rand() % 3;
+    color = rand();
+    bg = rand() % 2 ? color : (uint16_t)rand();
+    GFX_setTextColor(color);
+    GFX_setTextBack(bg);
+}
+
+static void capture()
+{
+    GFX_flush();
+    LCD_waitWrite();
+    for (int y = 0; y < 320; y++)
+        for (int x = 0; x < 170; x++)
+            ref[y][x] = gram(x, y);
+}
+
+static bool matches()
+{
+    GFX_flush();
+    LCD_waitWrite();
+    for (int y = 0; y < 320; y++)
+        for (int x = 0; x < 170; x++)
+            if (gram(x, y) != ref[y][x])
+            {
+                printf("pixel %d,%d is %04x, expected %04x\n", x, y, gram(x, y), ref[y][x]);
+                return false;
+            }
+    return true;
+}
+
+// Lines of text, partly off screen, each drawn as a string or as the same
+// characters through GFX_drawChar()
+static void lines(bool asString, int clip)
+{
+    srand(22 + clip);
+    GFX_fillScreen(0x0841);
+    if (clip == 1)
+        GFX_pushClip(13, 27, 120, 200);
+    if (clip == 2)
+        GFX_pushViewport(13, 27, 120, 200);
+    for (int i = 0; i < 300; i++)
+    {
+        char buf[40];
+        int16_t x = rand() % 220 - 40, y = rand() % 360 - 20;
+        uint16_t color, bg;
+        randomStyle(color, bg);
+        randomString(buf, 40, true);
+        if (asString)
+        {
+            GFX_setCursor(x, y);
+            GFX_printf("%s", buf);
+        }
+        else
+            for (int k = 0; buf[k]; k++)
+                GFX_drawChar(x + k * 6 * textsize_x, y, buf[k], color, bg, textsize_x, textsize_y);
+    }
+    if (clip)
+        GFX_popClip();
+}
+
+// Wrapped text with line breaks; the reference draws straight to the panel,
+// where GFX_write() takes one character at a time
+static void paragraphs(bool viewport)
+{
+    srand(12);
+    GFX_fillScreen(0x0841);
+    if (viewport)
+        GFX_pushViewport(13, 27, 120, 200);
+    for (int i = 0; i < 150; i++)
+    {
+        char buf[64];
+        uint16_t color, bg;
+        GFX_setCursor(rand() % 220 - 30, rand() % 360 - 20);
+        randomStyle(color, bg);
+        randomString(buf, 64, false);
+        GFX_printf("%s", buf);
+        GFX_write('Q');
+    }
+    if (viewport)
+        GFX_popClip();
+}
+
+int main()
+{
+    setup();
+    GFX_setFont(NULL);
+    wrap = 0;
+    GFX_createFramebuf(false);
+    for (int clip = 0; clip < 3; clip++)
+    {
+        lines(false, clip);
+        capture();
+        lines(true, clip);
+        CHECK(matches());
+    }
+    GFX_destroyFramebuf();
+
+    wrap = 1;
+    for (int viewport = 0; viewport < 2; viewport++)
+    {
+        paragraphs(viewport);
+        capture();
+        GFX_createFramebuf(false);
+        paragraphs(viewport);
+        CHECK(matches());
+        GFX_destroyFramebuf();
+    }
+
+    // Benchmark: a size 2 opaque status line, as a string and per character
+    const int reps = 20000;
+    GFX_createFramebuf(false);
+    textsize_x = textsize_y = 2;
+    GFX_setTextColor(0xFFFF);
+    GFX_setTextBack(0);
+    char buf[32];
+    double t = seconds();
+    for (int f = 0; f < reps; f++)
+    {
+        GFX_setCursor(0, 0);
+        GFX_printf("Frame: %d  abcdefg", f);
+    }
+    double string = seconds() - t;
+    t = seconds();
+    for (int f = 0; f < reps; f++)
+    {
+        snprintf(buf, sizeof buf, "Frame: %d  abcdefg", f);
+        for (int k = 0; buf[k]; k++)
+            GFX_drawChar(k * 12, 0, buf[k], 0xFFFF, 0, 2, 2);
+    }
+    double perChar = seconds() - t;
+    GFX_destroyFramebuf();
+    printf("string %.2f us per line, per character %.2f us\n", string * 1e6 / reps, perChar * 1e6 / reps);
+    printf("classictext OK\n");
+}
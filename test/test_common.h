@@ -0,0 +1,53 @@
+// Helpers shared by the host tests: panel setup, GRAM readback and CHECK.
+
+#pragma once
+#include "sim.h"
+#include "st7789.h"
+#include "gfx.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+extern int16_t _xstart, _ystart;
+
+/** @brief Fail the test with the expression and location if c is false */
+#define CHECK(c)                                                        \
+    do                                                                  \
+    {                                                                   \
+        if (!(c))                                                       \
+        {                                                               \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #c);         \
+            exit(1);                                                    \
+        }                                                               \
+    } while (0)
+
+/** @brief Wire the default display to the panel model and initialise it in rotation 2 */
+static inline void setup(uint16_t w = 170, uint16_t h = 320)
+{
+    sim_dc_pin = 4;
+    sim_cs_pin = 1;
+    LCD_setPins(4, 1, 5, 2, 3);
+    LCD_setSPIperiph(spi0);
+    LCD_initDisplay(w, h);
+    LCD_setRotation(2);
+}
+
+/** @brief Panel GRAM at logical (x, y) in rotation 2, which has MADCTL 0 */
+static inline uint16_t gram(int x, int y) { return sim_gram[y + _ystart][x + _xstart]; }
+
+/** @brief What the viewer sees at logical (x, y) in rotation 0 or 2, honouring vertical scroll */
+static inline uint16_t view(int x, int y, int rot)
+{
+    int p = rot == 2 ? y + _ystart : 319 - (y + _ystart);
+    int m = p;
+    if (p >= sim_tfa && p < sim_tfa + sim_vsa)
+        m = sim_tfa + (sim_vscsad - sim_tfa + (p - sim_tfa)) % sim_vsa;
+    return sim_gram[rot == 2 ? m : 319 - m][x + _xstart];
+}
+
+/** @brief Host wall-clock seconds, for the benchmarks */
+static inline double seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
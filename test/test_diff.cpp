@@ -0,0 +1,78 @@
+// Diff flush: bytes saved when only part of a status screen changes, for
+// RGB565 and indexed framebuffers, and full resends when they are needed.
+
+#include "test_common.h"
+
+static void frame(int n)
+{
+    GFX_fillScreen(0);
+    GFX_fillRect(0, 0, 170, 30, 0x001F); // title bar
+    GFX_setCursor(5, 10);
+    GFX_printf("Status");
+    GFX_setCursor(5, 100);
+    GFX_printf("count %d", n);
+    GFX_drawRect(10, 200, 150, 40, 0xFFFF);
+}
+
+static uint64_t flushBytes(void (*flush)())
+{
+    sim_reset_stats();
+    flush();
+    LCD_waitWrite();
+    return sim_stats.bytes;
+}
+
+int main()
+{
+    setup();
+    GFX_createFramebuf(false);
+    CHECK(GFX_setDiffFlush(true));
+    frame(0);
+    uint64_t full = flushBytes(GFX_flush);
+    CHECK(gram(0, 0) == 0x001F && gram(10, 200) == 0xFFFF);
+    frame(0);
+    uint64_t same = flushBytes(GFX_flush);
+    frame(1);
+    uint64_t changed = flushBytes(GFX_flush);
+    printf("565: full %llu bytes, unchanged %llu, counter changed %llu (%.1f%% of full)\n",
+           (unsigned long long)full, (unsigned long long)same, (unsigned long long)changed,
+           100.0 * changed / full);
+    CHECK(same == 0);
+    CHECK(changed > 0 && changed < full / 10);
+
+    // GFX_Update() goes through the diff too
+    memset(sim_gram, 0, sizeof sim_gram);
+    frame(1);
+    GFX_drawPixel(3, 150, 0xBEEF);
+    CHECK(flushBytes(GFX_Update) < full / 10);
+    CHECK(gram(3, 150) == 0xBEEF && gram(0, 0) == 0);
+
+    // A rotation change resends everything
+    LCD_setRotation(0);
+    frame(1);
+    CHECK(flushBytes(GFX_flush) == full);
+    LCD_setRotation(2);
+    frame(1);
+    CHECK(flushBytes(GFX_flush) == full);
+    GFX_destroyFramebuf();
+
+    // Indexed framebuffer, and a palette change resends
+    CHECK(GFX_createIndexedFramebuf());
+    CHECK(GFX_setDiffFlush(true));
+    frame(0);
+    full = flushBytes(GFX_flush);
+    frame(0);
+    same = flushBytes(GFX_flush);
+    frame(2);
+    changed = flushBytes(GFX_flush);
+    printf("indexed: full %llu bytes, unchanged %llu, counter changed %llu (%.1f%% of full)\n",
+           (unsigned long long)full, (unsigned long long)same, (unsigned long long)changed,
+           100.0 * changed / full);
+    CHECK(same == 0 && changed > 0 && changed < full / 10);
+    uint16_t red = 0xF800;
+    GFX_setPalette(0x1F, &red, 1);
+    frame(2);
+    flushBytes(GFX_flush);
+    CHECK(gram(0, 0) == 0xF800);
+    printf("diff OK\n");
+}
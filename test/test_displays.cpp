@@ -0,0 +1,115 @@
+// Several displays: per-display drawing state, interleaved updates, and a
+// background init that completes while another display is selected.
+
+#include "test_common.h"
+
+extern uint16_t textcolor;
+extern uint16_t *gfxFramebuffer;
+
+// Keep the default display busy with small writes for a while, the way a
+// program draws while another panel boots
+static void drawFor(uint64_t us)
+{
+    uint64_t end = sim_time_us + us;
+    for (int i = 0; sim_time_us < end; i++)
+    {
+        LCD_fillRect(i % 160, 0, 10, 10, (uint16_t)i);
+        LCD_waitWrite();
+        if (i % 50 == 0)
+        {
+            // A grouped write keeps CS low across waits
+            LCD_beginWrite();
+            LCD_fillRect(0, 20, 20, 20, 0x1111);
+            LCD_waitWrite();
+            sleep_us(500);
+            LCD_fillRect(0, 40, 20, 20, 0x2222);
+            LCD_endWrite();
+        }
+        sleep_us(200);
+    }
+}
+
+int main()
+{
+    setup(); // default display on spi0, CS 1
+    LCD_Display *a = LCD_getDisplay();
+
+    // Init of a display on its own bus runs while the default one is selected
+    LCD_Display *b = LCD_createDisplay();
+    CHECK(b);
+    LCD_selectDisplay(b);
+    LCD_setPins(4, 9, 5, 2, 3);
+    LCD_setSPIperiph(spi1);
+    LCD_initDisplayAsync(170, 320);
+    CHECK(!LCD_isInitDone() && !LCD_isDisplayIdle(b));
+    LCD_selectDisplay(a);
+    CHECK(LCD_isDisplayIdle(a) && !LCD_isDisplayIdle(b));
+    drawFor(300000);
+    CHECK(LCD_isDisplayIdle(b));
+    LCD_selectDisplay(b);
+    CHECK(LCD_isInitDone() && LCD_getInitTime() < 250000);
+
+    // Init of a display on the same bus as the selected one, which is busy
+    // drawing; the panel model listens to the second display's CS
+    LCD_Display *c = LCD_createDisplay();
+    CHECK(c);
+    LCD_selectDisplay(c);
+    LCD_setPins(4, 10, 5, 2, 3);
+    LCD_setSPIperiph(spi0);
+    sim_cs_pin = 10;
+    sim_madctl = 0xFF;
+    LCD_initDisplayAsync(170, 320);
+    LCD_selectDisplay(a);
+    drawFor(300000);
+    CHECK(LCD_isDisplayIdle(c));
+    CHECK(sim_madctl == 0); // the sequence ran to the end, rotation 2 included
+    LCD_selectDisplay(c);
+    CHECK(LCD_isInitDone());
+    LCD_fillRect(0, 0, 170, 320, 0x0F0F);
+    LCD_waitWrite();
+    CHECK(gram(0, 0) == 0x0F0F && gram(169, 319) == 0x0F0F);
+    LCD_selectDisplay(a);
+    sim_cs_pin = 1;
+
+    // Per-display drawing state
+    CHECK(GFX_selectDisplay(b));
+    CHECK(LCD_getDisplay() == b);
+    GFX_createFramebuf(false);
+    uint16_t *fbB = gfxFramebuffer;
+    GFX_setTextColor(0x1234);
+    CHECK(GFX_selectDisplay(NULL));
+    CHECK(LCD_getDisplay() == a && textcolor == 0xFFFF && gfxFramebuffer == NULL);
+    GFX_createFramebuf(false);
+    CHECK(gfxFramebuffer != fbB);
+    GFX_selectDisplay(b);
+    CHECK(textcolor == 0x1234 && gfxFramebuffer == fbB);
+    GFX_selectDisplay(a);
+
+    // Interleaved updates; the panel model listens to one CS per pass
+    LCD_Display *both[] = {a, b};
+    for (int pass = 0; pass < 2; pass++)
+    {
+        sim_cs_pin = pass ? 9 : 1;
+        memset(sim_gram, 0, sizeof sim_gram);
+        GFX_selectDisplay(pass ? b : a);
+        GFX_fillScreen(pass ? 0x001F : 0xF800);
+        GFX_drawPixel(3, 7, 0xBEEF);
+        GFX_selectDisplay(pass ? a : b);
+        GFX_fillScreen(pass ? 0xF800 : 0x001F);
+        GFX_fillRect(10, 10, 5, 5, 0x7777);
+        GFX_selectDisplay(a);
+        GFX_updateDisplays(both, 2);
+        CHECK(LCD_getDisplay() == a);
+        CHECK(gram(0, 0) == (pass ? 0x001F : 0xF800) && gram(3, 7) == 0xBEEF);
+        CHECK(gram(12, 12) == (pass ? 0x001F : 0xF800) && gram(169, 319) == (pass ? 0x001F : 0xF800));
+
+        // Only damage goes out the second time
+        memset(sim_gram, 0, sizeof sim_gram);
+        GFX_selectDisplay(pass ? b : a);
+        GFX_drawPixel(5, 5, 0x4242);
+        GFX_selectDisplay(a);
+        GFX_updateDisplays(both, 2);
+        CHECK(gram(5, 5) == 0x4242 && gram(0, 0) == 0);
+    }
+    printf("displays OK\n");
+}
@@ -0,0 +1,129 @@
+// Span fills: GFX_fillRect and the fast lines against a per-pixel reference,
+// clipped and in the hardware scroll ring, plus a fill micro-benchmark.
+
+#include "test_common.h"
+
+extern uint16_t *gfxFramebuffer;
+
+static uint16_t ref[320][170];
+
+static void refFill(int x, int y, int w, int h, uint16_t c)
+{
+    for (int j = y; j < y + h; j++)
+        for (int i = x; i < x + w; i++)
+            if (i >= 0 && i < 170 && j >= 0 && j < 320)
+                ref[j][i] = c;
+}
+
+// What the fills replaced: one bounds-checked store per pixel
+static void naiveFill(int x, int y, int w, int h, uint16_t c)
+{
+    for (int i = x; i < x + w; i++)
+        for (int j = y; j < y + h; j++)
+            if (gfxFramebuffer != NULL && i >= 0 && i < 170 && j >= 0 && j < 320)
+                gfxFramebuffer[i + j * 170] = c;
+}
+
+static void correctness()
+{
+    srand(1);
+    for (int pass = 0; pass < 2; pass++)
+    {
+        if (pass == 1)
+            CHECK(GFX_setHardwareScroll(true));
+        GFX_fillScreen(0x1111);
+        refFill(0, 0, 170, 320, 0x1111);
+        if (pass == 1)
+        {
+            GFX_scrollUp(37); // the ring now starts mid buffer
+            for (int j = 0; j < 320; j++)
+                for (int i = 0; i < 170; i++)
+                    ref[j][i] = j < 283 ? 0x1111 : 0;
+        }
+        for (int k = 0; k < 3000; k++)
+        {
+            int x = rand() % 220 - 25, y = rand() % 380 - 30, w = rand() % 200 - 5, h = rand() % 360 - 5;
+            uint16_t c = rand();
+            switch (k % 3)
+            {
+            case 0:
+                GFX_fillRect(x, y, w, h, c);
+                refFill(x, y, w, h, c);
+                break;
+            case 1: // negative lengths extend left or up from the start
+                GFX_drawFastHLine(x, y, w, c);
+                refFill(w > 0 ? x : x + w + 1, y, w > 0 ? w : -w, 1, c);
+                break;
+            case 2:
+                GFX_drawFastVLine(x, y, h, c);
+                refFill(x, h > 0 ? y : y + h + 1, 1, h > 0 ? h : -h, c);
+                break;
+            }
+        }
+        GFX_drawLine(3, 5, 60, 5, 0xABCD);
+        refFill(3, 5, 58, 1, 0xABCD);
+        GFX_drawLine(60, 9, 3, 9, 0xABCE);
+        refFill(3, 9, 58, 1, 0xABCE);
+        GFX_drawLine(7, 300, 7, 250, 0xABCF);
+        refFill(7, 250, 1, 51, 0xABCF);
+        GFX_flush();
+        for (int j = 0; j < 320; j++)
+            for (int i = 0; i < 170; i++)
+                CHECK(view(i, j, 2) == ref[j][i]);
+    }
+    GFX_setHardwareScroll(false);
+}
+
+int main()
+{
+    setup();
+    GFX_createFramebuf(false);
+    correctness();
+
+    // Benchmark: full screens, random rectangles and lines
+    const int screens = 2000, rects = 200000, lines = 400000;
+    double t = seconds();
+    for (int i = 0; i < screens; i++)
+        GFX_fillScreen((uint16_t)i);
+    double fillScreen = seconds() - t;
+    t = seconds();
+    for (int i = 0; i < screens; i++)
+        naiveFill(0, 0, 170, 320, (uint16_t)i);
+    double naiveScreen = seconds() - t;
+
+    srand(3);
+    uint64_t area = 0;
+    t = seconds();
+    for (int i = 0; i < rects; i++)
+    {
+        int x = rand() % 200 - 15, y = rand() % 360 - 20, w = rand() % 60, h = rand() % 60;
+        GFX_fillRect(x, y, w, h, (uint16_t)i);
+        area += (uint64_t)w * h;
+    }
+    double fillRect = seconds() - t;
+    srand(3);
+    t = seconds();
+    for (int i = 0; i < rects; i++)
+    {
+        int x = rand() % 200 - 15, y = rand() % 360 - 20, w = rand() % 60, h = rand() % 60;
+        naiveFill(x, y, w, h, (uint16_t)i);
+    }
+    double naiveRect = seconds() - t;
+
+    t = seconds();
+    for (int i = 0; i < lines; i++)
+    {
+        GFX_drawFastHLine(i % 30, i % 320, 140, (uint16_t)i);
+        GFX_drawFastVLine(i % 170, i % 40, 280, (uint16_t)i);
+    }
+    double fastLines = seconds() - t;
+
+    // Full-width fills are one run and go to the DMA, which the shim copies
+    // byte by byte, so that line measures the simulator rather than the code
+    printf("fillScreen   %7.0f Mpixel/s (per-pixel %5.0f), simulated DMA\n", screens * 170.0 * 320 / fillScreen / 1e6,
+           screens * 170.0 * 320 / naiveScreen / 1e6);
+    printf("fillRect     %7.0f Mpixel/s (per-pixel %5.0f), random clipped rectangles\n", area / fillRect / 1e6,
+           area / naiveRect / 1e6);
+    printf("fast H/V     %7.0f Mpixel/s\n", lines * 420.0 / fastLines / 1e6);
+    printf("fill OK\n");
+}
@@ -0,0 +1,169 @@
+// The built-in printf formatter against the C library's: GFX_printLabel()
+// keeps the formatted text, so short results are compared as strings, and
+// long ones as rendered pixels. Benchmarks GFX_printf against vsnprintf.
+
+#include "test_common.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+static GFX_Label label;
+static uint16_t ref[320][170];
+static int fails;
+
+static void compareText(const char *want, const char *call)
+{
+    size_t n = strlen(want) < GFX_LABEL_CHARS ? strlen(want) : GFX_LABEL_CHARS;
+    if (label.len != n || memcmp(label.text, want, n) != 0)
+    {
+        printf("%s: got \"%.*s\", expected \"%.*s\"\n", call, label.len, (const char *)label.text, (int)n, want);
+        fails++;
+    }
+}
+
+// Formats of at most GFX_LABEL_CHARS characters
+#define EXPECT(...)                               \
+    do                                            \
+    {                                             \
+        char want[256];                           \
+        snprintf(want, sizeof want, __VA_ARGS__); \
+        GFX_printLabel(&label, __VA_ARGS__);      \
+        compareText(want, #__VA_ARGS__);          \
+    } while (0)
+
+static void capture()
+{
+    GFX_flush();
+    for (int y = 0; y < 320; y++)
+        for (int x = 0; x < 170; x++)
+            ref[y][x] = gram(x, y);
+}
+
+static bool sameAsCapture()
+{
+    GFX_flush();
+    for (int y = 0; y < 320; y++)
+        for (int x = 0; x < 170; x++)
+            if (gram(x, y) != ref[y][x])
+                return false;
+    return true;
+}
+
+static void writeString(const char *s)
+{
+    for (; *s; s++)
+        GFX_write(*s);
+}
+
+// Where the formatter deliberately differs from the C library
+#define EXPECT_AS(want, ...)                 \
+    do                                       \
+    {                                        \
+        GFX_printLabel(&label, __VA_ARGS__); \
+        compareText(want, #__VA_ARGS__);     \
+    } while (0)
+
+// Longer output, written in several runs: compare what GFX_printf draws
+#define EXPECT_DRAWN(...)                         \
+    do                                            \
+    {                                             \
+        char want[512];                           \
+        snprintf(want, sizeof want, __VA_ARGS__); \
+        GFX_clearScreen();                        \
+        GFX_setCursor(0, 0);                      \
+        writeString(want);                        \
+        capture();                                \
+        GFX_clearScreen();                        \
+        GFX_setCursor(0, 0);                      \
+        GFX_printf(__VA_ARGS__);                  \
+        if (!sameAsCapture())                     \
+        {                                         \
+            printf("%s: drawn differently\n", #__VA_ARGS__); \
+            fails++;                              \
+        }                                         \
+    } while (0)
+
+int main()
+{
+    setup();
+    GFX_createFramebuf(false);
+    GFX_setFont(NULL);
+    GFX_setTextColor(0xFFFF);
+    GFX_setTextBack(0);
+    GFX_setTextSize(1);
+    GFX_initLabel(&label, 0, 100);
+
+    EXPECT("Frame: %d", 42);
+    EXPECT("%d %i %d", -1, 0, INT32_MIN);
+    EXPECT("%5d|%-5d|%05d|%+d|% d", 42, 42, -42, 7, 7);
+    EXPECT("%u %x %X %o", 4000000000u, 0xdeadbeef, 0xabcu, 8u);
+    EXPECT("%#x %#o %#X", 255u, 8u, 0u);
+    EXPECT("%ld %lu", -123456789L, 123456789UL);
+    EXPECT("%lld", (long long)INT64_MIN);
+    EXPECT("%llu %llx", (unsigned long long)UINT64_MAX, 0x123456789abcULL);
+    EXPECT("%hd %hu %hhd %hhu", 70000, 70000, 300, 300);
+    EXPECT("%.3d|%.0d|%8.3d|%-8.3x|", 5, 0, -5, 10u);
+    EXPECT("%c%c%5c|%-3c|", 'A', 'b', 'z', 'q');
+    EXPECT("%s|%5s|%-5s|%.2s|", "hi", "hi", "hi", "hello");
+    EXPECT("%*s|%-*s|%*d|%-*d|", 6, "ab", 6, "ab", 6, 12, 6, 12);
+    EXPECT("%f %f %f", 0.0, 1.5, -2.25);
+    EXPECT("%f %.2f %.0f %.1f", 3.14159265, 12.345, 2.5001, 9.96);
+    EXPECT("%8.3f|%-8.2f|%08.2f", -1.5, 3.0, -3.14159);
+    EXPECT("%+.1f % .1f %.*f", 1.0, 1.0, 3, 2.71828);
+    EXPECT("%.9f %.3f", 0.123456789, 999.9996);
+    EXPECT("%f %F", 123456789.123, 1.25);
+    EXPECT("%#.0f %.4f", 3.0, 1e-5);
+    EXPECT("%f %f %5.1f", __builtin_nan(""), __builtin_inf(), -__builtin_inf());
+    EXPECT("%.1f%% %5.1fV %d.%02d", 45.67, 3.3, 12, 5);
+
+    // Sized modifiers followed by more arguments: reading one at the wrong
+    // width shifts everything after it. size_t and ptrdiff_t are the same
+    // size as long long on a 64-bit host, so build with -DST7789_TEST_M32=ON
+    // to see the difference the RP2040 has; lib/gfx.cpp checks the sizes at
+    // compile time either way.
+    EXPECT("%zu %d %zd %d", SIZE_MAX, 5, (ssize_t)-3, 6);
+    EXPECT("%td %d %jd %d", PTRDIFF_MIN, 7, INTMAX_MIN, 8);
+    EXPECT("%ju %d %zx %d", (uintmax_t)UINT64_MAX, 9, (size_t)0xabc, 10);
+    EXPECT("%lu %d %llu %d", 1UL, 11, 2ULL, 12);
+    EXPECT("%Lf %d %.2Lf %d", 1.5L, 13, -2.25L, 14);
+
+    // Unsupported conversions print as written but still take their
+    // argument, so the ones after them line up; %f stops at 9 decimals
+    int count = 0;
+    EXPECT_AS("%g 7 %e 8", "%g %d %e %d", 1.5, 7, 2.5, 8);
+    EXPECT_AS("%E %G %a %A 9", "%E %G %a %A %d", 1.0, 2.0, 3.0, 4.0, 9);
+    EXPECT_AS("%e ok %g 10", "%10.3e %s %Lg %d", 1e-7, "ok", 6.0L, 10);
+    EXPECT_AS("n%n 11", "n%n %d", &count, 11);
+    EXPECT_AS("0.123456789 12", "%.12f %d", 0.123456789012, 12);
+
+    // Longer than one text run, so the formatter hands over several
+    EXPECT_DRAWN("T=%6.2fC P=%7.1fhPa H=%3d%% id=%08X", 23.456, 1013.25, 55, 0xBEEFu);
+    EXPECT_DRAWN("%s%s%s", "0123456789012345678901234567890123456789012345678901234567890123456789",
+                 "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz", "END");
+    EXPECT_DRAWN("%d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d", 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+                 15, 16);
+    CHECK(fails == 0);
+
+    // Benchmark: format and draw a line off screen, so the text renderer's
+    // cost is small, directly and through a vsnprintf buffer
+    const int reps = 200000;
+    char buf[100];
+    double t = seconds();
+    for (int i = 0; i < reps; i++)
+    {
+        GFX_setCursor(0, 400);
+        GFX_printf("T=%6.2fC H=%3d%% n=%d", 23.456 + i * 0.01, i % 100, i);
+    }
+    double direct = seconds() - t;
+    t = seconds();
+    for (int i = 0; i < reps; i++)
+    {
+        snprintf(buf, sizeof buf, "T=%6.2fC H=%3d%% n=%d", 23.456 + i * 0.01, i % 100, i);
+        GFX_setCursor(0, 400);
+        writeString(buf);
+    }
+    double buffered = seconds() - t;
+    printf("GFX_printf %.0f ns per line, vsnprintf and GFX_write %.0f ns\n", direct * 1e9 / reps,
+           buffered * 1e9 / reps);
+    printf("format OK\n");
+}
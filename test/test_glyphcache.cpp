@@ -0,0 +1,149 @@
+// The glyph cache must not change a pixel: text drawn with the cache on,
+// including while it evicts glyphs, is compared with the uncached renderer
+// for the classic font and a GFXfont, at several sizes, clipped and in bands.
+
+#include "test_common.h"
+#include <initializer_list>
+
+// A test GFXfont 'a'..'z' of random glyphs. 'z' is a 15x12 grid of stripes,
+// too many runs for a cache slot, so it is always drawn uncached.
+static uint8_t bits[26 * 24];
+static GFXglyph glyphs[26];
+static GFXfont testFont = {bits, glyphs, 'a', 'z', 14};
+
+static uint16_t ref[320][170];
+
+static void makeFont()
+{
+    srand(21);
+    for (auto &b : bits)
+        b = rand();
+    for (int i = 0; i < 25; i++)
+        glyphs[i] = {(uint16_t)(i * 24), (uint8_t)(2 + i % 9), (uint8_t)(3 + i % 10), (uint8_t)(4 + i % 8),
+                     (int8_t)(i % 3 - 1), (int8_t)(-9 + i % 3)};
+    glyphs[25] = {25 * 24, 15, 12, 16, 0, -10};
+    memset(bits + 25 * 24, 0xAA, 24);
+}
+
+// Random characters of both fonts, sizes 1 to 4 by 1 to 3, opaque and
+// transparent, some partly off screen. More distinct glyphs than the small
+// caches below hold, so those keep evicting.
+static void scene()
+{
+    srand(8);
+    GFX_fillScreen(0x0101);
+    for (int i = 0; i < 600; i++)
+    {
+        int x = rand() % 200 - 15, y = rand() % 340 - 10;
+        uint8_t sx = 1 + rand() % 4, sy = 1 + rand() % 3;
+        uint16_t c = rand(), bg = rand() % 3 ? rand() : c;
+        bool classic = rand() % 2;
+        unsigned char ch = classic ? rand() % 256 : 'a' + rand() % 26;
+        GFX_setFont(classic ? NULL : &testFont);
+        if (rand() % 4 == 0)
+            GFX_drawChar(x, y, ch, c, bg, sx, sy);
+        else
+        {
+            GFX_setTextSize(sx);
+            GFX_setCursor(x, y);
+            GFX_setTextColor(c);
+            GFX_setTextBack(bg);
+            GFX_write(ch);
+        }
+    }
+    GFX_setFont(NULL);
+    GFX_setTextSize(1);
+}
+
+static void capture()
+{
+    GFX_flush();
+    LCD_waitWrite();
+    for (int y = 0; y < 320; y++)
+        for (int x = 0; x < 170; x++)
+            ref[y][x] = gram(x, y);
+}
+
+static bool matches()
+{
+    GFX_flush();
+    LCD_waitWrite();
+    for (int y = 0; y < 320; y++)
+        for (int x = 0; x < 170; x++)
+            if (gram(x, y) != ref[y][x])
+            {
+                printf("pixel %d,%d is %04x, expected %04x\n", x, y, gram(x, y), ref[y][x]);
+                return false;
+            }
+    return true;
+}
+
+static void clippedScene()
+{
+    GFX_pushClip(20, 30, 50, 60);
+    scene();
+    GFX_popClip();
+}
+
+int main()
+{
+    makeFont();
+    setup();
+    GFX_setClearColor(0x0101);
+
+    GFX_createFramebuf(false);
+    GFX_setGlyphCache(0);
+    scene();
+    capture();
+    for (uint16_t slots : {1, 8, 64})
+    {
+        CHECK(GFX_setGlyphCache(slots));
+        scene(); // fills the cache, evicting all along with few slots
+        CHECK(matches());
+        scene(); // now hits, or keeps cycling glyphs through
+        CHECK(matches());
+    }
+
+    GFX_setGlyphCache(0);
+    GFX_fillScreen(0);
+    clippedScene();
+    capture();
+    CHECK(GFX_setGlyphCache(16));
+    GFX_fillScreen(0);
+    clippedScene();
+    CHECK(matches());
+    GFX_destroyFramebuf();
+
+    // Band mode replays each glyph into several strips
+    CHECK(GFX_createBandBuffer(16, 700));
+    GFX_setGlyphCache(0);
+    scene();
+    capture();
+    CHECK(GFX_setGlyphCache(32));
+    scene();
+    CHECK(matches());
+    GFX_destroyFramebuf();
+
+    // Benchmark: a line of size 2 GFXfont text. Classic font strings are
+    // drawn row by row and do not go through the cache.
+    const int reps = 3000;
+    GFX_createFramebuf(false);
+    GFX_setFont(&testFont);
+    GFX_setTextSize(2);
+    GFX_setTextColor(0xFFFF);
+    for (uint16_t slots : {0, 96})
+    {
+        GFX_setGlyphCache(slots);
+        double t = seconds();
+        for (int f = 0; f < reps; f++)
+        {
+            GFX_setCursor(0, 40);
+            GFX_printf("frame abc hello");
+        }
+        printf("%-8s %.2f us per line\n", slots ? "cached" : "uncached", (seconds() - t) * 1e6 / reps);
+    }
+    GFX_setFont(NULL);
+    GFX_setGlyphCache(0);
+    GFX_destroyFramebuf();
+    printf("glyphcache OK\n");
+}
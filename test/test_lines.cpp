@@ -0,0 +1,111 @@
+// GFX_drawLine against the per-pixel Bresenham loop it replaced: the clipped
+// run-slice rasterizer must set exactly the same pixels, whether the clip
+// comes from GFX_pushClip, the screen edge or a band strip.
+
+#include "test_common.h"
+#include <utility>
+
+static uint16_t ref[320][170];
+
+// The previous writeLine(): walk every step, drop pixels outside the clip
+static void refLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color, int cx0, int cy0, int cx1,
+                    int cy1)
+{
+    int16_t steep = abs(y1 - y0) > abs(x1 - x0);
+    if (steep)
+    {
+        std::swap(x0, y0);
+        std::swap(x1, y1);
+    }
+    if (x0 > x1)
+    {
+        std::swap(x0, x1);
+        std::swap(y0, y1);
+    }
+    int16_t dx = x1 - x0, dy = abs(y1 - y0);
+    int16_t err = dx / 2, ystep = y0 < y1 ? 1 : -1;
+    for (; x0 <= x1; x0++)
+    {
+        int x = steep ? y0 : x0, y = steep ? x0 : y0;
+        if (x >= cx0 && y >= cy0 && x <= cx1 && y <= cy1)
+            ref[y][x] = color;
+        err -= dy;
+        if (err < 0)
+        {
+            y0 += ystep;
+            err += dx;
+        }
+    }
+}
+
+// Random endpoints within r of the screen centre; diagonal lines only, the
+// axis-aligned ones are spans and covered by test_fill
+static bool randomLine(int r, int16_t &x0, int16_t &y0, int16_t &x1, int16_t &y1)
+{
+    x0 = rand() % r - r / 2 + 85;
+    y0 = rand() % r - r / 2 + 160;
+    x1 = rand() % r - r / 2 + 85;
+    y1 = rand() % r - r / 2 + 160;
+    return x0 != x1 && y0 != y1;
+}
+
+static bool matches()
+{
+    GFX_flush();
+    LCD_waitWrite();
+    for (int y = 0; y < 320; y++)
+        for (int x = 0; x < 170; x++)
+            if (gram(x, y) != ref[y][x])
+            {
+                printf("pixel %d,%d is %04x, expected %04x\n", x, y, gram(x, y), ref[y][x]);
+                return false;
+            }
+    return true;
+}
+
+int main()
+{
+    setup();
+    GFX_createFramebuf(false);
+    srand(3);
+    int16_t x0, y0, x1, y1;
+
+    // Random clip rectangles; half the lines reach far off screen
+    for (int iter = 0; iter < 3000; iter++)
+    {
+        int cx = rand() % 3 ? 0 : rand() % 60, cy = rand() % 3 ? 0 : rand() % 100;
+        int cw = cx ? rand() % 100 + 1 : 170, ch = cy ? rand() % 200 + 1 : 320;
+        int cx1 = (cx + cw < 170 ? cx + cw : 170) - 1, cy1 = (cy + ch < 320 ? cy + ch : 320) - 1;
+        GFX_fillScreen(0);
+        memset(ref, 0, sizeof ref);
+        GFX_pushClip(cx, cy, cw, ch);
+        int r = iter < 1500 ? 400 : 3000;
+        for (int i = 0; i < 20; i++)
+        {
+            if (!randomLine(r, x0, y0, x1, y1))
+                continue;
+            uint16_t c = rand() | 1;
+            GFX_drawLine(x0, y0, x1, y1, c);
+            refLine(x0, y0, x1, y1, c, cx, cy, cx1, cy1);
+        }
+        GFX_popClip();
+        CHECK(matches());
+    }
+    GFX_destroyFramebuf();
+
+    // Band mode: each strip clips the minor axis part way along a line
+    CHECK(GFX_createBandBuffer(7, 500));
+    GFX_setClearColor(0);
+    memset(ref, 0, sizeof ref);
+    for (int i = 0; i < 200; i++)
+    {
+        if (!randomLine(700, x0, y0, x1, y1))
+            continue;
+        uint16_t c = rand() | 1;
+        GFX_drawLine(x0, y0, x1, y1, c);
+        refLine(x0, y0, x1, y1, c, 0, 0, 169, 319);
+    }
+    CHECK(matches());
+    GFX_destroyFramebuf();
+    printf("lines OK\n");
+}
@@ -0,0 +1,145 @@
+// PIO transport: the tagged word stream, decoded by a software model of
+// st7789_pio.pio into the panel model, and the transport's resource use.
+
+#include "test_common.h"
+#include "st7789_pio.h"
+#include <vector>
+
+// Header word layout, as st7789_pio.pio reads it:
+//   bit 31     DC level for the payload (0 = command, 1 = data)
+//   bit 30     1 = 16-bit pixels, one per word in the upper half
+//              0 = bytes, packed MSB first, four per word
+//   bits 29:0  pixels - 1, or payload bits - 1
+#define HDR_DC 0x80000000u
+#define HDR_PIXELS 0x40000000u
+#define HDR_COUNT 0x3FFFFFFFu
+
+static enum { HEADER, BYTES, PIXELS } state = HEADER;
+static bool dc;
+static uint32_t left;
+static std::vector<uint32_t> words;
+
+void sim_pio_put(PIO, uint, uint32_t v)
+{
+    words.push_back(v);
+    switch (state)
+    {
+    case HEADER:
+        dc = v & HDR_DC;
+        left = (v & HDR_COUNT) + 1;
+        state = v & HDR_PIXELS ? PIXELS : BYTES;
+        break;
+    case BYTES: // left counts bits; the rest of the last word is dropped
+        for (int i = 0; i < 4 && left; i++, left -= 8)
+            sim_panel_write(dc, v >> (24 - 8 * i));
+        if (!left)
+            state = HEADER;
+        break;
+    case PIXELS:
+        sim_panel_write(dc, v >> 24);
+        sim_panel_write(dc, v >> 16);
+        if (!--left)
+            state = HEADER;
+        break;
+    }
+}
+
+static void randomWrites(uint8_t mode)
+{
+    static uint16_t img[320 * 240];
+    srand(7);
+    for (auto &p : img)
+        p = rand();
+    LCD_initDisplay(170, 320, mode);
+    LCD_setRotation(2);
+    uint16_t mask = mode == ST7789_COLMOD_444 ? 0xF79E : 0xFFFF;
+    for (int it = 0; it < 300; it++)
+    {
+        int w = 1 + rand() % 60, h = 1 + rand() % 50, x = rand() % (170 - w), y = rand() % (320 - h);
+        int m = rand() % 4, stride = w + rand() % 5;
+        uint16_t c = rand();
+        switch (m)
+        {
+        case 0: LCD_WriteBitmapAsync(x, y, w, h, img, NULL); break;
+        case 1: LCD_WriteBitmapStride(x, y, w, h, img + 3, stride); break;
+        case 2: LCD_fillRect(x, y, w, h, c); break;
+        case 3: LCD_WritePixel(x, y, c); w = h = 1; break;
+        }
+        LCD_waitWrite();
+        CHECK(state == HEADER);
+        for (int j = 0; j < h; j++)
+            for (int i = 0; i < w; i++)
+            {
+                uint16_t e = m == 0 ? img[j * w + i] : m == 1 ? img[3 + j * stride + i] : c;
+                CHECK(gram(x + i, y + j) == (e & mask));
+            }
+    }
+}
+
+static int doneCalls;
+static void countDone(void *) { doneCalls++; }
+
+int main()
+{
+    const LCD_Transport *pio = LCD_pioTransport(pio0, 62500000);
+    LCD_setTransport(pio);
+    setup();
+    CHECK(sim_colmod == 0x55);
+
+    // One pixel, word by word: three commands and a one-pixel payload
+    words.clear();
+    LCD_WritePixel(3, 5, 0xBEEF);
+    uint16_t x = 3 + _xstart, y = 5 + _ystart;
+    const uint32_t expect[] = {
+        8 - 1, 0x2A000000,                                   // CASET, DC low, 8 bits
+        HDR_DC | (32 - 1), (uint32_t)x << 16 | x,            // x0, x1 as 4 bytes
+        8 - 1, 0x2B000000,                                   // RASET
+        HDR_DC | (32 - 1), (uint32_t)y << 16 | y,
+        8 - 1, 0x2C000000,                                   // RAMWR
+        HDR_DC | HDR_PIXELS | (1 - 1), 0xBEEFBEEF,           // one pixel, replicated by 16-bit DMA
+    };
+    CHECK(words.size() == sizeof expect / sizeof expect[0]);
+    for (size_t i = 0; i < words.size(); i++)
+    {
+        if (words[i] != expect[i])
+            printf("word %zu: %08x, expected %08x\n", i, (unsigned)words[i], (unsigned)expect[i]);
+        CHECK(words[i] == expect[i]);
+    }
+    CHECK(gram(3, 5) == 0xBEEF);
+
+    // A command with a partial last word: 3 bytes are 24 bits
+    words.clear();
+    uint8_t vscrdef[6] = {0, 0, 1, 0x40, 0, 0};
+    pio->command(ST77XX_VSCRDEF, vscrdef, 6);
+    const uint32_t expectCmd[] = {8 - 1, 0x33000000, HDR_DC | (48 - 1), 0x00000140, 0x00000000};
+    CHECK(words.size() == 5 && memcmp(words.data(), expectCmd, sizeof expectCmd) == 0);
+    CHECK(state == HEADER && sim_vsa == 0x140);
+
+    // Zero pixels: nothing is sent and done() still runs
+    words.clear();
+    pio->pixels(NULL, 0, false, countDone, NULL);
+    CHECK(doneCalls == 1 && words.empty() && !pio->busy());
+
+    randomWrites(ST7789_COLMOD_565);
+    randomWrites(ST7789_COLMOD_444);
+
+    // Every init above reused one program, state machine and channel pair
+    CHECK(sim_pio_programs == 1 && sim_pio_claimed == 1);
+
+    GFX_createFramebuf();
+    GFX_fillScreen(0x1234);
+    GFX_drawLine(0, 0, 169, 319, 0xFFFF);
+    GFX_flush();
+    CHECK(gram(5, 300) == (0x1234 & 0xF79E) && gram(169, 319) == 0xF79E);
+    GFX_destroyFramebuf();
+
+    // Moving to the other block releases the first one
+    LCD_setTransport(LCD_pioTransport(pio1, 62500000));
+    LCD_initDisplay(170, 320);
+    CHECK(sim_pio_programs == 1 && sim_pio_claimed == 1);
+    LCD_fillRect(0, 0, 10, 10, 0x4321);
+    LCD_waitWrite();
+    CHECK(gram(9, 9) == 0x4321);
+
+    printf("pio OK\n");
+}
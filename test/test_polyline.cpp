@@ -0,0 +1,147 @@
+// GFX_drawPolyline and GFX_drawSegments must match the same lines drawn one
+// GFX_drawLine call at a time; benchmarks both on 1k and 10k point series.
+
+#include "test_common.h"
+#include <math.h>
+
+static uint16_t ref[320][170];
+static int16_t xs[10000], ys[10000], seg[400];
+
+static void capture()
+{
+    GFX_flush();
+    LCD_waitWrite();
+    for (int y = 0; y < 320; y++)
+        for (int x = 0; x < 170; x++)
+            ref[y][x] = gram(x, y);
+}
+
+static bool matches()
+{
+    GFX_flush();
+    LCD_waitWrite();
+    for (int y = 0; y < 320; y++)
+        for (int x = 0; x < 170; x++)
+            if (gram(x, y) != ref[y][x])
+            {
+                printf("pixel %d,%d is %04x, expected %04x\n", x, y, gram(x, y), ref[y][x]);
+                return false;
+            }
+    return true;
+}
+
+static void viaLines(int n)
+{
+    GFX_fillScreen(0);
+    for (int i = 1; i < n; i++)
+        GFX_drawLine(xs[i - 1], ys[i - 1], xs[i], ys[i], 0x7777);
+    for (int i = 0; i < 100; i++)
+        GFX_drawLine(seg[4 * i], seg[4 * i + 1], seg[4 * i + 2], seg[4 * i + 3], 0xF0F0);
+}
+
+static void viaBatch(int n)
+{
+    GFX_fillScreen(0);
+    GFX_drawPolyline(xs, ys, n, 0x7777);
+    GFX_drawSegments(seg, 100, 0xF0F0);
+}
+
+// Time reps draws of an n-point series, as separate lines and as one batch.
+// In band mode the strips are rasterized by GFX_flush(), so it is timed too,
+// along with the simulated transfer of every strip.
+static void bench(const char *mode, int n, int reps)
+{
+    bool band = strcmp(mode, "band") == 0;
+    double t = seconds();
+    for (int r = 0; r < reps; r++)
+    {
+        for (int i = 1; i < n; i++)
+            GFX_drawLine(xs[i - 1], ys[i - 1], xs[i], ys[i], 0xFFFF);
+        if (band)
+            GFX_flush();
+    }
+    double lines = seconds() - t;
+    t = seconds();
+    for (int r = 0; r < reps; r++)
+    {
+        GFX_drawPolyline(xs, ys, n, 0xFFFF);
+        if (band)
+            GFX_flush();
+    }
+    double batch = seconds() - t;
+    printf("%-11s n=%5d: drawLine %7.1f us, drawPolyline %7.1f us per series\n", mode, n, lines * 1e6 / reps,
+           batch * 1e6 / reps);
+}
+
+int main()
+{
+    setup();
+    srand(5);
+    // A noisy signal that runs off both ends and past the top and bottom
+    for (int i = 0; i < 1000; i++)
+    {
+        xs[i] = i * 200 / 1000 - 15 + rand() % 3;
+        ys[i] = 160 + rand() % 400 - 200;
+    }
+    for (int i = 0; i < 400; i++)
+        seg[i] = rand() % 300 - 60;
+    seg[4] = seg[2]; // the second segment starts where the first ends
+    seg[5] = seg[3];
+
+    GFX_createFramebuf(false);
+    viaLines(1000);
+    capture();
+    viaBatch(1000);
+    CHECK(matches());
+
+    // Inside a viewport the series is offset and clipped
+    GFX_fillScreen(0);
+    GFX_pushViewport(10, 20, 100, 200);
+    GFX_drawPolyline(xs, ys, 1000, 0x7777);
+    GFX_drawSegments(seg, 100, 0xF0F0);
+    GFX_popClip();
+    GFX_flush();
+    LCD_waitWrite();
+    for (int y = 0; y < 320; y++)
+        for (int x = 0; x < 170; x++)
+            CHECK(gram(x, y) == (x >= 10 && x < 110 && y >= 20 && y < 220 ? ref[y - 20][x - 10] : 0));
+
+    // Shared joints and degenerate series
+    int16_t px[] = {10, 20, 30, 30, 10}, py[] = {10, 15, 10, 30, 10};
+    GFX_fillScreen(0);
+    GFX_drawPolyline(px, py, 5, 0x0F0F);
+    GFX_flush();
+    LCD_waitWrite();
+    CHECK(gram(20, 15) == 0x0F0F && gram(30, 30) == 0x0F0F && gram(10, 10) == 0x0F0F);
+    GFX_drawPolyline(px, py, 1, 0x0A0A);
+    GFX_drawPolyline(px, py, 0, 0x0B0B);
+    GFX_flush();
+    LCD_waitWrite();
+    CHECK(gram(10, 10) == 0x0A0A);
+    GFX_destroyFramebuf();
+
+    // Band mode replays the batch once per strip
+    viaLines(1000);
+    CHECK(GFX_createBandBuffer(16, 2000));
+    GFX_setClearColor(0);
+    GFX_drawPolyline(xs, ys, 1000, 0x7777);
+    GFX_drawSegments(seg, 100, 0xF0F0);
+    CHECK(matches());
+    GFX_destroyFramebuf();
+
+    // Benchmark: a sine sweep across the screen, 1k and 10k points
+    for (int i = 0; i < 10000; i++)
+    {
+        xs[i] = i * 170 / 10000;
+        ys[i] = 160 + (int16_t)(150 * sin(i * 0.05));
+    }
+    GFX_createFramebuf(false);
+    bench("framebuffer", 1000, 200);
+    bench("framebuffer", 10000, 20);
+    GFX_destroyFramebuf();
+    CHECK(GFX_createBandBuffer(16, 20000));
+    bench("band", 1000, 20);
+    bench("band", 10000, 2);
+    GFX_destroyFramebuf();
+    printf("polyline OK\n");
+}
@@ -0,0 +1,91 @@
+// RGB444 transfer mode: packer output and throughput against a per-pixel
+// reference, and every write path through the panel model.
+
+#include "test_common.h"
+
+static uint16_t quantized(uint16_t c) { return c & 0xF79E; } // 444 as the panel expands it
+
+// One pixel at a time, 12 bits appended to a bit stream
+static void naivePack(const uint16_t *src, uint16_t *dst, uint32_t groups)
+{
+    uint64_t bits = 0;
+    int n = 0;
+    for (uint32_t i = 0; i < groups * 4; i++)
+    {
+        uint16_t c = src[i];
+        bits = bits << 12 | (c >> 12) << 8 | ((c >> 7) & 15) << 4 | ((c >> 1) & 15);
+        n += 12;
+        while (n >= 16)
+        {
+            *dst++ = (uint16_t)(bits >> (n - 16));
+            n -= 16;
+        }
+    }
+}
+
+int main()
+{
+    uint16_t src[4] = {0xF800, 0x07E0, 0x001F, 0xFFFF}, dst[3];
+    LCD_packRGB444(src, dst, 1);
+    CHECK(dst[0] == 0xF000 && dst[1] == 0xF000 && dst[2] == 0xFFFF);
+
+    // Packer against the reference, then throughput of both
+    const uint32_t groups = 170 * 320 / 4;
+    static uint16_t frame[groups * 4], fast[groups * 3], slow[groups * 3];
+    srand(5);
+    for (auto &p : frame)
+        p = rand();
+    LCD_packRGB444(frame, fast, groups);
+    naivePack(frame, slow, groups);
+    CHECK(memcmp(fast, slow, sizeof fast) == 0);
+
+    const int reps = 200;
+    double t0 = seconds();
+    for (int r = 0; r < reps; r++)
+        LCD_packRGB444(frame, fast, groups);
+    double t1 = seconds();
+    for (int r = 0; r < reps; r++)
+        naivePack(frame, slow, groups);
+    double t2 = seconds();
+    printf("packer %.0f Mpixel/s, per-pixel reference %.0f Mpixel/s (checksum %u)\n",
+           reps * groups * 4 / (t1 - t0) / 1e6, reps * groups * 4 / (t2 - t1) / 1e6, fast[123] ^ slow[456]);
+
+    // Every write path in 444 mode
+    setup(170, 320);
+    LCD_initDisplay(170, 320, ST7789_COLMOD_444);
+    LCD_setRotation(2);
+    CHECK(LCD_getColorMode() == ST7789_COLMOD_444 && sim_colmod == 0x53);
+    static uint16_t img[320 * 240];
+    for (auto &p : img)
+        p = rand();
+    for (int it = 0; it < 300; it++)
+    {
+        int w = 1 + rand() % 60, h = 1 + rand() % 50, x = rand() % (170 - w), y = rand() % (320 - h);
+        int mode = rand() % 4, stride = w + rand() % 5;
+        uint16_t c = rand();
+        switch (mode)
+        {
+        case 0: LCD_WriteBitmapAsync(x, y, w, h, img, NULL); break;
+        case 1: LCD_WriteBitmapStride(x, y, w, h, img + 3, stride); break;
+        case 2: LCD_fillRect(x, y, w, h, c); break;
+        case 3: LCD_WritePixel(x, y, c); w = h = 1; break;
+        }
+        LCD_waitWrite();
+        for (int j = 0; j < h; j++)
+            for (int i = 0; i < w; i++)
+            {
+                uint16_t e = mode == 0 ? img[j * w + i] : mode == 1 ? img[3 + j * stride + i] : c;
+                CHECK(gram(x + i, y + j) == quantized(e));
+            }
+    }
+
+    // A full frame costs three quarters of the RGB565 bytes
+    GFX_createFramebuf();
+    GFX_fillScreen(0x1234);
+    sim_reset_stats();
+    GFX_flush();
+    printf("444 frame %llu bytes, 565 frame %d bytes\n", (unsigned long long)sim_stats.bytes, 170 * 320 * 2);
+    CHECK(sim_stats.bytes < 170 * 320 * 2 * 78 / 100);
+    CHECK(gram(5, 300) == quantized(0x1234));
+    printf("rgb444 OK\n");
+}
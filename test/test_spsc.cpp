@@ -0,0 +1,101 @@
+// SPSC queue under real concurrency: one producer and one consumer thread
+// move millions of sequenced items through small rings, by the non-blocking
+// calls, the blocking calls and the in-place calls. Every item must arrive
+// once, in order and intact.
+
+#include "spsc_queue.h"
+#include <atomic>
+#include <chrono>
+#include <initializer_list>
+#include <stdio.h>
+#include <thread>
+
+struct Item
+{
+    uint32_t seq, a, b, c;
+};
+
+enum Mode
+{
+    TRY,      ///< SPSC_tryPush() / SPSC_tryPop(), retrying when full or empty
+    BLOCKING, ///< SPSC_push() / SPSC_pop()
+    MIXED     ///< All of the above and beginPush/endPush, beginPop/endPop, interleaved
+};
+
+static Item make(uint32_t i) { return {i, i * 3, ~i, i ^ 0x5a5a5a5a}; }
+
+static void produce(SPSC_Queue *q, uint32_t n, Mode mode)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        Item it = make(i);
+        int how = mode == MIXED ? (int)(i % 3) : (int)mode;
+        if (how == TRY)
+        {
+            while (!SPSC_tryPush(q, &it))
+                std::this_thread::yield();
+        }
+        else if (how == BLOCKING)
+            SPSC_push(q, &it);
+        else
+        {
+            *static_cast<Item *>(SPSC_beginPush(q)) = it;
+            SPSC_endPush(q);
+        }
+    }
+}
+
+static bool consume(SPSC_Queue *q, uint32_t n, Mode mode)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        Item it;
+        int how = mode == MIXED ? (int)((i / 2) % 3) : (int)mode;
+        if (how == TRY)
+        {
+            while (!SPSC_tryPop(q, &it))
+                std::this_thread::yield();
+        }
+        else if (how == BLOCKING)
+            SPSC_pop(q, &it);
+        else
+        {
+            it = *static_cast<Item *>(SPSC_beginPop(q));
+            SPSC_endPop(q);
+        }
+        Item e = make(i);
+        if (it.seq != e.seq || it.a != e.a || it.b != e.b || it.c != e.c)
+        {
+            printf("item %u: got seq %u (%08x %08x %08x)\n", i, it.seq, it.a, it.b, it.c);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    static const char *names[] = {"try", "blocking", "mixed"};
+    const uint32_t n = 1000000;
+    for (uint32_t capacity : {1u, 2u, 8u})
+        for (Mode mode : {TRY, BLOCKING, MIXED})
+        {
+            SPSC_Queue q;
+            if (!SPSC_init(&q, sizeof(Item), capacity))
+                return 1;
+            bool ok = false;
+            auto t0 = std::chrono::steady_clock::now();
+            std::thread consumer([&] { ok = consume(&q, n, mode); });
+            produce(&q, n, mode);
+            consumer.join();
+            double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            printf("capacity %u, %-8s: %.1f M items/s\n", q.mask + 1, names[mode], n / s / 1e6);
+            if (!ok || SPSC_count(&q) != 0)
+            {
+                printf("FAIL capacity %u %s\n", capacity, names[mode]);
+                return 1;
+            }
+            SPSC_free(&q);
+        }
+    printf("spsc OK\n");
+}
@@ -0,0 +1,52 @@
+// GFX_drawTextBox keeps its text inside the box, and draws nothing when the
+// clip stack has no room left for the box's clip.
+
+#include "test_common.h"
+
+static const char *text = "A line of text much wider than its box\nand a second one";
+
+// Pixels drawn outside the box, after drawing into a cleared framebuffer
+static int outside(int x, int y, int w, int h, int *inside)
+{
+    GFX_flush();
+    LCD_waitWrite();
+    int out = 0;
+    *inside = 0;
+    for (int j = 0; j < 320; j++)
+        for (int i = 0; i < 170; i++)
+            if (gram(i, j) != 0)
+                (i >= x && i < x + w && j >= y && j < y + h ? *inside : out)++;
+    return out;
+}
+
+int main()
+{
+    setup();
+    GFX_createFramebuf(false);
+    GFX_setFont(NULL);
+    GFX_setTextColor(0xFFFF);
+    GFX_setTextBack(0);
+    GFX_setTextSize(2);
+
+    int inside;
+    GFX_fillScreen(0);
+    GFX_drawTextBox(10, 20, 60, 40, text, 0);
+    CHECK(outside(10, 20, 60, 40, &inside) == 0 && inside > 0);
+
+    // Fill the clip stack; the box cannot be clipped, so nothing is drawn
+    int depth = 0;
+    while (GFX_pushClip(0, 0, 170, 320))
+        depth++;
+    CHECK(depth > 0);
+    GFX_fillScreen(0);
+    GFX_drawTextBox(10, 20, 60, 40, text, GFX_TEXT_WRAP);
+    CHECK(outside(10, 20, 60, 40, &inside) == 0 && inside == 0);
+
+    // One level free again: the box clips and draws as before
+    GFX_popClip();
+    GFX_drawTextBox(10, 20, 60, 40, text, GFX_TEXT_WRAP);
+    CHECK(outside(10, 20, 60, 40, &inside) == 0 && inside > 0);
+    while (--depth > 0)
+        GFX_popClip();
+    printf("textbox OK\n");
+}
@@ -0,0 +1,123 @@
+// GFX_flushVsync() against a simulated TE signal: bands must start only after
+// the scan has passed their rows, and LCD_* calls made mid-frame must wait
+// for the last band.
+
+#include "test_common.h"
+#include "mock_transport.h"
+
+#define TE_PIN 6
+#define TE_PERIOD 16667
+
+struct Band
+{
+    uint64_t start, end;
+    uint16_t y0, y1;
+};
+static Band bands[8];
+static int bandCount;
+static uint64_t madctlTime;
+
+static void onWindow(uint16_t, uint16_t y0, uint16_t, uint16_t y1)
+{
+    if (bandCount < 8)
+        bands[bandCount] = {sim_time_us, 0, y0, y1};
+}
+
+static void onDone()
+{
+    if (bandCount < 8)
+        bands[bandCount++].end = sim_time_us;
+}
+
+static void onCommand(uint8_t cmd, const uint8_t *, size_t)
+{
+    if (cmd == ST77XX_MADCTL)
+        madctlTime = sim_time_us;
+}
+
+// Advance simulated time one microsecond at a time so alarms run in order,
+// with a TE edge every TE_PERIOD
+static void advance(uint64_t us)
+{
+    while (us--)
+    {
+        tight_loop_contents();
+        if (sim_time_us % TE_PERIOD == 0)
+            sim_fire_gpio_irq(TE_PIN, GPIO_IRQ_EDGE_RISE);
+    }
+}
+
+static uint64_t scan(uint64_t te, uint16_t line) { return te + (uint64_t)line * TE_PERIOD / 320; }
+
+int main()
+{
+    // The pure schedule
+    CHECK(GFX_vsyncBandStart(1000, 16000, 0, 80, 5000, true) == 1000);
+    CHECK(GFX_vsyncBandStart(1000, 16000, 0, 80, 1000, true) == 1000 + 4000 - 1000);
+    CHECK(GFX_vsyncBandStart(1000, 16000, 80, 160, 8000, true) == 1000 + 4000);
+    CHECK(GFX_vsyncBandStart(1000, 16000, 80, 160, 8000, false) == 1000 + 8000);
+
+    LCD_setTransport(&mock_transport);
+    mock_pixelsPerUs = 4;
+    setup();
+    LCD_setTEPin(TE_PIN);
+    advance(20 * TE_PERIOD - sim_time_us % TE_PERIOD); // let the measured period settle
+    CHECK(LCD_getTEPeriod() > TE_PERIOD - 50 && LCD_getTEPeriod() < TE_PERIOD + 50);
+
+    mock_onWindow = onWindow;
+    mock_onDone = onDone;
+    mock_onCommand = onCommand;
+    GFX_createFramebuf(true);
+    for (int f = 0; f < 5; f++)
+    {
+        // Each frame is started just after one edge and sent from the next
+        uint16_t color = 0x1000 * (f + 1);
+        GFX_fillScreen(color);
+        GFX_drawPixel(1, 318, 0xBEEF);
+        bandCount = 0;
+        advance(10);
+        GFX_flushVsync();
+        GFX_fillScreen(0xFFFF); // the back buffer is free meanwhile
+        advance(TE_PERIOD - 11);
+        CHECK(bandCount == 0); // nothing goes out before TE
+        advance(1);
+        uint64_t te = sim_time_us;
+        CHECK(te % TE_PERIOD == 0);
+        if (f == 4)
+        {
+            // A rotation change once the first band is out must wait for the whole frame
+            while (bandCount == 0)
+                advance(1);
+            CHECK(!GFX_isFlushDone());
+            madctlTime = 0;
+            LCD_setRotation(0);
+            CHECK(GFX_isFlushDone() && bandCount == 4);
+            CHECK(madctlTime >= bands[3].end);
+            LCD_setRotation(2);
+        }
+        while (!GFX_isFlushDone() && sim_time_us < te + 2 * TE_PERIOD)
+            advance(1);
+        CHECK(GFX_isFlushDone());
+        advance(TE_PERIOD - sim_time_us % TE_PERIOD);
+
+        CHECK(bandCount == 4);
+        for (int b = 0; b < bandCount; b++)
+        {
+            const Band &k = bands[b];
+            printf("frame %d band %d rows %3u-%3u: start %5llu end %5llu, scan %5llu-%5llu us after TE\n", f, b,
+                   k.y0, k.y1, (unsigned long long)(k.start - te), (unsigned long long)(k.end - te),
+                   (unsigned long long)(scan(te, k.y0) - te), (unsigned long long)(scan(te, k.y1) - te));
+            // Never ahead of the scan line, and done before the next scan reaches the
+            // band. The send time is estimated, so the last row may be up to two
+            // lines early once the estimate has settled.
+            CHECK(k.start >= scan(te, k.y0));
+            if (f > 0)
+                CHECK(k.end + 2 * TE_PERIOD / 320 >= scan(te, k.y1));
+            CHECK(k.end <= scan(te, k.y0) + TE_PERIOD);
+        }
+        for (int y = 0; y < 320; y++)
+            for (int x = 0; x < 170; x++)
+                CHECK(mock_gram[y + _ystart][x + _xstart] == (x == 1 && y == 318 ? 0xBEEF : color));
+    }
+    printf("vsync OK\n");
+}